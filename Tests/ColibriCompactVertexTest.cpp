@@ -0,0 +1,101 @@
+// Headless test: round trips positions and clip distances through UiVertexCompact's
+// encoding (see ColibriManager::setCompactVertexFormat) and decodes them the way the
+// GPU and ColibriGui_piece_vs do. Returns non-zero on failure.
+
+#include "ColibriGui/ColibriRenderable.h"
+
+#include "OgreBitwise.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+namespace
+{
+	/// What the GPU does with VET_SHORT2_SNORM, followed by the
+	/// colibri_compact_position_scale multiplication in ColibriGui_piece_vs
+	float fromCompactPosition( int16_t value )
+	{
+		const float snorm = std::max( static_cast<float>( value ) / 32767.0f, -1.0f );
+		return snorm * Colibri::c_compactPositionScale;
+	}
+
+	size_t g_numFailures = 0u;
+
+	void fail( const char *what, float input, float output )
+	{
+		if( g_numFailures < 10u )
+		{
+			printf( "FAILED %s: %.9g became %.9g\n", what, static_cast<double>( input ),
+					static_cast<double>( output ) );
+		}
+		++g_numFailures;
+	}
+}  // namespace
+
+int main()
+{
+	using namespace Colibri;
+
+	// Biggest canvas (in pixels) where positions must stay within half a pixel
+	const float c_maxCanvasSize = 8192.0f;
+	const float halfPixel = 0.5f * ( 2.0f / c_maxCanvasSize );
+
+	const size_t c_numSteps = 1000000u;
+
+	// Everything within +/- c_compactPositionScale must survive the round trip
+	float maxError = 0.0f;
+	for( size_t i = 0u; i <= c_numSteps; ++i )
+	{
+		const float ndc = c_compactPositionScale *
+						  ( 2.0f * static_cast<float>( i ) / static_cast<float>( c_numSteps ) - 1.0f );
+		const float decoded = fromCompactPosition( toCompactPosition( ndc ) );
+		const float error = fabsf( decoded - ndc );
+		maxError = std::max( maxError, error );
+		if( error >= halfPixel )
+			fail( "precision", ndc, decoded );
+	}
+	printf( "Max position error: %.9g NDC (half a pixel at %.0f px is %.9g)\n",
+			static_cast<double>( maxError ), static_cast<double>( c_maxCanvasSize ),
+			static_cast<double>( halfPixel ) );
+
+	// Widgets far outside the canvas (e.g. scrolled away) go beyond what the scale covers.
+	// They must be clamped to the limits, not wrap around into the screen
+	const float farAway[] = { c_compactPositionScale + 1e-3f, c_compactPositionScale * 2.0f,
+							  100.0f, 1e6f, 1e30f };
+	for( size_t i = 0u; i < sizeof( farAway ) / sizeof( farAway[0] ); ++i )
+	{
+		const float decodedPos = fromCompactPosition( toCompactPosition( farAway[i] ) );
+		if( decodedPos != c_compactPositionScale )
+			fail( "clamping", farAway[i], decodedPos );
+		const float decodedNeg = fromCompactPosition( toCompactPosition( -farAway[i] ) );
+		if( decodedNeg != -c_compactPositionScale )
+			fail( "clamping", -farAway[i], decodedNeg );
+	}
+
+	// Clip distances are half floats. Their sign decides what gets clipped
+	for( size_t i = 0u; i <= c_numSteps; ++i )
+	{
+		const float distance = 4.0f * c_compactPositionScale *
+							   ( 2.0f * static_cast<float>( i ) / static_cast<float>( c_numSteps ) -
+								 1.0f );
+		// Below the smallest normal half, the pixel is on the border anyway
+		if( fabsf( distance ) < 6.103515625e-5f )
+			continue;
+		const float decoded = Ogre::Bitwise::halfToFloat( Ogre::Bitwise::floatToHalf( distance ) );
+		if( ( distance < 0.0f ) != ( decoded < 0.0f ) ||
+			fabsf( decoded - distance ) > fabsf( distance ) * ( 1.0f / 1024.0f ) )
+		{
+			fail( "clip distance", distance, decoded );
+		}
+	}
+
+	if( g_numFailures != 0u )
+	{
+		printf( "FAILED: %u checks\n", static_cast<unsigned>( g_numFailures ) );
+		return 1;
+	}
+
+	printf( "OK\n" );
+	return 0;
+}
@@ -0,0 +1,291 @@
+// Headless test: expands NineSliceRecords the way ColibriGui_piece_vs does (reading them as
+// raw uint4 with the shader's indices, walking the shared quad index buffer) and checks the
+// result is bit-identical to what the CPU path (one addQuad per cell) used to write.
+// Returns non-zero on mismatch.
+//
+// This checks the record layout and the expansion math, not the shaders themselves,
+// which still need to be compiled & rendered on every RenderSystem.
+
+#include "ColibriGui/ColibriRenderable.h"
+#include "ColibriGui/ColibriSimd.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	/// Deterministic LCG so that failures are reproducible
+	struct Random
+	{
+		uint32_t state;
+
+		explicit Random( uint32_t seed ) : state( seed ) {}
+
+		/// Returns a value in range [minVal; maxVal)
+		float next( float minVal, float maxVal )
+		{
+			state = state * 1664525u + 1013904223u;
+			const float unit = static_cast<float>( state >> 8u ) * ( 1.0f / 16777216.0f );
+			return minVal + unit * ( maxVal - minVal );
+		}
+
+		uint8_t nextByte()
+		{
+			state = state * 1664525u + 1013904223u;
+			return static_cast<uint8_t>( state >> 24u );
+		}
+	};
+
+	struct ExpandedVertex
+	{
+		float x;
+		float y;
+		float u;
+		float v;
+		float clipDistance[Colibri::Borders::NumBorders];
+		uint8_t rgbaColour[4];
+	};
+
+	float asFloat( uint32_t value )
+	{
+		float retVal;
+		memcpy( &retVal, &value, sizeof( retVal ) );
+		return retVal;
+	}
+
+	/// C++ transliteration of the colibri_nine_slice block in ColibriGui_piece_vs.
+	/// records is the record buffer as seen by the shader (one uint4 = 4 words).
+	ExpandedVertex expandNineSliceVertex( const uint32_t *records, uint32_t recordStart,
+										  uint32_t colibriVertexId )
+	{
+		using namespace Colibri;
+
+		const uint32_t nineSliceRecordIdx = ( recordStart + colibriVertexId / 36u ) * 11u;
+		const uint32_t cellIdx = ( colibriVertexId % 36u ) / 4u;
+		const uint32_t vertId = colibriVertexId % 4u;
+
+		const uint32_t *gridX = records + ( nineSliceRecordIdx + 0u ) * 4u;
+		const uint32_t *gridY = records + ( nineSliceRecordIdx + 1u ) * 4u;
+		const uint32_t *rot0 = records + ( nineSliceRecordIdx + 2u ) * 4u;
+		const uint32_t *rot1 = records + ( nineSliceRecordIdx + 3u ) * 4u;
+		const uint32_t *clip = records + ( nineSliceRecordIdx + 4u ) * 4u;
+		const uint32_t *data = records + ( nineSliceRecordIdx + 5u ) * 4u;
+		const uint32_t *uvs = records + ( nineSliceRecordIdx + 6u + cellIdx / 2u ) * 4u;
+
+		const uint32_t cornerX = vertId >= 2u ? 1u : 0u;
+		const uint32_t cornerY = ( vertId == 1u || vertId == 2u ) ? 1u : 0u;
+
+		const float cornerPosX = asFloat( gridX[cellIdx % 3u + cornerX] );
+		const float cornerPosY = asFloat( gridY[cellIdx / 3u + cornerY] );
+
+		ExpandedVertex retVal;
+		retVal.x = cornerPosX;
+		retVal.y = cornerPosY;
+		if( ( data[3] & 1u ) != 0u )
+		{
+			const float scaledY = cornerPosY * asFloat( rot1[3] );
+			retVal.x = asFloat( rot0[0] ) * cornerPosX + asFloat( rot0[1] ) * scaledY +
+					   asFloat( rot0[2] );
+			retVal.y = asFloat( rot0[3] ) * cornerPosX + asFloat( rot1[0] ) * scaledY +
+					   asFloat( rot1[1] );
+			retVal.y *= asFloat( rot1[2] );
+		}
+		retVal.y = -retVal.y;
+
+		const float invSizeX = asFloat( data[0] );
+		const float invSizeY = asFloat( data[1] );
+		retVal.clipDistance[Borders::Top] = ( cornerPosY - asFloat( clip[1] ) ) * invSizeY;
+		retVal.clipDistance[Borders::Left] = ( cornerPosX - asFloat( clip[0] ) ) * invSizeX;
+		retVal.clipDistance[Borders::Right] = ( asFloat( clip[2] ) - cornerPosX ) * invSizeX;
+		retVal.clipDistance[Borders::Bottom] = ( asFloat( clip[3] ) - cornerPosY ) * invSizeY;
+
+		const uint32_t *cellUv = ( cellIdx & 1u ) != 0u ? uvs + 2u : uvs;
+		const uint32_t u = cornerX != 0u ? cellUv[1] : cellUv[0];
+		const uint32_t v = cornerY != 0u ? cellUv[1] : cellUv[0];
+		retVal.u = static_cast<float>( u & 0xFFFFu ) / 65535.0f;
+		retVal.v = static_cast<float>( v >> 16u ) / 65535.0f;
+
+		for( size_t i = 0u; i < 4u; ++i )
+			retVal.rgbaColour[i] = static_cast<uint8_t>( ( data[2] >> ( i * 8u ) ) & 0xFFu );
+
+		return retVal;
+	}
+
+	/// What Renderable::addQuad wrote for each cell before 9-slices were expanded
+	/// in the vertex shader: 6 vertices per cell, row by row
+	void writeCpuVertices( const Colibri::NineSliceRecord &record, const Colibri::Matrix2x3 &rot,
+						   ExpandedVertex outVertices[9u * 6u] )
+	{
+		using namespace Colibri;
+
+		const Ogre::Vector2 parentDerivedTL( record.parentDerivedTL[0], record.parentDerivedTL[1] );
+		const Ogre::Vector2 parentDerivedBR( record.parentDerivedBR[0], record.parentDerivedBR[1] );
+		const Ogre::Vector2 invSize( record.invSize[0], record.invSize[1] );
+
+		for( size_t cell = 0u; cell < GridLocations::NumGridLocations; ++cell )
+		{
+			const size_t col = cell % 3u;
+			const size_t row = cell / 3u;
+			const Ogre::Vector2 topLeft( record.gridX[col], record.gridY[row] );
+			const Ogre::Vector2 bottomRight( record.gridX[col + 1u], record.gridY[row + 1u] );
+
+			float posX[4], posY[4];
+			float clipDistance[4 * Borders::NumBorders];
+			transformQuadCornersScalar( topLeft, bottomRight, parentDerivedTL, parentDerivedBR,
+										invSize, record.canvasAspectRatio,
+										record.invCanvasAspectRatio, rot,
+										( record.flags & NineSliceFlags::Rotated ) != 0u, posX, posY,
+										clipDistance );
+
+			const uint16_t *uv = record.uvTopLeftBottomRight[cell];
+			const uint16_t cornerU[4] = { uv[0], uv[0], uv[2], uv[2] };
+			const uint16_t cornerV[4] = { uv[1], uv[3], uv[3], uv[1] };
+
+			ExpandedVertex corners[4];
+			for( size_t i = 0u; i < 4u; ++i )
+			{
+				corners[i].x = posX[i];
+				corners[i].y = posY[i];
+				// USHORT2_NORM
+				corners[i].u = static_cast<float>( cornerU[i] ) / 65535.0f;
+				corners[i].v = static_cast<float>( cornerV[i] ) / 65535.0f;
+				memcpy( corners[i].clipDistance, &clipDistance[i * Borders::NumBorders],
+						sizeof( corners[i].clipDistance ) );
+				memcpy( corners[i].rgbaColour, record.rgbaColour, sizeof( corners[i].rgbaColour ) );
+			}
+
+			ExpandedVertex *vertices = outVertices + cell * 6u;
+			vertices[0] = corners[0];
+			vertices[1] = corners[1];
+			vertices[2] = corners[2];
+			vertices[3] = corners[2];
+			vertices[4] = corners[3];
+			vertices[5] = corners[0];
+		}
+	}
+
+	bool isSameVertex( const ExpandedVertex &a, const ExpandedVertex &b )
+	{
+		return memcmp( &a.x, &b.x, sizeof( float ) ) == 0 &&
+			   memcmp( &a.y, &b.y, sizeof( float ) ) == 0 &&
+			   memcmp( &a.u, &b.u, sizeof( float ) ) == 0 &&
+			   memcmp( &a.v, &b.v, sizeof( float ) ) == 0 &&
+			   memcmp( a.clipDistance, b.clipDistance, sizeof( a.clipDistance ) ) == 0 &&
+			   memcmp( a.rgbaColour, b.rgbaColour, sizeof( a.rgbaColour ) ) == 0;
+	}
+}  // namespace
+
+int main()
+{
+	using namespace Colibri;
+
+	const size_t c_numRecords = 64u;
+	const size_t c_numIterations = 1000u;
+
+	Random rnd( 1234u );
+	size_t numMismatches = 0u;
+
+	NineSliceRecord records[c_numRecords];
+	Matrix2x3 rotations[c_numRecords];
+
+	for( size_t iteration = 0u; iteration < c_numIterations; ++iteration )
+	{
+		// Filled like Renderable::_fillBuffersAndCommands does
+		for( size_t i = 0u; i < c_numRecords; ++i )
+		{
+			NineSliceRecord &record = records[i];
+			memset( &record, 0, sizeof( record ) );
+
+			record.gridX[0] = rnd.next( -2.0f, 2.0f );
+			record.gridY[0] = rnd.next( -2.0f, 2.0f );
+			for( size_t j = 1u; j < 4u; ++j )
+			{
+				record.gridX[j] = record.gridX[j - 1u] + rnd.next( 0.0f, 0.5f );
+				record.gridY[j] = record.gridY[j - 1u] + rnd.next( 0.0f, 0.5f );
+			}
+
+			for( size_t row = 0u; row < 2u; ++row )
+			{
+				for( size_t col = 0u; col < 3u; ++col )
+					rotations[i].m[row][col] = rnd.next( -2.0f, 2.0f );
+			}
+			memcpy( record.derivedRot, rotations[i].m, sizeof( record.derivedRot ) );
+			record.canvasAspectRatio = rnd.next( 0.25f, 4.0f );
+			record.invCanvasAspectRatio = 1.0f / record.canvasAspectRatio;
+			record.parentDerivedTL[0] = rnd.next( -2.0f, 2.0f );
+			record.parentDerivedTL[1] = rnd.next( -2.0f, 2.0f );
+			record.parentDerivedBR[0] = record.parentDerivedTL[0] + rnd.next( 0.001f, 2.0f );
+			record.parentDerivedBR[1] = record.parentDerivedTL[1] + rnd.next( 0.001f, 2.0f );
+			record.invSize[0] = 1.0f / ( record.parentDerivedBR[0] - record.parentDerivedTL[0] );
+			record.invSize[1] = 1.0f / ( record.parentDerivedBR[1] - record.parentDerivedTL[1] );
+			for( size_t j = 0u; j < 4u; ++j )
+				record.rgbaColour[j] = rnd.nextByte();
+			record.flags = ( i & 0x01u ) ? static_cast<uint32_t>( NineSliceFlags::Rotated ) : 0u;
+			for( size_t cell = 0u; cell < GridLocations::NumGridLocations; ++cell )
+			{
+				for( size_t j = 0u; j < 4u; ++j )
+				{
+					record.uvTopLeftBottomRight[cell][j] =
+						static_cast<uint16_t>( rnd.next( 0.0f, 1.0f ) * 65535.0f );
+				}
+			}
+		}
+
+		// What the shader sees. Records are tightly packed in the buffer
+		uint32_t rawRecords[c_numRecords * sizeof( NineSliceRecord ) / sizeof( uint32_t )];
+		memcpy( rawRecords, records, sizeof( rawRecords ) );
+
+		// A draw covering a random range of records, like Renderable::_addCommands issues.
+		// Draws start at the beginning of the Vao (see addIndirectDraw), so the vertex ID
+		// the shader gets (once the base vertex is removed) is the value in the index buffer
+		const uint32_t recordStart =
+			static_cast<uint32_t>( rnd.next( 0.0f, static_cast<float>( c_numRecords ) ) );
+		const uint32_t numDrawRecords = static_cast<uint32_t>(
+			rnd.next( 1.0f, static_cast<float>( c_numRecords - recordStart + 1u ) ) );
+
+		for( uint32_t i = 0u; i < numDrawRecords; ++i )
+		{
+			ExpandedVertex cpuVertices[9u * 6u];
+			writeCpuVertices( records[recordStart + i], rotations[recordStart + i], cpuVertices );
+
+			for( uint32_t j = 0u; j < 9u * 6u; ++j )
+			{
+				// See ColibriOgreRenderable::createQuadIndexBuffer
+				const uint32_t indexPos = i * 9u * 6u + j;
+				const uint32_t c_quadIndices[6] = { 0u, 1u, 2u, 2u, 3u, 0u };
+				const uint32_t colibriVertexId = ( indexPos / 6u ) * 4u + c_quadIndices[indexPos % 6u];
+
+				const ExpandedVertex gpuVertex =
+					expandNineSliceVertex( rawRecords, recordStart, colibriVertexId );
+
+				if( !isSameVertex( gpuVertex, cpuVertices[j] ) )
+				{
+					if( numMismatches < 10u )
+					{
+						printf( "Mismatch at iteration %u, record %u, index %u\n",
+								static_cast<unsigned>( iteration ),
+								static_cast<unsigned>( recordStart + i ), static_cast<unsigned>( j ) );
+						printf( "\tShader: %.9g %.9g uv %.9g %.9g CPU: %.9g %.9g uv %.9g %.9g\n",
+								static_cast<double>( gpuVertex.x ), static_cast<double>( gpuVertex.y ),
+								static_cast<double>( gpuVertex.u ), static_cast<double>( gpuVertex.v ),
+								static_cast<double>( cpuVertices[j].x ),
+								static_cast<double>( cpuVertices[j].y ),
+								static_cast<double>( cpuVertices[j].u ),
+								static_cast<double>( cpuVertices[j].v ) );
+					}
+					++numMismatches;
+				}
+			}
+		}
+	}
+
+	if( numMismatches != 0u )
+	{
+		printf( "FAILED: %u vertices don't match\n", static_cast<unsigned>( numMismatches ) );
+		return 1;
+	}
+
+	printf( "OK: %u draws match\n", static_cast<unsigned>( c_numIterations ) );
+	return 0;
+}
@@ -0,0 +1,77 @@
+// Headless test: checks that ShaperManager's shaping threads can be recreated with
+// setNumShapingThreads after they already ran jobs, and that every thread runs each
+// job exactly once. Returns non-zero on failure (or hangs/crashes if workers misbehave).
+
+#include "ColibriGui/ColibriManager.h"
+#include "ColibriGui/Text/ColibriShaperManager.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+
+namespace
+{
+	const size_t c_numThreads = 4u;
+
+	struct JobData
+	{
+		std::atomic<uint32_t> numRuns[c_numThreads];
+	};
+
+	void countingJob( size_t threadIdx, void *userData )
+	{
+		JobData *jobData = reinterpret_cast<JobData *>( userData );
+		++jobData->numRuns[threadIdx];
+	}
+
+	/// Runs numJobs jobs and checks each of the c_numThreads threads ran all of them once
+	bool runJobs( Colibri::ShaperManager *shaperManager, uint32_t numJobs, const char *stage )
+	{
+		JobData jobData;
+		for( size_t i = 0u; i < c_numThreads; ++i )
+			jobData.numRuns[i] = 0u;
+
+		for( uint32_t i = 0u; i < numJobs; ++i )
+			shaperManager->runOnShapingThreads( countingJob, &jobData );
+
+		bool bSuccess = true;
+		for( size_t i = 0u; i < c_numThreads; ++i )
+		{
+			if( jobData.numRuns[i] != numJobs )
+			{
+				printf( "FAILED (%s): thread %u ran %u of %u jobs\n", stage,
+						static_cast<unsigned>( i ), static_cast<unsigned>( jobData.numRuns[i] ),
+						static_cast<unsigned>( numJobs ) );
+				bSuccess = false;
+			}
+		}
+		return bSuccess;
+	}
+}  // namespace
+
+int main()
+{
+	Colibri::ColibriManager colibriManager( 0, 0 );
+	Colibri::ShaperManager *shaperManager = colibriManager.getShaperManager();
+
+	bool bSuccess = true;
+
+	shaperManager->setNumShapingThreads( c_numThreads );
+	bSuccess &= runJobs( shaperManager, 16u, "first threads" );
+
+	// Recreate the threads after they've run jobs. They must not pick up the old job
+	shaperManager->setNumShapingThreads( c_numThreads );
+	// Give the new workers time to reach their wait loop before the next job is issued,
+	// which is when they'd see a stale job
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	bSuccess &= runJobs( shaperManager, 16u, "recreated threads" );
+
+	shaperManager->setNumShapingThreads( 1u );
+
+	if( !bSuccess )
+		return 1;
+
+	printf( "OK\n" );
+	return 0;
+}
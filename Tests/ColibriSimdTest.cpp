@@ -0,0 +1,110 @@
+// Headless test: checks that the SIMD path of transformQuadCorners produces
+// bit-identical results to the scalar one. Returns non-zero on mismatch.
+
+#include "ColibriGui/ColibriSimd.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	/// Deterministic LCG so that failures are reproducible
+	struct Random
+	{
+		uint32_t state;
+
+		explicit Random( uint32_t seed ) : state( seed ) {}
+
+		/// Returns a value in range [minVal; maxVal)
+		float next( float minVal, float maxVal )
+		{
+			state = state * 1664525u + 1013904223u;
+			const float unit = static_cast<float>( state >> 8u ) * ( 1.0f / 16777216.0f );
+			return minVal + unit * ( maxVal - minVal );
+		}
+
+		Ogre::Vector2 nextVec( float minVal, float maxVal )
+		{
+			const float x = next( minVal, maxVal );
+			const float y = next( minVal, maxVal );
+			return Ogre::Vector2( x, y );
+		}
+	};
+}  // namespace
+
+int main()
+{
+#if defined( COLIBRI_SIMD_SSE2 )
+	printf( "Testing SSE2 against scalar\n" );
+#elif defined( COLIBRI_SIMD_NEON )
+	printf( "Testing NEON against scalar\n" );
+#else
+	printf( "No SIMD available. Testing scalar against itself\n" );
+#endif
+
+	using namespace Colibri;
+
+	const size_t c_numIterations = 100000u;
+
+	Random rnd( 1234u );
+	size_t numMismatches = 0u;
+
+	for( size_t i = 0u; i < c_numIterations; ++i )
+	{
+		const Ogre::Vector2 topLeft = rnd.nextVec( -2.0f, 2.0f );
+		const Ogre::Vector2 bottomRight = topLeft + rnd.nextVec( 0.0f, 2.0f );
+		const Ogre::Vector2 parentDerivedTL = rnd.nextVec( -2.0f, 2.0f );
+		const Ogre::Vector2 parentDerivedBR = parentDerivedTL + rnd.nextVec( 0.001f, 2.0f );
+		const Ogre::Vector2 invSize = 1.0f / ( parentDerivedBR - parentDerivedTL );
+		const float canvasAspectRatio = rnd.next( 0.25f, 4.0f );
+		const float invCanvasAspectRatio = 1.0f / canvasAspectRatio;
+
+		Matrix2x3 derivedRot;
+		for( size_t row = 0u; row < 2u; ++row )
+		{
+			for( size_t col = 0u; col < 3u; ++col )
+				derivedRot.m[row][col] = rnd.next( -2.0f, 2.0f );
+		}
+		const bool bRotated = ( i & 0x01u ) != 0u;
+
+		float simdX[4], simdY[4], simdClip[4 * Borders::NumBorders];
+		float scalarX[4], scalarY[4], scalarClip[4 * Borders::NumBorders];
+
+		transformQuadCorners( topLeft, bottomRight, parentDerivedTL, parentDerivedBR, invSize,
+							  canvasAspectRatio, invCanvasAspectRatio, derivedRot, bRotated, simdX,
+							  simdY, simdClip );
+		transformQuadCornersScalar( topLeft, bottomRight, parentDerivedTL, parentDerivedBR,
+									invSize, canvasAspectRatio, invCanvasAspectRatio, derivedRot,
+									bRotated, scalarX, scalarY, scalarClip );
+
+		if( memcmp( simdX, scalarX, sizeof( simdX ) ) != 0 ||
+			memcmp( simdY, scalarY, sizeof( simdY ) ) != 0 ||
+			memcmp( simdClip, scalarClip, sizeof( simdClip ) ) != 0 )
+		{
+			if( numMismatches < 10u )
+			{
+				printf( "Mismatch at iteration %u (bRotated = %i)\n",
+						static_cast<unsigned>( i ), bRotated ? 1 : 0 );
+				for( size_t j = 0u; j < 4u; ++j )
+				{
+					printf( "\tCorner %u SIMD: %.9g %.9g Scalar: %.9g %.9g\n",
+							static_cast<unsigned>( j ), static_cast<double>( simdX[j] ),
+							static_cast<double>( simdY[j] ), static_cast<double>( scalarX[j] ),
+							static_cast<double>( scalarY[j] ) );
+				}
+			}
+			++numMismatches;
+		}
+	}
+
+	if( numMismatches != 0u )
+	{
+		printf( "FAILED: %u of %u quads don't match\n", static_cast<unsigned>( numMismatches ),
+				static_cast<unsigned>( c_numIterations ) );
+		return 1;
+	}
+
+	printf( "OK: %u quads match\n", static_cast<unsigned>( c_numIterations ) );
+	return 0;
+}
@@ -5,38 +5,228 @@
 		#define vulkan_layout(x)
 	@end
 
-	vulkan_layout( OGRE_NORMAL ) in float4 normal;
+	@property( !colibri_text && !colibri_nine_slice )
+		vulkan_layout( OGRE_NORMAL ) in float4 normal;
+	@end
+@end
 
+@piece( custom_vs_uniformDeclaration )
 	@property( colibri_text )
-		vulkan_layout( OGRE_TANGENT ) in uint tangent;
-		vulkan_layout( OGRE_BLENDINDICES ) in uint2 blendIndices;
+		// One Colibri::LabelRecord (4x uint4) per Label followed by
+		// one Colibri::GlyphVertex (2x uint4) per glyph
+		@property( !use_read_only_buffer )
+			@property( ogre_version >= 2003000 )
+				vulkan_layout( ogre_T3 ) uniform usamplerBuffer glyphRecords;
+			@else
+				uniform usamplerBuffer glyphRecords;
+			@end
+		@else
+			ReadOnlyBufferU( 3, uint4, glyphRecords );
+		@end
+	@end
+	@property( colibri_nine_slice )
+		// One Colibri::NineSliceRecord (11x uint4) per widget
+		@property( !use_read_only_buffer )
+			@property( ogre_version >= 2003000 )
+				vulkan_layout( ogre_T4 ) uniform usamplerBuffer nineSliceRecords;
+			@else
+				uniform usamplerBuffer nineSliceRecords;
+			@end
+		@else
+			ReadOnlyBufferU( 4, uint4, nineSliceRecords );
+		@end
 	@end
 @end
 
 @piece( custom_vs_preExecution )
-	@property( !colibri_text )
+	@property( colibri_nine_slice )
+		// 9 quads per widget, 4 vertices each (drawn indexed)
+		uint colibriDrawId = inVs_drawId + ((uint(inVs_vertexId) - worldMaterialIdx[inVs_drawId].w) / 36u);
+	@end
+	@property( !colibri_text && !colibri_nine_slice )
 		uint colibriDrawId = inVs_drawId + ((uint(inVs_vertexId) - worldMaterialIdx[inVs_drawId].w) / 54u);
+	@end
+	@property( !colibri_text )
 		#undef finalDrawId
 		#define finalDrawId colibriDrawId
 	@end
 
 	#define worldViewProj 1.0f
 
-	@property( hlms_pso_clip_distances >= 4 )
-		gl_ClipDistance[0] = normal.x;
-		gl_ClipDistance[1] = normal.y;
-		gl_ClipDistance[2] = normal.z;
-		gl_ClipDistance[3] = normal.w;
-	@else
-		outVs.emulatedClipDistance = normal;
+	@property( !colibri_text && !colibri_nine_slice )
+		@property( hlms_pso_clip_distances >= 4 )
+			gl_ClipDistance[0] = normal.x;
+			gl_ClipDistance[1] = normal.y;
+			gl_ClipDistance[2] = normal.z;
+			gl_ClipDistance[3] = normal.w;
+		@else
+			outVs.emulatedClipDistance = normal;
+		@end
 	@end
 
 	@property( colibri_text )
-		uint vertId = (uint(inVs_vertexId) - worldMaterialIdx[inVs_drawId].w) % 6u;
-		outVs.uvText.x = (vertId <= 1u || vertId == 5u) ? 0.0f : float( blendIndices.x );
-		outVs.uvText.y = (vertId == 0u || vertId >= 4u) ? 0.0f : float( blendIndices.y );
-		outVs.pixelsPerRow		= blendIndices.x;
-		outVs.glyphOffsetStart	= tangent;
+		uint colibriVertexId = uint(inVs_vertexId) - worldMaterialIdx[inVs_drawId].w;
+		// Each GlyphVertex is 2x uint4. See Colibri::GlyphVertex
+		uint glyphRecordIdx = (worldMaterialIdx[inVs_drawId].y + colibriVertexId / 4u) * 2u;
+		uint vertId = colibriVertexId % 4u;
+
+		@property( !use_read_only_buffer )
+			#define colibriGlyphFetch( i ) bufferFetch( glyphRecords, int( i ) )
+		@else
+			#define colibriGlyphFetch( i ) readOnlyFetch( glyphRecords, i )
+		@end
+
+		float4 glyphPosSize	= uintBitsToFloat( colibriGlyphFetch( glyphRecordIdx ) );
+		uint4 glyphData		= colibriGlyphFetch( glyphRecordIdx + 1u );
+		// Glyphs know where their Label's LabelRecord (4x uint4) is, thus a draw can span
+		// many Labels. The LabelRecords are drawn too, but collapsed. See Colibri::LabelRecord
+		bool isLabelRecord	= glyphData.w >= 0xFFFFFFFEu;
+		uint labelRecordIdx	= isLabelRecord ? 0u : glyphData.w * 2u;
+		float4 labelRot0	= uintBitsToFloat( colibriGlyphFetch( labelRecordIdx ) );
+		float4 labelRot1	= uintBitsToFloat( colibriGlyphFetch( labelRecordIdx + 1u ) );
+		float4 labelClip	= uintBitsToFloat( colibriGlyphFetch( labelRecordIdx + 2u ) );
+		uint4 labelData		= colibriGlyphFetch( labelRecordIdx + 3u );
+
+		// Vertices are laid out TL, BL, BR, TR. See ColibriOgreRenderable::createQuadIndexBuffer
+		float cornerX = vertId >= 2u ? 1.0f : 0.0f;
+		float cornerY = (vertId == 1u || vertId == 2u) ? 1.0f : 0.0f;
+
+		float2 glyphCorner = glyphPosSize.xy + float2( cornerX, cornerY ) * glyphPosSize.zw;
+
+		// Same math as Colibri::transformQuadCorners
+		float2 colibriPos = glyphCorner;
+		if( (labelData.w & 1u) != 0u )
+		{
+			float scaledY = glyphCorner.y * uintBitsToFloat( labelData.z );
+			colibriPos.x = labelRot0.x * glyphCorner.x + labelRot0.y * scaledY + labelRot0.z;
+			colibriPos.y = labelRot0.w * glyphCorner.x + labelRot1.x * scaledY + labelRot1.y;
+			colibriPos.y *= labelRot1.z;
+		}
+		colibriPos.y = -colibriPos.y;
+		// All 4 vertices of a LabelRecord end up in the same spot, thus nothing is rasterized
+		if( isLabelRecord )
+			colibriPos = float2( 2.0f, 2.0f );
+
+		float2 labelInvSize = uintBitsToFloat( labelData.xy );
+		// Top, Left, Right, Bottom
+		float4 colibriClipDistance = float4( glyphCorner.y - labelClip.y,
+											 glyphCorner.x - labelClip.x,
+											 labelClip.z - glyphCorner.x,
+											 labelClip.w - glyphCorner.y ) *
+									 labelInvSize.yxxy;
+		float4 colibriColour = float4( uint4( glyphData.z, glyphData.z >> 8u,
+											  glyphData.z >> 16u, glyphData.z >> 24u ) & 0xFFu ) / 255.0f;
+
+		@property( hlms_pso_clip_distances >= 4 )
+			gl_ClipDistance[0] = colibriClipDistance.x;
+			gl_ClipDistance[1] = colibriClipDistance.y;
+			gl_ClipDistance[2] = colibriClipDistance.z;
+			gl_ClipDistance[3] = colibriClipDistance.w;
+		@else
+			outVs.emulatedClipDistance = colibriClipDistance;
+		@end
+
+		outVs.uvText.x = cornerX * float( glyphData.x & 0xFFFFu );
+		outVs.uvText.y = cornerY * float( glyphData.x >> 16u );
+		outVs.pixelsPerRow		= glyphData.x & 0xFFFFu;
+		outVs.glyphOffsetStart	= glyphData.y;
+	@end
+
+	@property( colibri_nine_slice )
+		uint colibriVertexId = uint(inVs_vertexId) - worldMaterialIdx[inVs_drawId].w;
+		uint nineSliceRecordIdx = (worldMaterialIdx[inVs_drawId].y + colibriVertexId / 36u) * 11u;
+		// Cells are laid out row by row, 4 vertices each
+		uint cellIdx = (colibriVertexId % 36u) / 4u;
+		uint vertId = colibriVertexId % 4u;
+
+		@property( !use_read_only_buffer )
+			#define colibriNineSliceFetch( i ) bufferFetch( nineSliceRecords, int( nineSliceRecordIdx + i ) )
+		@else
+			#define colibriNineSliceFetch( i ) readOnlyFetch( nineSliceRecords, nineSliceRecordIdx + i )
+		@end
+
+		float4 nineSliceGridX	= uintBitsToFloat( colibriNineSliceFetch( 0u ) );
+		float4 nineSliceGridY	= uintBitsToFloat( colibriNineSliceFetch( 1u ) );
+		float4 nineSliceRot0	= uintBitsToFloat( colibriNineSliceFetch( 2u ) );
+		float4 nineSliceRot1	= uintBitsToFloat( colibriNineSliceFetch( 3u ) );
+		float4 nineSliceClip	= uintBitsToFloat( colibriNineSliceFetch( 4u ) );
+		uint4 nineSliceData		= colibriNineSliceFetch( 5u );
+		uint4 nineSliceUvs		= colibriNineSliceFetch( 6u + cellIdx / 2u );
+
+		// Vertices are laid out TL, BL, BR, TR. See ColibriOgreRenderable::createQuadIndexBuffer
+		uint cornerX = vertId >= 2u ? 1u : 0u;
+		uint cornerY = (vertId == 1u || vertId == 2u) ? 1u : 0u;
+
+		float2 nineSliceCorner = float2( nineSliceGridX[cellIdx % 3u + cornerX],
+										 nineSliceGridY[cellIdx / 3u + cornerY] );
+
+		// Same math as Colibri::transformQuadCorners
+		float2 colibriPos = nineSliceCorner;
+		// See Colibri::NineSliceFlags
+		if( (nineSliceData.w & 1u) != 0u )
+		{
+			float scaledY = nineSliceCorner.y * nineSliceRot1.w;
+			colibriPos.x = nineSliceRot0.x * nineSliceCorner.x + nineSliceRot0.y * scaledY +
+						   nineSliceRot0.z;
+			colibriPos.y = nineSliceRot0.w * nineSliceCorner.x + nineSliceRot1.x * scaledY +
+						   nineSliceRot1.y;
+			colibriPos.y *= nineSliceRot1.z;
+		}
+		colibriPos.y = -colibriPos.y;
+
+		float2 nineSliceInvSize = uintBitsToFloat( nineSliceData.xy );
+		// Top, Left, Right, Bottom
+		float4 colibriClipDistance = float4( nineSliceCorner.y - nineSliceClip.y,
+											 nineSliceCorner.x - nineSliceClip.x,
+											 nineSliceClip.z - nineSliceCorner.x,
+											 nineSliceClip.w - nineSliceCorner.y ) *
+									 nineSliceInvSize.yxxy;
+
+		@property( hlms_pso_clip_distances >= 4 )
+			gl_ClipDistance[0] = colibriClipDistance.x;
+			gl_ClipDistance[1] = colibriClipDistance.y;
+			gl_ClipDistance[2] = colibriClipDistance.z;
+			gl_ClipDistance[3] = colibriClipDistance.w;
+		@else
+			outVs.emulatedClipDistance = colibriClipDistance;
+		@end
+
+		// Even cells use .xy, odd cells use .zw. Each uint packs u | (v << 16)
+		uint2 nineSliceCellUv = (cellIdx & 1u) != 0u ? nineSliceUvs.zw : nineSliceUvs.xy;
+		uint nineSliceU = cornerX != 0u ? nineSliceCellUv.y : nineSliceCellUv.x;
+		uint nineSliceV = cornerY != 0u ? nineSliceCellUv.y : nineSliceCellUv.x;
+		float2 colibriUv = float2( uint2( nineSliceU & 0xFFFFu, nineSliceV >> 16u ) ) / 65535.0f;
+		if( (nineSliceData.w & 2u) != 0u )
+		{
+			// See Colibri::Renderable::_setUvAnimation
+			float2 nineSliceUvAnim = uintBitsToFloat( colibriNineSliceFetch( 10u ).zw );
+			if( (nineSliceData.w & 4u) != 0u )
+				colibriUv = float2( -colibriUv.y, colibriUv.x );
+			colibriUv.x = colibriUv.x * nineSliceUvAnim.x - nineSliceUvAnim.y;
+		}
+		float4 colibriColour = float4( uint4( nineSliceData.z, nineSliceData.z >> 8u,
+											  nineSliceData.z >> 16u, nineSliceData.z >> 24u ) & 0xFFu ) /
+							   255.0f;
+	@end
+@end
+
+@piece( custom_vs_posExecution )
+	@property( colibri_compact_vertices )
+		// SNORM positions are stored scaled down. See Colibri::c_compactPositionScale
+		gl_Position.xy *= float( @value( colibri_compact_position_scale ) );
+	@end
+	@property( colibri_text )
+		// The text Vao is just zeroes. Overwrite what Unlit computed from it
+		gl_Position = float4( colibriPos, 0.0f, 1.0f );
+		outVs.colour = colibriColour;
+	@end
+	@property( colibri_nine_slice )
+		// The 9-slice Vao is just zeroes. Overwrite what Unlit computed from it
+		gl_Position = float4( colibriPos, 0.0f, 1.0f );
+		outVs.colour = colibriColour;
+		@property( out_uv_half_count )
+			outVs.uv0.xy = colibriUv;
+		@end
 	@end
 @end
 
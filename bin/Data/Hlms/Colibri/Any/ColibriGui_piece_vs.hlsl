@@ -1,37 +1,193 @@
 @property( colibri_gui )
 
 @piece( custom_vs_attributes )
-	float4 normal : NORMAL;
-
-	@property( colibri_text )
-		uint tangent : TANGENT;
-		uint2 blendIndices : BLENDINDICES;
+	@property( !colibri_text && !colibri_nine_slice )
+		float4 normal : NORMAL;
 	@end
 
 	uint vertexId : SV_VertexID;
 	#define gl_VertexID input.vertexId
 @end
 
+@piece( custom_vs_uniformDeclaration )
+	@property( colibri_text )
+		// One Colibri::LabelRecord (4x uint4) per Label followed by
+		// one Colibri::GlyphVertex (2x uint4) per glyph
+		Buffer<uint4> glyphRecords : register(t3);
+	@end
+	@property( colibri_nine_slice )
+		// One Colibri::NineSliceRecord (11x uint4) per widget
+		Buffer<uint4> nineSliceRecords : register(t4);
+	@end
+@end
+
 @piece( custom_vs_preExecution )
-	@property( !colibri_text )
+	@property( colibri_nine_slice )
+		// 9 quads per widget, 4 vertices each (drawn indexed)
+		uint colibriDrawId = inVs_drawId + (uint(gl_VertexID) / 36u);
+	@end
+	@property( !colibri_text && !colibri_nine_slice )
 		uint colibriDrawId = inVs_drawId + (uint(gl_VertexID) / 54u);
+	@end
+	@property( !colibri_text )
 		#undef finalDrawId
 		#define finalDrawId colibriDrawId
 	@end
 
 	#define worldViewProj 1.0f
 
-	outVs.gl_ClipDistance0[0] = input.normal.x;
-	outVs.gl_ClipDistance0[1] = input.normal.y;
-	outVs.gl_ClipDistance0[2] = input.normal.z;
-	outVs.gl_ClipDistance0[3] = input.normal.w;
+	@property( !colibri_text && !colibri_nine_slice )
+		outVs.gl_ClipDistance0[0] = input.normal.x;
+		outVs.gl_ClipDistance0[1] = input.normal.y;
+		outVs.gl_ClipDistance0[2] = input.normal.z;
+		outVs.gl_ClipDistance0[3] = input.normal.w;
+	@end
+
+	@property( colibri_text )
+		// Each GlyphVertex is 2x uint4. See Colibri::GlyphVertex
+		uint glyphRecordIdx = (worldMaterialIdx[inVs_drawId].y + uint(gl_VertexID) / 4u) * 2u;
+		uint vertId = uint(gl_VertexID) % 4u;
+
+		#define colibriGlyphFetch( i ) bufferFetch( glyphRecords, int( i ) )
+
+		float4 glyphPosSize	= asfloat( colibriGlyphFetch( glyphRecordIdx ) );
+		uint4 glyphData		= colibriGlyphFetch( glyphRecordIdx + 1u );
+		// Glyphs know where their Label's LabelRecord (4x uint4) is, thus a draw can span
+		// many Labels. The LabelRecords are drawn too, but collapsed. See Colibri::LabelRecord
+		bool isLabelRecord	= glyphData.w >= 0xFFFFFFFEu;
+		uint labelRecordIdx	= isLabelRecord ? 0u : glyphData.w * 2u;
+		float4 labelRot0	= asfloat( colibriGlyphFetch( labelRecordIdx ) );
+		float4 labelRot1	= asfloat( colibriGlyphFetch( labelRecordIdx + 1u ) );
+		float4 labelClip	= asfloat( colibriGlyphFetch( labelRecordIdx + 2u ) );
+		uint4 labelData		= colibriGlyphFetch( labelRecordIdx + 3u );
+
+		// Vertices are laid out TL, BL, BR, TR. See ColibriOgreRenderable::createQuadIndexBuffer
+		float cornerX = vertId >= 2u ? 1.0f : 0.0f;
+		float cornerY = (vertId == 1u || vertId == 2u) ? 1.0f : 0.0f;
+
+		float2 glyphCorner = glyphPosSize.xy + float2( cornerX, cornerY ) * glyphPosSize.zw;
 
+		// Same math as Colibri::transformQuadCorners
+		float2 colibriPos = glyphCorner;
+		if( (labelData.w & 1u) != 0u )
+		{
+			float scaledY = glyphCorner.y * asfloat( labelData.z );
+			colibriPos.x = labelRot0.x * glyphCorner.x + labelRot0.y * scaledY + labelRot0.z;
+			colibriPos.y = labelRot0.w * glyphCorner.x + labelRot1.x * scaledY + labelRot1.y;
+			colibriPos.y *= labelRot1.z;
+		}
+		colibriPos.y = -colibriPos.y;
+		// All 4 vertices of a LabelRecord end up in the same spot, thus nothing is rasterized
+		if( isLabelRecord )
+			colibriPos = float2( 2.0f, 2.0f );
+
+		float2 labelInvSize = asfloat( labelData.xy );
+		// Top, Left, Right, Bottom
+		float4 colibriClipDistance = float4( glyphCorner.y - labelClip.y,
+											 glyphCorner.x - labelClip.x,
+											 labelClip.z - glyphCorner.x,
+											 labelClip.w - glyphCorner.y ) *
+									 labelInvSize.yxxy;
+		float4 colibriColour = float4( uint4( glyphData.z, glyphData.z >> 8u,
+											  glyphData.z >> 16u, glyphData.z >> 24u ) & 0xFFu ) / 255.0f;
+
+		outVs.gl_ClipDistance0[0] = colibriClipDistance.x;
+		outVs.gl_ClipDistance0[1] = colibriClipDistance.y;
+		outVs.gl_ClipDistance0[2] = colibriClipDistance.z;
+		outVs.gl_ClipDistance0[3] = colibriClipDistance.w;
+
+		outVs.uvText.x = cornerX * float( glyphData.x & 0xFFFFu );
+		outVs.uvText.y = cornerY * float( glyphData.x >> 16u );
+		outVs.pixelsPerRow		= glyphData.x & 0xFFFFu;
+		outVs.glyphOffsetStart	= glyphData.y;
+	@end
+
+	@property( colibri_nine_slice )
+		uint nineSliceRecordIdx = (worldMaterialIdx[inVs_drawId].y + uint(gl_VertexID) / 36u) * 11u;
+		// Cells are laid out row by row, 4 vertices each
+		uint cellIdx = (uint(gl_VertexID) % 36u) / 4u;
+		uint vertId = uint(gl_VertexID) % 4u;
+
+		#define colibriNineSliceFetch( i ) bufferFetch( nineSliceRecords, int( nineSliceRecordIdx + i ) )
+
+		float4 nineSliceGridX	= asfloat( colibriNineSliceFetch( 0u ) );
+		float4 nineSliceGridY	= asfloat( colibriNineSliceFetch( 1u ) );
+		float4 nineSliceRot0	= asfloat( colibriNineSliceFetch( 2u ) );
+		float4 nineSliceRot1	= asfloat( colibriNineSliceFetch( 3u ) );
+		float4 nineSliceClip	= asfloat( colibriNineSliceFetch( 4u ) );
+		uint4 nineSliceData		= colibriNineSliceFetch( 5u );
+		uint4 nineSliceUvs		= colibriNineSliceFetch( 6u + cellIdx / 2u );
+
+		// Vertices are laid out TL, BL, BR, TR. See ColibriOgreRenderable::createQuadIndexBuffer
+		uint cornerX = vertId >= 2u ? 1u : 0u;
+		uint cornerY = (vertId == 1u || vertId == 2u) ? 1u : 0u;
+
+		float2 nineSliceCorner = float2( nineSliceGridX[cellIdx % 3u + cornerX],
+										 nineSliceGridY[cellIdx / 3u + cornerY] );
+
+		// Same math as Colibri::transformQuadCorners
+		float2 colibriPos = nineSliceCorner;
+		// See Colibri::NineSliceFlags
+		if( (nineSliceData.w & 1u) != 0u )
+		{
+			float scaledY = nineSliceCorner.y * nineSliceRot1.w;
+			colibriPos.x = nineSliceRot0.x * nineSliceCorner.x + nineSliceRot0.y * scaledY +
+						   nineSliceRot0.z;
+			colibriPos.y = nineSliceRot0.w * nineSliceCorner.x + nineSliceRot1.x * scaledY +
+						   nineSliceRot1.y;
+			colibriPos.y *= nineSliceRot1.z;
+		}
+		colibriPos.y = -colibriPos.y;
+
+		float2 nineSliceInvSize = asfloat( nineSliceData.xy );
+		// Top, Left, Right, Bottom
+		float4 colibriClipDistance = float4( nineSliceCorner.y - nineSliceClip.y,
+											 nineSliceCorner.x - nineSliceClip.x,
+											 nineSliceClip.z - nineSliceCorner.x,
+											 nineSliceClip.w - nineSliceCorner.y ) *
+									 nineSliceInvSize.yxxy;
+
+		outVs.gl_ClipDistance0[0] = colibriClipDistance.x;
+		outVs.gl_ClipDistance0[1] = colibriClipDistance.y;
+		outVs.gl_ClipDistance0[2] = colibriClipDistance.z;
+		outVs.gl_ClipDistance0[3] = colibriClipDistance.w;
+
+		// Even cells use .xy, odd cells use .zw. Each uint packs u | (v << 16)
+		uint2 nineSliceCellUv = (cellIdx & 1u) != 0u ? nineSliceUvs.zw : nineSliceUvs.xy;
+		uint nineSliceU = cornerX != 0u ? nineSliceCellUv.y : nineSliceCellUv.x;
+		uint nineSliceV = cornerY != 0u ? nineSliceCellUv.y : nineSliceCellUv.x;
+		float2 colibriUv = float2( uint2( nineSliceU & 0xFFFFu, nineSliceV >> 16u ) ) / 65535.0f;
+		if( (nineSliceData.w & 2u) != 0u )
+		{
+			// See Colibri::Renderable::_setUvAnimation
+			float2 nineSliceUvAnim = asfloat( colibriNineSliceFetch( 10u ).zw );
+			if( (nineSliceData.w & 4u) != 0u )
+				colibriUv = float2( -colibriUv.y, colibriUv.x );
+			colibriUv.x = colibriUv.x * nineSliceUvAnim.x - nineSliceUvAnim.y;
+		}
+		float4 colibriColour = float4( uint4( nineSliceData.z, nineSliceData.z >> 8u,
+											  nineSliceData.z >> 16u, nineSliceData.z >> 24u ) & 0xFFu ) /
+							   255.0f;
+	@end
+@end
+
+@piece( custom_vs_posExecution )
+	@property( colibri_compact_vertices )
+		// SNORM positions are stored scaled down. See Colibri::c_compactPositionScale
+		outVs.gl_Position.xy *= float( @value( colibri_compact_position_scale ) );
+	@end
 	@property( colibri_text )
-		uint vertId = uint(gl_VertexID) % 6u;
-		outVs.uvText.x = (vertId <= 1u || vertId == 5u) ? 0.0f : float( input.blendIndices.x );
-		outVs.uvText.y = (vertId == 0u || vertId >= 4u) ? 0.0f : float( input.blendIndices.y );
-		outVs.pixelsPerRow		= input.blendIndices.x;
-		outVs.glyphOffsetStart	= input.tangent;
+		// The text Vao is just zeroes. Overwrite what Unlit computed from it
+		outVs.gl_Position = float4( colibriPos, 0.0f, 1.0f );
+		outVs.colour = colibriColour;
+	@end
+	@property( colibri_nine_slice )
+		// The 9-slice Vao is just zeroes. Overwrite what Unlit computed from it
+		outVs.gl_Position = float4( colibriPos, 0.0f, 1.0f );
+		outVs.colour = colibriColour;
+		@property( out_uv_half_count )
+			outVs.uv0.xy = colibriUv;
+		@end
 	@end
 @end
 
@@ -46,6 +46,7 @@ namespace Colibri
 	class Checkbox;
 	class ColibriManager;
 	class Editbox;
+	class HitTestGrid;
 	class Label;
 	class LabelBmp;
 	class LayoutCell;
@@ -60,6 +61,7 @@ namespace Colibri
 	class Slider;
 	class Spinner;
 	class Widget;
+	class WidgetPool;
 	class Window;
 
 	namespace LogSeverity
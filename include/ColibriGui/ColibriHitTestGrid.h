@@ -0,0 +1,90 @@
+
+#pragma once
+
+#include "ColibriGui/ColibriGuiPrerequisites.h"
+
+#include "OgreVector2.h"
+
+#include <vector>
+
+COLIBRI_ASSUME_NONNULL_BEGIN
+
+namespace Colibri
+{
+	typedef std::vector<Widget *> WidgetVec;
+
+	/**
+	@class HitTestGrid
+		Uniform grid over the (non-window) children of a widget, used to find which children
+		may be under the cursor without testing all of them.
+
+		It's built in the parent's local space (i.e. from Widget::m_position & m_size, the
+		same space as Widget::intersectsChild) so that it stays valid while scrolling or
+		moving the parent. Only moving, resizing, adding, removing or reordering children
+		makes it dirty.
+
+		The grid is conservative: it returns candidates that must still be tested for real.
+		Children that cover too many cells are kept in a separate list instead of being
+		repeated in every cell.
+
+		See Widget::_setIdleCursorMoved
+	*/
+	class HitTestGrid
+	{
+	public:
+		/// Widgets with fewer (non-window) children than this don't use a grid
+		static const size_t c_minChildrenForGrid;
+		static const uint32_t c_maxCellsPerAxis;
+
+	protected:
+		Ogre::Vector2 m_origin;
+		Ogre::Vector2 m_invCellSize;
+		uint32_t      m_numCellsX;
+		uint32_t      m_numCellsY;
+
+		/// The children of cell i are m_cellEntries[m_cellStart[i]; m_cellStart[i+1]).
+		/// Each cell's children are sorted by their index to Widget::m_children
+		std::vector<uint32_t> m_cellStart;
+		std::vector<uint32_t> m_cellEntries;
+		/// Index to Widget::m_children of children too big to put in cells. Sorted
+		std::vector<uint32_t> m_bigEntries;
+
+		/// Children's boxes are enlarged by this much, so that rounding differences
+		/// against Widget::intersects never make us miss a child
+		Ogre::Vector2 m_padding;
+
+		/// Number of children the grid was built with
+		size_t m_numChildren;
+		bool   m_dirty;
+
+		/// Calculates the cells touched by the child's box (plus m_padding)
+		void getCellRange( const Widget *child, uint32_t &outMinX, uint32_t &outMinY,
+						   uint32_t &outMaxX, uint32_t &outMaxY ) const;
+		uint32_t toCell( float value, uint32_t numCells ) const;
+
+	public:
+		HitTestGrid();
+
+		void setDirty() { m_dirty = true; }
+
+		/// Rebuilds the grid if it's dirty or numChildren changed.
+		/// children[0; numChildren) must be the non-window children of the widget
+		void update( const WidgetVec &children, size_t numChildren );
+
+		/** Retrieves the children in the cell that contains localPos
+		@param localPos
+			In the same space as Widget::m_position of the children
+		@param outBegin [out]
+		@param outEnd [out]
+			Range of indices to Widget::m_children, sorted. May be empty.
+			getBigEntries must be tested too
+		*/
+		void queryCell( const Ogre::Vector2 &localPos, const uint32_t *colibri_nullable &outBegin,
+						const uint32_t *colibri_nullable &outEnd ) const;
+
+		/// Children that are too big to be in cells. Must always be tested. Sorted
+		const std::vector<uint32_t> &getBigEntries() const { return m_bigEntries; }
+	};
+}  // namespace Colibri
+
+COLIBRI_ASSUME_NONNULL_END
@@ -50,6 +50,26 @@ namespace Colibri
 		/// For internal use. Set to true if any of RichText uses background, false otherwise.
 		bool m_usesBackground;
 
+		/// Label-local, pixel-snapped rectangle of a visible glyph. Already converted
+		/// to NDC units (i.e. multiplied by ColibriManager::getInvWindowResolution2x)
+		struct GlyphQuad
+		{
+			Ogre::Vector2	topLeft;
+			Ogre::Vector2	bottomRight;
+			uint32_t		offsetStart;
+			uint16_t		width;
+			uint16_t		height;
+			uint32_t		richTextIdx;
+		};
+		typedef std::vector<GlyphQuad> GlyphQuadVec;
+
+		/// Quads of m_shapes[m_currentState], so that _fillBuffersAndCommands doesn't
+		/// have to recalculate them every frame. See updateGlyphQuads
+		GlyphQuadVec	m_glyphQuads;
+		/// The value of getInvWindowResolution2x m_glyphQuads was built with
+		Ogre::Vector2	m_glyphQuadsInvWindowRes;
+		bool			m_glyphQuadsDirty;
+
 	public:
 		/// When true (default) text will be clipped against the widget's size.
 		///
@@ -89,7 +109,10 @@ namespace Colibri
 		LabelBmp *colibri_nullable m_rasterPrivateArea;
 
 		/// Returns a RasterHelper for the given state. Creates one if it doesn't exist.
+		/// Does not create m_rasterPrivateArea. See createRasterPrivateArea
 		PrivateAreaGlyphsVec *createPrivateAreaGlyphs( States::States state );
+		/// Creates m_rasterPrivateArea. Must be called from the main thread
+		void createRasterPrivateArea();
 
 		/// Returns a RasterHelper for the given state. Nullptr if it doesn't exist.
 		PrivateAreaGlyphsVec *colibri_nullable getPrivateAreaGlyphs( States::States state );
@@ -113,6 +136,15 @@ namespace Colibri
 		*/
 		colibri_virtual_l1 void updateGlyphs( States::States state, bool bPlaceGlyphs=true );
 
+		/** The part of updateGlyphs that is safe to call from a shaping worker thread.
+			It doesn't place the glyphs, nor creates m_rasterPrivateArea, nor notifies
+			ColibriManager that the number of glyphs may have changed.
+		@param state
+		@param threadIdx
+			See ShaperManager::setNumShapingThreads
+		*/
+		void shapeGlyphs( States::States state, size_t threadIdx );
+
 		/** Places the glyphs obtained from updateGlyphs at the correct position
 			(always assuming TextHorizAlignment::Left) considering word wrap
 			and size bounds.
@@ -147,13 +179,12 @@ namespace Colibri
 							 uint16_t glyphWidth,
 							 uint16_t glyphHeight,
 							 uint32_t rgbaColour,
-							 Ogre::Vector2 parentDerivedTL,
-							 Ogre::Vector2 parentDerivedBR,
-							 Ogre::Vector2 invSize,
 							 uint32_t offset,
-							 float canvasAspectRatio,
-							 float invCanvasAspectRatio,
-							 const Matrix2x3& derivedRot );
+							 uint32_t labelRecordIdx );
+
+		/// Rebuilds m_glyphQuads from m_shapes[m_currentState].
+		/// Must be called after glyphs have been placed & aligned.
+		void updateGlyphQuads( const Ogre::Vector2 &invWindowRes );
 
 	public:
 		Label( ColibriManager *manager );
@@ -233,6 +264,13 @@ namespace Colibri
 		*/
 		void _updateDirtyGlyphs();
 
+		/// Multithreaded version of _updateDirtyGlyphs, split in two stages.
+		/// _shapeDirtyGlyphs can be called from a shaping worker thread.
+		/// See ShaperManager::setNumShapingThreads
+		void _shapeDirtyGlyphs( size_t threadIdx );
+		/// Must be called from the main thread, after _shapeDirtyGlyphs is done
+		void _placeDirtyGlyphs();
+
 		/** Returns the max number of glyphs needed to render
 		@return
 			It's not the sum of all states, but rather the maximum of all states,
@@ -407,13 +445,13 @@ namespace Colibri
 		GlyphVertex* fillBackground( GlyphVertex * RESTRICT_ALIAS textVertBuffer,
 									 const Ogre::Vector2 halfWindowRes,
 									 const Ogre::Vector2 invWindowRes,
-									 const Ogre::Vector2 parentDerivedTL,
-									 const Ogre::Vector2 parentDerivedBR,
-									 const bool isHorizontal );
+									 const bool isHorizontal,
+									 const uint32_t labelRecordIdx );
 
 		void _fillBuffersAndCommands(
 			UiVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS vertexBuffer,
 			GlyphVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS textVertBuffer,
+			NineSliceRecord *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS nineSliceBuffer,
 			const Ogre::Vector2 &parentPos, const Ogre::Vector2 &parentCurrentScrollPos,
 			const Matrix2x3 &parentRot ) override;
 
@@ -155,6 +155,7 @@ namespace Colibri
 		void _fillBuffersAndCommands(
 			UiVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS vertexBuffer,
 			GlyphVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS textVertBuffer,
+			NineSliceRecord *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS nineSliceBuffer,
 			const Ogre::Vector2 &parentPos, const Ogre::Vector2 &parentCurrentScrollPos,
 			const Matrix2x3 &parentRot ) override;
 
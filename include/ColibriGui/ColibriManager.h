@@ -1,7 +1,10 @@
 
 #pragma once
 
+#include "ColibriGui/ColibriNavigationGrid.h"
+#include "ColibriGui/ColibriTransformStore.h"
 #include "ColibriGui/ColibriWidget.h"
+#include "ColibriGui/ColibriWidgetPool.h"
 
 #include "OgreIdString.h"
 
@@ -100,6 +103,21 @@ namespace Colibri
 
 	public:
 		static const std::string c_defaultTextDatablockNames[States::NumStates];
+		/// When ShaperManager::getNumShapingThreads > 1, dirty Labels are shaped
+		/// in parallel if there are at least this many of them
+		static const size_t c_minDirtyLabelsForThreading;
+		/// Buffers which are c_bufferShrinkRatio times bigger than needed for
+		/// c_framesBeforeBufferShrink consecutive frames are shrunk
+		static const size_t c_bufferShrinkRatio;
+		static const uint32_t c_framesBeforeBufferShrink;
+		/// Buffers that scale with the number of widgets are split in chunks of these sizes.
+		/// More chunks are appended as needed, so growing never reallocates nor copies what
+		/// already exists. See checkVertexBufferCapacity
+		static const size_t c_indirectDrawsPerChunk;
+		static const size_t c_nineSliceRecordsPerChunk;
+		/// Chunks get bigger if the biggest Label (or LabelBmp) wouldn't fit twice in them
+		static const size_t c_glyphRecordsPerChunk;
+		static const size_t c_labelBmpVerticesPerChunk;
 
 	protected:
 		WindowVec m_windows;
@@ -110,9 +128,16 @@ namespace Colibri
 		size_t   m_numLabelsAndBmp;   /// Counts both Labels and LabelBmps
 		size_t   m_numTextGlyphs;     /// It's an upper bound. Current max number of glyphs may be lower
 		size_t   m_numTextGlyphsBmp;  /// It's an upper bound. Current max number of glyphs may be lower
+		size_t   m_maxLabelGlyphs;    /// Glyphs of the biggest Label (upper bound). See m_quadIndexBuffer
+		size_t   m_maxLabelBmpGlyphs; /// Upper bound of the glyphs of the biggest LabelBmp
+		/// Number of consecutive frames any buffer has been oversized. See c_bufferShrinkRatio
+		uint32_t m_numFramesBuffersOversized;
 		LabelVec m_dirtyLabels;
 		LabelBmpVec m_dirtyLabelBmps;
 		WidgetVec m_dirtyWidgets;
+		/// Widgets whose children haven't been notified of a transform change yet.
+		/// See propagateTransformDirty
+		WidgetVec m_transformDirtyQueue;
 		/// Some widgets require getting called every frame for updates.
 		/// Those widgets are listed here
 		WidgetVec m_updateWidgets;
@@ -136,11 +161,20 @@ namespace Colibri
 		bool                  m_delayingDestruction;
 
 		bool m_swapRTLControls;
+		bool m_compactVertexFormat;
 		bool m_windowNavigationDirty;
+		/// Scratch data for autosetNavigation
+		NavigationGrid m_navigationGrid;
+		WidgetVec      m_navigableWidgets;
 		bool m_numGlyphsDirty;
 		bool m_numGlyphsBmpDirty;
 
 		bool m_widgetTransformsDirty;
+		/// Derived transforms of all widgets. See updateAllDerivedTransforms
+		TransformStore m_transformStore;
+
+		/// One pool per widget size. See _createWidget
+		std::vector<WidgetPool *> m_widgetPools;
 
 		/// Is any widget dirty
 		bool m_zOrderWidgetDirty;
@@ -151,9 +185,25 @@ namespace Colibri
 		Ogre::VaoManager			* colibri_nullable m_vaoManager;
 		Ogre::ObjectMemoryManager	* colibri_nullable m_objectMemoryManager;
 		Ogre::SceneManager			* colibri_nullable m_sceneManager;
-		Ogre::VertexArrayObject		* colibri_nullable m_vao;
+		/// LabelBmp vertices, in chunks of equal size. LabelBmps are created with m_vaos[0], and
+		/// draw with the chunk their vertices were written to. See Renderable::m_currChunk
+		std::vector<Ogre::VertexArrayObject *> m_vaos;
+		/// As big as m_quadIndexBuffer: holds the biggest Label or many smaller ones
 		Ogre::VertexArrayObject		* colibri_nullable m_textVao;
-		Ogre::IndirectBufferPacked	* colibri_nullable m_indirectBuffer;
+		/// Fixed size, holds c_maxNineSliceWidgetsPerDraw widgets
+		Ogre::VertexArrayObject		* colibri_nullable m_nineSliceVao;
+		/// Shared by m_textVao & m_nineSliceVao. See ColibriOgreRenderable::createQuadIndexBuffer
+		Ogre::IndexBufferPacked		* colibri_nullable m_quadIndexBuffer;
+		/// One LabelRecord per Label followed by one GlyphVertex per glyph, in chunks of equal
+		/// size. A Label never crosses chunks. Either TexBufferPacked or ReadOnlyBufferPacked
+		std::vector<Ogre::BufferPacked *> m_glyphRecordBuffers;
+		/// One NineSliceRecord per widget, in chunks of c_nineSliceRecordsPerChunk.
+		/// Same buffer type as m_glyphRecordBuffers
+		std::vector<Ogre::BufferPacked *> m_nineSliceRecordBuffers;
+		/// In chunks of c_indirectDrawsPerChunk. See _mapNextIndirectBuffer
+		std::vector<Ogre::IndirectBufferPacked *> m_indirectBuffers;
+		/// Chunk of m_indirectBuffers being written to in render()
+		size_t						m_currIndirectBuffer;
 		Ogre::CommandBuffer			* colibri_nullable m_commandBuffer;
 		Ogre::HlmsDatablock			* colibri_nullable m_defaultTextDatablock[States::NumStates];
 
@@ -203,8 +253,17 @@ namespace Colibri
 				m_defaultSkins[SkinWidgetTypes::NumSkinWidgetTypes][States::NumStates];
 		Ogre::IdString m_defaultSkinPackNames[SkinWidgetTypes::NumSkinWidgetTypes];
 
+		/// Start & end of the chunks being written to in prepareRenderCommands
 		UiVertex		*m_vertexBufferBase;
+		UiVertex		*m_vertexBufferEnd;
 		GlyphVertex		*m_textVertexBufferBase;
+		GlyphVertex		*m_textVertexBufferEnd;
+		NineSliceRecord	*m_nineSliceRecordBufferBase;
+		NineSliceRecord	*m_nineSliceRecordBufferEnd;
+		/// Index of those chunks in m_vaos, m_glyphRecordBuffers & m_nineSliceRecordBuffers
+		uint32_t		m_currVertexChunk;
+		uint32_t		m_currGlyphRecordChunk;
+		uint32_t		m_currNineSliceRecordChunk;
 
 #if COLIBRIGUI_DEBUG_MEDIUM
 		bool m_fillBuffersStarted;
@@ -216,6 +275,20 @@ namespace Colibri
 		void updateWidgetsFocusedByCursor();
 		void updateAllDerivedTransforms();
 
+		/** Notifies the children of every widget in m_transformDirtyQueue, recursively.
+			Widgets with a pending ancestor are skipped since that ancestor will cover them,
+			thus each subtree is walked once per frame no matter how many times (or how many
+			of its widgets) setTransformDirty got called
+		*/
+		void propagateTransformDirty();
+		/// Removes the widget from m_dirtyWidgets & m_transformDirtyQueue. Used on destruction
+		void removeFromTransformDirtyLists( Widget *widget );
+
+		/// Removes the widgets flagged by destroyWidgetTree from the registry in a single pass,
+		/// keeping the indices of the remaining ones up to date. Returns how many were removed
+		template <typename T>
+		size_t purgeTreeBeingDestroyed( std::vector<T *> &registry, uint32_t Widget::*idx );
+
 		/// When pressing a mouse button on a widget, that overrides whatever keyboard was on.
 		void overrideKeyboardFocusWith( const FocusPair &focusedPair );
 		void overrideCursorFocusWith( const FocusPair &focusedPair );
@@ -226,6 +299,35 @@ namespace Colibri
 		void _updateDirtyLabels();
 
 	protected:
+		/// Shapes all m_dirtyLabels using ShaperManager::getNumShapingThreads threads
+		void updateDirtyLabelsThreaded();
+
+		bool useReadOnlyRecordBuffers() const;
+		/// Returns true if a buffer of currSize is c_bufferShrinkRatio times bigger than requiredSize.
+		/// Buffers are never considered oversized when they're at minSize or below
+		static bool isBufferOversized( size_t requiredSize, size_t currSize, size_t minSize );
+		/** Returns how many chunks are needed to hold requiredSize elements. Always at least 1
+		@param usablePerChunk
+			How many elements a chunk is guaranteed to hold. When a widget doesn't fit in what's
+			left of a chunk it moves on to the next one, thus up to (biggest widget - 1)
+			elements may be wasted at the end of every chunk
+		*/
+		static size_t calculateNumChunks( size_t requiredSize, size_t usablePerChunk );
+		/** Appends or removes chunks from the back until there are numChunks left.
+			If the chunk size changed, all chunks are recreated instead
+		@param chunks [in/out]
+		@param numChunks
+		@param chunkBytes
+			Size of each chunk
+		*/
+		void resizeRecordBuffers( std::vector<Ogre::BufferPacked *> &chunks, size_t numChunks,
+								  size_t chunkBytes );
+		/// Returns true if m_vaos[0] got recreated. See resizeRecordBuffers
+		bool resizeVaos( size_t numChunks, size_t chunkVertices );
+		void resizeIndirectBuffers( size_t numChunks );
+		void destroyAllChunks();
+		/// Maps the first chunk of each buffer written by _fillBuffersAndCommands
+		void mapFirstChunks();
 		void checkVertexBufferCapacity();
 
 		template <typename T>
@@ -252,12 +354,24 @@ namespace Colibri
 					  Ogre::SceneManager * colibri_nullable sceneManager );
 		Ogre::ObjectMemoryManager* getOgreObjectMemoryManager()		{ return m_objectMemoryManager; }
 		Ogre::SceneManager* getOgreSceneManager()					{ return m_sceneManager; }
-		Ogre::VertexArrayObject* getVao()							{ return m_vao; }
+		Ogre::VertexArrayObject* getVao()							{ return m_vaos.front(); }
 		Ogre::VertexArrayObject* getTextVao()						{ return m_textVao; }
+		Ogre::VertexArrayObject* getNineSliceVao()					{ return m_nineSliceVao; }
 		Ogre::HlmsDatablock * colibri_nonnull * colibri_nullable getDefaultTextDatablock()
 																	{ return m_defaultTextDatablock; }
 		Ogre::HlmsManager *getOgreHlmsManager();
 
+		/** When true, LabelBmp vertices use UiVertexCompact (SNORM16 positions, half float
+			clip distances) instead of UiVertex, which saves 37.5% of their bandwidth.
+			Useful on mobile.
+
+			Must be called before setOgre.
+		*/
+		void setCompactVertexFormat( bool compactVertexFormat );
+		bool useCompactVertexFormat() const							{ return m_compactVertexFormat; }
+		/// Returns sizeof( UiVertexCompact ) or sizeof( UiVertex ). See setCompactVertexFormat
+		size_t getVertexSize() const;
+
 		/// When true, swaps the controls for RTL languages such as arabic. That means spinners
 		/// increment when clicking left button, for example
 		void setSwapRTLControls( bool swapRtl );
@@ -434,6 +548,14 @@ namespace Colibri
 		void destroyWindow( Window *window );
 		void destroyWidget( Widget *widget );
 
+		/** Same as destroyWindow, but meant for big trees (e.g. switching menu pages).
+			The whole tree is flagged first, then removed from our internal lists with a single
+			sweep per list, instead of every widget removing itself one by one
+		*/
+		void destroyWindowTree( Window *window );
+		/// Same as destroyWindowTree, but for a widget and all of its children. See destroyWidget
+		void destroyWidgetTree( Widget *widget );
+
 		bool _isDelayingDestruction() const { return m_delayingDestruction; }
 
 		/// Safely calls widget->_callActionListeners( action )
@@ -462,6 +584,10 @@ namespace Colibri
 		/// For internal use. Do NOT call directly
 		void _scheduleSetTransformDirty( Widget *widget );
 
+		/// Called by Widget::setTransformDirty the first time its children need to be notified.
+		/// For internal use. Do NOT call directly
+		void _queueTransformDirty( Widget *widget );
+
 		/// Some widgets require getting called every frame for updates.
 		/// They register themselves via this interface.
 		/// For internal use.
@@ -475,6 +601,9 @@ namespace Colibri
 		void _setWindowNavigationDirty();
 
 		void _setWidgetTransformsDirty();
+		/// Must be called when widgets are attached to/detached from a parent or destroyed.
+		/// See TransformStore::setLayoutDirty
+		void _setTransformLayoutDirty();
 
 		/// If creating a custom label widget, this must be called on creation.
 		void _notifyLabelCreated( Label* label );
@@ -497,30 +626,94 @@ namespace Colibri
 		void prepareRenderCommands();
 		void render();
 
+		/// Start of the chunk currently being written to. See _reserveVertices
 		const UiVertex* _getVertexBufferBase() const
 		{
 			COLIBRI_ASSERT_HIGH( m_fillBuffersStarted );
 			return m_vertexBufferBase;
 		}
 
+		/// Start of the chunk currently being written to. See _reserveGlyphRecords
 		const GlyphVertex* _getTextVertexBufferBase() const
 		{
 			COLIBRI_ASSERT_HIGH( m_fillBuffersStarted );
 			return m_textVertexBufferBase;
 		}
 
+		/// Start of the chunk currently being written to. See _reserveNineSliceRecords
+		const NineSliceRecord* _getNineSliceRecordBufferBase() const
+		{
+			COLIBRI_ASSERT_HIGH( m_fillBuffersStarted );
+			return m_nineSliceRecordBufferBase;
+		}
+
+		/** Ensures numVertices can be written to vertexBuffer without crossing into the next
+			chunk. If they don't fit, the current chunk is unmapped and the next one is mapped.
+			Called by _fillBuffersAndCommands before writing each widget.
+		@param vertexBuffer
+			Where the widget would write next
+		@param numVertices
+			Upper bound of what the widget will write
+		@param outChunk [out]
+			Index of the chunk the widget will be written to
+		@return
+			Where the widget must write to. It's vertexBuffer if it fits.
+		*/
+		UiVertex *_reserveVertices( UiVertex *vertexBuffer, size_t numVertices,
+									uint32_t &outChunk );
+		/// See _reserveVertices
+		GlyphVertex *_reserveGlyphRecords( GlyphVertex *textVertBuffer, size_t numRecords,
+										   uint32_t &outChunk );
+		/// See _reserveVertices
+		NineSliceRecord *_reserveNineSliceRecords( NineSliceRecord *nineSliceBuffer,
+												   size_t numRecords, uint32_t &outChunk );
+
+		/// The chunks Renderable::_addCommands reads from. See Renderable::m_currChunk
+		Ogre::VertexArrayObject *_getVao( uint32_t chunk ) const { return m_vaos[chunk]; }
+		Ogre::BufferPacked *_getGlyphRecordBuffer( uint32_t chunk ) const
+		{
+			return m_glyphRecordBuffers[chunk];
+		}
+		Ogre::BufferPacked *_getNineSliceRecordBuffer( uint32_t chunk ) const
+		{
+			return m_nineSliceRecordBuffers[chunk];
+		}
+
+		/// Called by Renderable::_addCommands when the next draw doesn't fit in what's left of
+		/// the current indirect buffer chunk. Unmaps it and makes apiObject point to the next
+		void _mapNextIndirectBuffer( ApiEncapsulatedObjects &apiObject );
+
 #if __clang__
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wnullability-completeness"
 #endif
 	protected:
+		/// Returns the pool for widgets of the given size. Creates it if it doesn't exist
+		WidgetPool *getWidgetPool( size_t sizeBytes );
+
+		/// Constructs a T from the pool for its size
+		template <typename T>
+		T * colibri_nonnull allocateWidget()
+		{
+			static_assert( alignof( T ) <= WidgetPool::c_alignment,
+						   "Widget has greater alignment than WidgetPool supports" );
+
+			WidgetPool *pool = getWidgetPool( sizeof( T ) );
+			T *retVal = ::new( pool->allocate() ) T( this );
+			retVal->m_widgetPool = pool;
+			return retVal;
+		}
+
+		/// Destroys the widget and returns its memory to the pool it came from
+		void freeWidget( Widget *widget );
+
 		/// Parent cannot be null
 		template <typename T>
 		T * colibri_nonnull _createWidget( Widget * colibri_nonnull parent )
 		{
 			COLIBRI_ASSERT( parent && "parent must be provided!" );
 
-			T *retVal = new T( this );
+			T *retVal = allocateWidget<T>();
 
 			retVal->_setParent( parent );
 			retVal->_initialize();
@@ -536,6 +729,32 @@ namespace Colibri
 		{
 			return _createWidget<T>( parent );
 		}
+
+		/** Creates numWidgets widgets of the same type, all children of parent.
+			It's the same as calling createWidget numWidgets times, except the memory for
+			the widgets and for parent's list of children is reserved up front.
+		@param parent
+			Cannot be null
+		@param numWidgets
+		@return
+			The new widgets, in creation order
+		*/
+		template <typename T>
+		std::vector<T *> createWidgets( Widget * colibri_nonnull parent, size_t numWidgets )
+		{
+			COLIBRI_ASSERT( parent && "parent must be provided!" );
+
+			std::vector<T *> retVal;
+			retVal.reserve( numWidgets );
+
+			getWidgetPool( sizeof( T ) )->reserve( numWidgets );
+			parent->m_children.reserve( parent->m_children.size() + numWidgets );
+
+			for( size_t i = 0u; i < numWidgets; ++i )
+				retVal.push_back( createWidget<T>( parent ) );
+
+			return retVal;
+		}
 #if __clang__
 	#pragma clang diagnostic pop
 #endif
@@ -0,0 +1,86 @@
+
+#pragma once
+
+#include "ColibriGui/ColibriGuiPrerequisites.h"
+
+#include "OgreVector2.h"
+
+#include <vector>
+
+COLIBRI_ASSUME_NONNULL_BEGIN
+
+namespace Colibri
+{
+	typedef std::vector<Widget *> WidgetVec;
+
+	/**
+	@class NavigationGrid
+		Uniform grid used by ColibriManager::autosetNavigation to find the closest sibling
+		in each direction without comparing every widget against every other widget.
+
+		autosetNavigation compares the same corner of both widgets (top left against top left,
+		top right against top right, etc) thus each corner gets its own grid of points.
+		Queries walk the cells in rings around the widget, only looking at the cells inside
+		the cone of the requested direction, and stop as soon as no unvisited cell can hold
+		anything closer than the best candidate found so far.
+
+		Candidates are evaluated with the exact same math as the brute force version, and
+		ties are broken the same way (the candidate that comes first wins), thus the results
+		are identical.
+	*/
+	class NavigationGrid
+	{
+	public:
+		static const uint32_t c_maxCellsPerAxis;
+		/// Returned by findClosest when there is no widget in that direction
+		static const uint32_t c_invalidIdx;
+
+	protected:
+		struct CellRange
+		{
+			uint16_t minX;
+			uint16_t minY;
+			uint16_t maxX;
+			uint16_t maxY;
+		};
+
+		/// 4 corners per widget: top left, top right, bottom left, bottom right
+		std::vector<Ogre::Vector2> m_corners;
+		/// m_remainingCells[i * 4 + corner] contains the cells of that corner of all the
+		/// widgets after i (i.e. the only ones findClosest( i ) looks at). Empty if min > max
+		std::vector<CellRange> m_remainingCells;
+
+		Ogre::Vector2 m_origin;
+		float         m_cellSize;
+		float         m_invCellSize;
+		uint32_t      m_numCellsX;
+		uint32_t      m_numCellsY;
+
+		/// One grid per corner. The widgets of cell i are
+		/// m_cellEntries[corner][m_cellStart[corner][i]; m_cellStart[corner][i+1]), sorted
+		std::vector<uint32_t> m_cellStart[4];
+		std::vector<uint32_t> m_cellEntries[4];
+
+		uint32_t toCell( float value, uint32_t numCells ) const;
+		void getCell( const Ogre::Vector2 &pos, uint32_t &outX, uint32_t &outY ) const;
+
+	public:
+		NavigationGrid();
+
+		/// Rebuilds the grid. widgets must be keyboard navigable, and in the same
+		/// order autosetNavigation visits them
+		void build( const WidgetVec &widgets );
+
+		/** Finds the closest widget in the given direction, searching only
+			among the widgets that come after widgetIdx
+		@param widgetIdx
+			Index to the widgets passed to build
+		@param direction
+		@return
+			Index to the widgets passed to build. c_invalidIdx if there's none
+		*/
+		uint32_t findClosest( uint32_t widgetIdx, Borders::Borders direction ) const;
+	};
+}  // namespace Colibri
+
+COLIBRI_ASSUME_NONNULL_END
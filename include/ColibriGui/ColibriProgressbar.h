@@ -6,11 +6,6 @@
 #include "OgreId.h"
 #include "OgreIdString.h"
 
-namespace Ogre
-{
-	class HlmsUnlitDatablock;
-}
-
 COLIBRI_ASSUME_NONNULL_BEGIN
 
 namespace Colibri
@@ -24,11 +19,9 @@ namespace Colibri
 		Unlike most widgets, Progressbars only support States::Disabled and States::Idle.
 		All other states will look like States::Idle regardless of what the skin pack says
 
-		This class has a tighter integration with Ogre3D (i.e. breaks 3D isolation) due
-		to having to clone the material and animate it for every instance of the Progressbar.
-
-		Regular Widgets are better isolated due to being able to share materials,
-		and referencing them only by name
+		Animated Progressbars scroll the UVs of their progress layer via
+		Renderable::_setUvAnimation, thus all Progressbars using the same skin
+		share the same material. That material is set to TAM_WRAP.
 	*/
 	class Progressbar final : public Widget, Ogre::IdObject
 	{
@@ -58,21 +51,15 @@ namespace Colibri
 		float       m_accumTime;
 		DisplayType m_displayType;
 
-		Ogre::HlmsUnlitDatablock *colibri_nullable m_progressLayerDatablock[2];
-
-		/// Stores a hard copy for idle & disabled, with a custom material so we can animate it
-		SkinInfo *colibri_nullable m_skinCopy;
-
 		/// Assumes m_displayType has already been set
-		void cloneSkinAndDatablock( Ogre::IdString skinPackName,
-									const SkinInfo *colibri_nonnull *colibri_nonnull
-										outSkinInfos );
+		void setupProgressSkins( Ogre::IdString skinPackName,
+								 const SkinInfo *colibri_nonnull *colibri_nonnull outSkinInfos );
 		/// Assumes m_displayType has already been set
-		void cloneSkinAndDatablock( SkinInfo const *colibri_nonnull const *colibri_nonnull
-																						   skinInfos,
-									const SkinInfo *colibri_nonnull *colibri_nonnull outSkinInfos,
-									const bool                                             bIsAnimated );
-		void destroyClonedData();
+		void setupProgressSkins( SkinInfo const *colibri_nonnull const *colibri_nonnull skinInfos,
+								 const SkinInfo *colibri_nonnull *colibri_nonnull outSkinInfos,
+								 const bool bIsAnimated );
+		/// Animated progress layers scroll their UVs, so the material must repeat
+		void setWrapAddressing( Ogre::IdString datablockName );
 		void updateProgressbar();
 
 	public:
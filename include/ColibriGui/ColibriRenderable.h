@@ -8,8 +8,7 @@
 
 namespace Ogre
 {
-	struct CbDrawCallStrip;
-	struct CbDrawStrip;
+	struct CbDrawCall;
 	class HlmsColibri;
 }
 
@@ -39,15 +38,132 @@ namespace Colibri
 		float clipDistance[Borders::NumBorders];
 	};
 
+	/// Positions in UiVertexCompact are stored as NDC / c_compactPositionScale so that
+	/// widgets partially outside the screen still fit in SHORT2_SNORM.
+	/// Shaders get it from the colibri_compact_position_scale Hlms property, thus it
+	/// must be a whole number.
+	const float c_compactPositionScale = 4.0f;
+
+	/** Used instead of UiVertex when ColibriManager::setCompactVertexFormat is enabled.
+		20 bytes instead of 32.
+	*/
+	struct UiVertexCompact
+	{
+		int16_t x;  /// SNORM. See c_compactPositionScale
+		int16_t y;
+		uint16_t u;
+		uint16_t v;
+		uint8_t rgbaColour[4];
+		uint16_t clipDistance[Borders::NumBorders];  /// Half floats
+	};
+
+	/// Converts an NDC position into UiVertexCompact::x or y. Positions beyond
+	/// +/- c_compactPositionScale are clamped, which keeps them off screen
+	inline int16_t toCompactPosition( float ndc )
+	{
+		const float snorm = Ogre::Math::Clamp( ndc * ( 1.0f / c_compactPositionScale ), -1.0f, 1.0f );
+		return static_cast<int16_t>( roundf( snorm * 32767.0f ) );
+	}
+
+	/** Despite its name, there is one GlyphVertex per glyph quad, not per vertex.
+		The vertex shader fetches it from a buffer (see HlmsColibri::setGlyphRecordBuffer)
+		and expands it into the 4 vertices of the quad using the vertex ID.
+
+		The quad is stored unrotated. Rotation and clipping are the same for all
+		glyphs of a Label, thus they live in the Label's LabelRecord.
+
+		Must be 32 bytes (2x uint4) as that's how the shader reads it.
+	*/
 	struct GlyphVertex
 	{
-		float x;
-		float y;
+		float topLeft[2];
+		float size[2];  /// Bottom right corner - top left corner
 		uint16_t width;
 		uint16_t height;
 		uint32_t offset;
 		uint32_t rgbaColour;
-		float clipDistance[Borders::NumBorders];
+		/// Where the Label's LabelRecord is in the glyph record buffer chunk,
+		/// in GlyphVertex units
+		uint32_t labelRecordIdx;
+	};
+
+	/// Both halves of a LabelRecord have it where GlyphVertex::labelRecordIdx would be.
+	/// The lowest bit is free (see LabelRecord::markerAndIsRotated)
+	const uint32_t c_labelRecordMarker = 0xFFFFFFFEu;
+
+	/** Each Label writes one LabelRecord into the glyph record buffer, followed by
+		its GlyphVertex, which point back to it (see GlyphVertex::labelRecordIdx).
+
+		This way the clip rectangle is sent once per Label instead of sending
+		4 clip distances with every vertex, and consecutive Labels can still share
+		a draw. The LabelRecord is part of the draw too: the vertex shader sees it as
+		2 glyphs with c_labelRecordMarker and collapses them so nothing gets rasterized.
+
+		Must be 64 bytes (4x uint4, i.e. c_labelRecordSlots GlyphVertex).
+	*/
+	struct LabelRecord
+	{
+		float derivedRot[2][3];
+		float canvasAspectRatio;
+		/// c_labelRecordMarker
+		uint32_t marker;
+		float parentDerivedTL[2];
+		float parentDerivedBR[2];
+		float invSize[2];
+		float invCanvasAspectRatio;
+		/// c_labelRecordMarker, plus 1 if derivedRot is not the identity. See isIdentity
+		uint32_t markerAndIsRotated;
+	};
+
+	/// How many GlyphVertex a LabelRecord takes in the glyph record buffer
+	const uint32_t c_labelRecordSlots = sizeof( LabelRecord ) / sizeof( GlyphVertex );
+
+	/// Max number of 9-slice widgets a single draw covers. Every draw starts at the beginning
+	/// of the 9-slice Vao, thus it only needs to hold this many widgets no matter how many
+	/// there are. Longer runs get split into more draws. See ColibriManager::m_nineSliceVao
+	const uint32_t c_maxNineSliceWidgetsPerDraw = 256u;
+
+	namespace NineSliceFlags
+	{
+		enum NineSliceFlags
+		{
+			/// derivedRot is not the identity. See isIdentity
+			Rotated = 1u << 0u,
+			/// See Renderable::_setUvAnimation
+			UvAnimated = 1u << 1u,
+			UvAnimatedVertical = 1u << 2u
+		};
+	}
+
+	/** There is one NineSliceRecord per Renderable (except Labels and LabelBmps).
+		The vertex shader fetches it from a buffer (see HlmsColibri::setNineSliceRecordBuffer)
+		and expands it into the 36 vertices (4 per cell) of the 3x3 grid using the vertex ID.
+
+		Corners are kept unrotated and the shader applies derivedRot exactly like
+		Renderable::addQuad would, so the output matches the CPU path.
+		See Tests/ColibriNineSliceRecordTest.cpp
+
+		Must be 176 bytes (11x uint4) as that's how the shader reads it.
+	*/
+	struct NineSliceRecord
+	{
+		/// X of the outer left, inner left, inner right and outer right edges
+		float gridX[4];
+		/// Y of the outer top, inner top, inner bottom and outer bottom edges
+		float gridY[4];
+		float derivedRot[2][3];
+		float canvasAspectRatio;
+		float invCanvasAspectRatio;
+		float parentDerivedTL[2];
+		float parentDerivedBR[2];
+		float invSize[2];
+		uint8_t rgbaColour[4];
+		/// See NineSliceFlags
+		uint32_t flags;
+		/// u0, v0, u1, v1 for each cell in the 3x3 grid. Normalized to [0; 65535]
+		uint16_t uvTopLeftBottomRight[GridLocations::NumGridLocations][4];
+		/// Scale & offset. Only used with NineSliceFlags::UvAnimated
+		float uvAnimation[2];
 	};
 
 	/** @ingroup Api_Backend
@@ -71,16 +187,29 @@ namespace Colibri
 		Ogre::IndirectBufferPacked	*indirectBuffer;
 		uint8_t						*indirectDraw;
 		uint8_t						*startIndirectDraw;
+		//End of the current indirectBuffer chunk. See ColibriManager::_mapNextIndirectBuffer
+		uint8_t						*endIndirectDraw;
 		//Used to see if we need to switch to a new draw when rendering text (since text rendering
 		//has arbitrary number of of vertices, thus we can't properly calculate the drawId and
 		//therefore the material ID)
 		Ogre::HlmsDatablock			*lastDatablock;
 		int							baseInstanceAndIndirectBuffers;
-		Ogre::CbDrawCallStrip		* colibri_nullable drawCmd;
-		Ogre::CbDrawStrip			* colibri_nullable drawCountPtr;
+		Ogre::CbDrawCall			* colibri_nullable drawCmd;
+		//Points to the primCount of the last CbDrawStrip or CbDrawIndexed we issued.
+		//Both structs start with it
+		uint32_t					* colibri_nullable drawCountPtr;
+		//sizeof( CbDrawStrip ) or sizeof( CbDrawIndexed ), depending on what we last issued
+		uint32_t lastDrawSize;
 		uint32_t primCount;
-		uint32_t basePrimCount[2]; //[0] = regular widgets, [1] = text
+		//[0] = regular widgets, [1] = text. LabelBmps use the start of their chunk's Vao
+		uint32_t basePrimCount[2];
 		uint32_t nextFirstVertex;
+		//Record (and record buffer chunk) the next widget must start at to be appended to
+		//the current draw. Only used by regular widgets and Labels
+		uint32_t nextRecordStart;
+		uint32_t nextRecordChunk;
+		//Regular widgets and text are drawn indexed. See ColibriManager::m_quadIndexBuffer
+		uint32_t quadIndexBufferStart;
 	};
 
 	/**
@@ -107,15 +236,36 @@ namespace Colibri
 		/// also acknowledges that!
 		uint32_t			m_numVertices;
 		uint32_t			m_currVertexBufferOffset;
+		/// Chunk m_currVertexBufferOffset is relative to: in ColibriManager's record buffers
+		/// for regular widgets & Labels, in its LabelBmp Vaos for LabelBmps
+		uint32_t			m_currChunk;
 
 		bool				m_visualsEnabled;
 
+		/// See _setUvAnimation. m_uvAnimation[0] = scale, [1] = offset
+		uint32_t			m_uvAnimationFlags;
+		float				m_uvAnimation[2];
+
+		/// Writes a new CbDrawIndexed (if bIndexed) or CbDrawStrip into the indirect buffer,
+		/// which starts at firstVertex and has no primitives yet.
+		static void addIndirectDraw( ApiEncapsulatedObjects &apiObject, bool bIndexed,
+									 uint32_t firstVertex, uint32_t baseInstance );
+
 	public:
+		/// Takes back the last indirect draw if it has no primitives
+		static void _removeEmptyDraw( ApiEncapsulatedObjects &apiObject );
+
 		/// @copydoc Widget::addChildrenCommands
 		void _addCommands( ApiEncapsulatedObjects &apiObject, bool collectingBreadthFirst );
 
 	protected:
-		inline void addQuad( UiVertex * RESTRICT_ALIAS vertexBuffer,
+		/** Writes the 6 vertices of a quad.
+		@param vertexBuffer
+			Actually points to UiVertexCompact if ColibriManager::useCompactVertexFormat
+		@return
+			vertexBuffer advanced past the 6 vertices written
+		*/
+		inline UiVertex* addQuad( UiVertex * RESTRICT_ALIAS vertexBuffer,
 							 Ogre::Vector2 topLeft,
 							 Ogre::Vector2 bottomRight,
 							 Ogre::Vector4 uvTopLeftBottomRight,
@@ -152,6 +302,17 @@ namespace Colibri
 		void setVisualsEnabled( bool bEnabled );
 		bool isVisualsEnabled() const final;
 
+		/** Animates the UVs in the vertex shader. Used by Progressbar, so that all
+			progress bars can share the same datablock instead of each animating its own.
+
+			The UVs become u' = u * scale - offset; v' = v
+			If vertical, they're rotated 90 degrees first: u' = -v * scale - offset; v' = u
+			The datablock should use TAM_WRAP.
+		@param bEnabled
+			False to disable the animation (Default).
+		*/
+		void _setUvAnimation( bool bEnabled, bool bVertical, float scale, float offset );
+
 		/** Sets a custom colour
 		@param overrideSkinColour
 			When false, we ignore 'colour' argument and reset back to using the skin's default
@@ -216,8 +377,8 @@ namespace Colibri
 		void setClipBordersMatchSkin();
 		void setClipBordersMatchSkin( States::States state );
 
-		void broadcastNewVao( Ogre::VertexArrayObject *vao,
-									  Ogre::VertexArrayObject *textVao ) final;
+		void broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao,
+							  Ogre::VertexArrayObject *nineSliceVao ) final;
 
 		bool isRenderable() const final	{ return true; }
 
@@ -227,6 +388,8 @@ namespace Colibri
 											 RESTRICT_ALIAS vertexBuffer,
 											 GlyphVertex * colibri_nonnull * colibri_nonnull
 											 RESTRICT_ALIAS textVertBuffer,
+											 NineSliceRecord * colibri_nonnull * colibri_nonnull
+											 RESTRICT_ALIAS nineSliceBuffer,
 											 const Ogre::Vector2 &parentPos,
 											 const Ogre::Vector2 &parentCurrentScrollPos,
 											 const Matrix2x3 &parentRot,
@@ -237,6 +400,8 @@ namespace Colibri
 										  RESTRICT_ALIAS vertexBuffer,                     //
 									  GlyphVertex *colibri_nonnull *colibri_nonnull  //
 										  RESTRICT_ALIAS   textVertBuffer,                 //
+									  NineSliceRecord *colibri_nonnull *colibri_nonnull  //
+										  RESTRICT_ALIAS   nineSliceBuffer,                //
 									  const Ogre::Vector2 &parentPos,                      //
 									  const Ogre::Vector2 &parentCurrentScrollPos,         //
 									  const Matrix2x3     &parentRot ) override;
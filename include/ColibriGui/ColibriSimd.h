@@ -0,0 +1,176 @@
+
+#pragma once
+
+#include "ColibriGui/ColibriWidget.h"
+
+// Define COLIBRIGUI_NO_SIMD to force the scalar path
+#if !defined( COLIBRIGUI_NO_SIMD )
+#	if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#		define COLIBRI_SIMD_SSE2 1
+#		include <emmintrin.h>
+#	elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#		define COLIBRI_SIMD_NEON 1
+#		include <arm_neon.h>
+#	endif
+#endif
+
+COLIBRI_ASSUME_NONNULL_BEGIN
+
+namespace Colibri
+{
+	/// Returns true if mat is exactly Matrix2x3::IDENTITY
+	inline bool isIdentity( const Matrix2x3 &mat )
+	{
+		return mat.m[0][0] == 1.0f && mat.m[0][1] == 0.0f && mat.m[0][2] == 0.0f &&
+			   mat.m[1][0] == 0.0f && mat.m[1][1] == 1.0f && mat.m[1][2] == 0.0f;
+	}
+
+	/// Scalar version of transformQuadCorners. Used when there's no SIMD, and always
+	/// available so that Tests/ColibriSimdTest.cpp can compare both versions
+	inline void transformQuadCornersScalar( Ogre::Vector2 topLeft, Ogre::Vector2 bottomRight,
+											Ogre::Vector2 parentDerivedTL,
+											Ogre::Vector2 parentDerivedBR, Ogre::Vector2 invSize,
+											float canvasAspectRatio, float invCanvasAspectRatio,
+											const Matrix2x3 &derivedRot, bool bRotated,
+											float outX[4], float outY[4],
+											float outClipDistance[4 * Borders::NumBorders] )
+	{
+		const float xs[4] = { topLeft.x, topLeft.x, bottomRight.x, bottomRight.x };
+		const float ys[4] = { topLeft.y, bottomRight.y, bottomRight.y, topLeft.y };
+
+		for( size_t i = 0u; i < 4u; ++i )
+		{
+			float posX = xs[i];
+			float posY = ys[i];
+			if( bRotated )
+			{
+				// Same as Widget::mul( derivedRot, x, y * invCanvasAspectRatio )
+				const float scaledY = ys[i] * invCanvasAspectRatio;
+				posX = derivedRot.m[0][0] * xs[i] + derivedRot.m[0][1] * scaledY + derivedRot.m[0][2];
+				posY = derivedRot.m[1][0] * xs[i] + derivedRot.m[1][1] * scaledY + derivedRot.m[1][2];
+				posY *= canvasAspectRatio;
+			}
+			outX[i] = posX;
+			outY[i] = -posY;
+
+			float *clipDistance = outClipDistance + i * Borders::NumBorders;
+			clipDistance[Borders::Top] = ( ys[i] - parentDerivedTL.y ) * invSize.y;
+			clipDistance[Borders::Left] = ( xs[i] - parentDerivedTL.x ) * invSize.x;
+			clipDistance[Borders::Right] = ( parentDerivedBR.x - xs[i] ) * invSize.x;
+			clipDistance[Borders::Bottom] = ( parentDerivedBR.y - ys[i] ) * invSize.y;
+		}
+	}
+
+	/** Transforms the four corners of a quad and calculates their clip distances.
+		This is the math shared by every addQuad; vertices only need to be written afterwards.
+
+		Corners are output in the order: top left, bottom left, bottom right, top right.
+
+		The SSE2, NEON and scalar versions produce bit-identical results (we only use
+		the same mul & add ops in the same order; no FMA, no reciprocals). This requires
+		the compiler not to contract a * b + c into an FMA on its own (GCC does by default
+		on aarch64), thus ColibriGui is built with -ffp-contract=off. See CMakeLists.txt
+		and Tests/ColibriSimdTest.cpp
+	@param bRotated
+		When false, derivedRot is assumed to be the identity and the transform is skipped.
+		See isIdentity
+	@param outX [out]
+		Transformed X position of each corner
+	@param outY [out]
+		Transformed Y position of each corner. Already negated (see
+		TODO_this_is_a_workaround_neg_y)
+	@param outClipDistance [out]
+		4 clip distances per corner, indexed by Borders::Borders
+	*/
+	inline void transformQuadCorners( Ogre::Vector2 topLeft, Ogre::Vector2 bottomRight,
+									  Ogre::Vector2 parentDerivedTL, Ogre::Vector2 parentDerivedBR,
+									  Ogre::Vector2 invSize, float canvasAspectRatio,
+									  float invCanvasAspectRatio, const Matrix2x3 &derivedRot,
+									  bool bRotated, float outX[4], float outY[4],
+									  float outClipDistance[4 * Borders::NumBorders] )
+	{
+#if defined( COLIBRI_SIMD_SSE2 )
+		const __m128 xs = _mm_setr_ps( topLeft.x, topLeft.x, bottomRight.x, bottomRight.x );
+		const __m128 ys = _mm_setr_ps( topLeft.y, bottomRight.y, bottomRight.y, topLeft.y );
+
+		__m128 posX = xs;
+		__m128 posY = ys;
+		if( bRotated )
+		{
+			const __m128 scaledY = _mm_mul_ps( ys, _mm_set1_ps( invCanvasAspectRatio ) );
+			posX = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( derivedRot.m[0][0] ), xs ),
+										   _mm_mul_ps( _mm_set1_ps( derivedRot.m[0][1] ), scaledY ) ),
+							   _mm_set1_ps( derivedRot.m[0][2] ) );
+			posY = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( derivedRot.m[1][0] ), xs ),
+										   _mm_mul_ps( _mm_set1_ps( derivedRot.m[1][1] ), scaledY ) ),
+							   _mm_set1_ps( derivedRot.m[1][2] ) );
+			posY = _mm_mul_ps( posY, _mm_set1_ps( canvasAspectRatio ) );
+		}
+		// Flip the sign bit rather than doing 0 - y, to match the scalar path exactly
+		posY = _mm_xor_ps( posY, _mm_set1_ps( -0.0f ) );
+
+		_mm_storeu_ps( outX, posX );
+		_mm_storeu_ps( outY, posY );
+
+		// One register per border, one lane per corner. Then transpose so that we
+		// end up with the 4 clip distances of each corner, contiguous
+		__m128 clipTop = _mm_mul_ps( _mm_sub_ps( ys, _mm_set1_ps( parentDerivedTL.y ) ),
+									 _mm_set1_ps( invSize.y ) );
+		__m128 clipLeft = _mm_mul_ps( _mm_sub_ps( xs, _mm_set1_ps( parentDerivedTL.x ) ),
+									  _mm_set1_ps( invSize.x ) );
+		__m128 clipRight = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( parentDerivedBR.x ), xs ),
+									   _mm_set1_ps( invSize.x ) );
+		__m128 clipBottom = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( parentDerivedBR.y ), ys ),
+										_mm_set1_ps( invSize.y ) );
+		_MM_TRANSPOSE4_PS( clipTop, clipLeft, clipRight, clipBottom );
+
+		_mm_storeu_ps( outClipDistance + 0u, clipTop );
+		_mm_storeu_ps( outClipDistance + 4u, clipLeft );
+		_mm_storeu_ps( outClipDistance + 8u, clipRight );
+		_mm_storeu_ps( outClipDistance + 12u, clipBottom );
+#elif defined( COLIBRI_SIMD_NEON )
+		const float xsArray[4] = { topLeft.x, topLeft.x, bottomRight.x, bottomRight.x };
+		const float ysArray[4] = { topLeft.y, bottomRight.y, bottomRight.y, topLeft.y };
+		const float32x4_t xs = vld1q_f32( xsArray );
+		const float32x4_t ys = vld1q_f32( ysArray );
+
+		float32x4_t posX = xs;
+		float32x4_t posY = ys;
+		if( bRotated )
+		{
+			// Don't use vmlaq_f32: it may get fused, which would break bit-exactness
+			const float32x4_t scaledY = vmulq_n_f32( ys, invCanvasAspectRatio );
+			posX = vaddq_f32( vaddq_f32( vmulq_n_f32( xs, derivedRot.m[0][0] ),
+										 vmulq_n_f32( scaledY, derivedRot.m[0][1] ) ),
+							  vdupq_n_f32( derivedRot.m[0][2] ) );
+			posY = vaddq_f32( vaddq_f32( vmulq_n_f32( xs, derivedRot.m[1][0] ),
+										 vmulq_n_f32( scaledY, derivedRot.m[1][1] ) ),
+							  vdupq_n_f32( derivedRot.m[1][2] ) );
+			posY = vmulq_n_f32( posY, canvasAspectRatio );
+		}
+		posY = vnegq_f32( posY );
+
+		vst1q_f32( outX, posX );
+		vst1q_f32( outY, posY );
+
+		// One register per border, one lane per corner. vst4q interleaves them,
+		// which leaves the 4 clip distances of each corner contiguous
+		float32x4x4_t clipDistances;
+		clipDistances.val[Borders::Top] =
+			vmulq_n_f32( vsubq_f32( ys, vdupq_n_f32( parentDerivedTL.y ) ), invSize.y );
+		clipDistances.val[Borders::Left] =
+			vmulq_n_f32( vsubq_f32( xs, vdupq_n_f32( parentDerivedTL.x ) ), invSize.x );
+		clipDistances.val[Borders::Right] =
+			vmulq_n_f32( vsubq_f32( vdupq_n_f32( parentDerivedBR.x ), xs ), invSize.x );
+		clipDistances.val[Borders::Bottom] =
+			vmulq_n_f32( vsubq_f32( vdupq_n_f32( parentDerivedBR.y ), ys ), invSize.y );
+		vst4q_f32( outClipDistance, clipDistances );
+#else
+		transformQuadCornersScalar( topLeft, bottomRight, parentDerivedTL, parentDerivedBR, invSize,
+									canvasAspectRatio, invCanvasAspectRatio, derivedRot, bRotated,
+									outX, outY, outClipDistance );
+#endif
+	}
+}  // namespace Colibri
+
+COLIBRI_ASSUME_NONNULL_END
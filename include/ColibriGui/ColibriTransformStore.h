@@ -0,0 +1,120 @@
+
+#pragma once
+
+#include "ColibriGui/ColibriWidget.h"
+
+COLIBRI_ASSUME_NONNULL_BEGIN
+
+namespace Colibri
+{
+	/**
+	@class TransformStore
+		Structure of Arrays copy of the local & derived transforms of every widget.
+
+		Widgets are sorted by depth in the tree (all root windows, then all of their children,
+		then all of their grandchildren, etc). A level only depends on the level above it,
+		thus each level is updated 4 widgets at a time with SSE2 / NEON (see ColibriSimd.h)
+		instead of recursing through Widget::m_children one widget at a time.
+
+		It also tracks the region each widget is clipped to. Widgets fully outside of it are
+		flagged (see Widget::m_outsideClipRegion): they're neither rendered nor hit tested,
+		and their children aren't even updated (except child windows, which aren't clipped
+		to their parent window). Thus a scrolling window with long content
+		only pays for what's visible. The derived transforms of the skipped children are
+		left out of date (see Widget::updateDerivedTransformFromParent).
+
+		The math is the same as Widget::updateDerivedTransform, and the results are written
+		back to Widget::m_derivedTopLeft, m_derivedBottomRight & m_derivedOrientation.
+
+		Owned by ColibriManager. See ColibriManager::updateAllDerivedTransforms
+	*/
+	class TransformStore
+	{
+	public:
+		enum Attribute
+		{
+			// Local transform. Gathered from the widgets on every update
+			PosX,
+			PosY,
+			SizeX,
+			SizeY,
+			Orientation0,
+			Orientation1,
+			Orientation2,
+			Orientation3,
+			/// ( m_clipBorderTL - getCurrentScroll() ) * invCanvasSize2x
+			ChildOffsetX,
+			ChildOffsetY,
+
+			// Derived transform
+			DerivedTopLeftX,
+			DerivedTopLeftY,
+			DerivedBottomRightX,
+			DerivedBottomRightY,
+			DerivedRot00,
+			DerivedRot01,
+			DerivedRot02,
+			DerivedRot10,
+			DerivedRot11,
+			DerivedRot12,
+			/// Derived top left + ChildOffset. i.e. the parentPos of our children
+			ChildOriginX,
+			ChildOriginY,
+
+			// Clipping. Computed one widget at a time after the derived transform
+			/// Region our children are clipped to. See Widget::m_accumMinClipTL
+			InnerClipMinX,
+			InnerClipMinY,
+			InnerClipMaxX,
+			InnerClipMaxY,
+
+			NumAttributes
+		};
+
+	protected:
+		/// All widgets sorted by depth. [0] is null and acts as the parent of the
+		/// root windows, so that they don't need special casing
+		WidgetVec m_widgets;
+		/// Index to m_widgets of the parent of each widget
+		std::vector<uint32_t> m_parentIdx;
+		/// m_levelStart[i] is the index to m_widgets of the first widget at depth i.
+		/// The level ends where the next one starts
+		std::vector<uint32_t> m_levelStart;
+
+		/// NumAttributes arrays of m_widgets.size() floats each, one after the other
+		std::vector<float> m_data;
+		/// Non-zero when the children of m_widgets[i] can't be seen (i.e. m_widgets[i] or one
+		/// of its parents is outside its clip region), thus they're not updated.
+		/// Always zero for windows, regardless of their parent
+		std::vector<uint8_t> m_skipChildren;
+
+		bool m_layoutDirty;
+
+		/// Sorts all widgets reachable from windows by depth, and resizes m_data accordingly
+		void rebuildLayout( const WindowVec &windows );
+
+		/// Updates widgets [i; end) as long as there are at least Ops::c_width left.
+		/// Returns the first widget that wasn't updated
+		template <typename Ops>
+		uint32_t updateWidgets( uint32_t i, uint32_t end, Ogre::Vector2 invCanvasSize2x,
+								float invCanvasAr );
+
+	public:
+		TransformStore();
+
+		/// Must be called whenever widgets are attached, detached or destroyed
+		void setLayoutDirty() { m_layoutDirty = true; }
+
+		/** Updates the derived transforms of all widgets reachable from windows
+		@param windows
+			Root windows. See ColibriManager::m_windows
+		@param invCanvasSize2x
+			See ColibriManager::getInvCanvasSize2x
+		@param invCanvasAr
+			See ColibriManager::getCanvasInvAspectRatio
+		*/
+		void update( const WindowVec &windows, Ogre::Vector2 invCanvasSize2x, float invCanvasAr );
+	};
+}  // namespace Colibri
+
+COLIBRI_ASSUME_NONNULL_END
@@ -14,6 +14,7 @@ namespace Colibri
 {
 	struct UiVertex;
 	struct GlyphVertex;
+	struct NineSliceRecord;
 	struct ApiEncapsulatedObjects;
 	typedef std::vector<Widget*> WidgetVec;
 	typedef std::vector<Window*> WindowVec;
@@ -66,6 +67,7 @@ namespace Colibri
 		friend class Renderable;
 		friend class Label;
 		friend class LabelBmp;
+		friend class TransformStore;
 
 		struct WidgetActionListenerRecord
 		{
@@ -121,6 +123,12 @@ namespace Colibri
 		bool					m_consumesScroll;
 
 		bool m_culled;
+		/// True when we're fully outside the region our parents clip us to. Neither we nor our
+		/// children can be seen or clicked, and our children's derived transforms aren't
+		/// updated while this is true. Child windows are the exception: they aren't clipped
+		/// to their parent window, thus they're still updated, rendered & hit tested.
+		/// Set by TransformStore
+		bool m_outsideClipRegion;
 	public:
 		/// When true, this widgets and its children will be rendered in breadth first
 		/// order, instead of depth first.
@@ -189,8 +197,34 @@ namespace Colibri
 		bool		m_zOrderDirty;
 		/// When true this widget has a child at some point in its tree which is dirty.
 		bool		m_zOrderHasDirtyChildren;
+		/// When true setZOrder was called on this widget since the last time our parent
+		/// (or ColibriManager if we're a root window) reordered its list.
+		/// See _reorderByZOrder
+		bool		m_zOrderChanged;
 		uint16_t	m_zOrder;
 
+		/// Dirty reasons (always including TransformDirtyParentCaller) our children haven't been
+		/// notified of yet. Non-zero iff we're in ColibriManager::m_transformDirtyQueue
+		uint32_t	m_pendingTransformDirty;
+
+		/// Where we are in ColibriManager's unordered lists, so that we can be removed with a
+		/// swap & pop instead of a linear search. c_notInRegistry when we're not in them
+		uint32_t	m_dirtyWidgetsIdx;			///< ColibriManager::m_dirtyWidgets
+		uint32_t	m_transformDirtyQueueIdx;	///< Only valid if m_pendingTransformDirty != 0
+		uint32_t	m_updateWidgetsIdx;			///< ColibriManager::m_updateWidgets
+		uint32_t	m_labelsIdx;				///< ColibriManager::m_labels or m_labelsBmp
+		uint32_t	m_dirtyLabelsIdx;			///< ColibriManager::m_dirtyLabels or m_dirtyLabelBmps
+
+		/// Set by ColibriManager::destroyWidgetTree on the whole tree before destroying it
+		bool		m_treeBeingDestroyed;
+
+		/// Pool our memory was carved from. Null if we weren't created by ColibriManager
+		WidgetPool *colibri_nullable m_widgetPool;
+
+		/// Accelerates _setIdleCursorMoved when we have lots of children.
+		/// Created on demand. See HitTestGrid::c_minChildrenForGrid
+		HitTestGrid *colibri_nullable m_hitTestGrid;
+
 #if COLIBRIGUI_DEBUG >= COLIBRIGUI_DEBUG_MEDIUM
 		bool	m_transformOutOfDate;
 		bool	m_destructionStarted;
@@ -207,6 +241,19 @@ namespace Colibri
 
 		void updateDerivedTransform( const Ogre::Vector2 &parentPos, const Matrix2x3 &parentRot );
 
+		/// Must be called when our children are moved, resized, added, removed or reordered
+		void setHitTestGridDirty();
+
+		/** Hit tests one of our (non-window) children, and its children. See _setIdleCursorMoved
+		@param outFocusPair [out]
+			Only written to if the return value is true
+		@return
+			True if the cursor is on child or on any of its children
+		*/
+		bool setIdleCursorMovedOnChild( Widget *child, const Ogre::Vector2 &newPosNdc,
+										const Ogre::Vector2 &currentScroll,
+										FocusPair &outFocusPair );
+
 		/** Notifies a parent that the input is about to be removed. It's similar to
 			notifyWidgetDestroyed, except this is explicitly about child-parent
 			relationships, as these relationships aren't tracked by listeners.
@@ -229,7 +276,9 @@ namespace Colibri
 			TransformDirtyAll			= 0xFFFFFFFF
 		};
 
-		/**
+		/** Notifies this widget that its transform changed.
+			Our children are notified later (with TransformDirtyParentCaller set), once per frame
+			no matter how many times this is called. See ColibriManager::propagateTransformDirty
 		@param dirtyReason
 			@see	TransformDirtyReason
 		*/
@@ -249,6 +298,9 @@ namespace Colibri
 		virtual void reorderWidgetVec( bool widgetInListDirty, WidgetVec& widgets );
 
 	public:
+		/// See m_dirtyWidgetsIdx & co.
+		static const uint32_t c_notInRegistry = 0xFFFFFFFFu;
+
 		Widget( ColibriManager *manager );
 		~Widget() override;
 
@@ -473,13 +525,12 @@ namespace Colibri
 
 		FocusPair _setIdleCursorMoved( const Ogre::Vector2 &newPosNdc );
 
-		virtual void broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao );
-
-		virtual void _updateDerivedTransformOnly( const Ogre::Vector2 &parentPos,
-												  const Matrix2x3 &parentRot );
+		virtual void broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao,
+									  Ogre::VertexArrayObject *nineSliceVao );
 
 		/** Fills vertexBuffer & textVertBuffer for rendering, perfoming occlussion culling.
-			It also updates derived transforms. Derived classes change their functionality.
+			Derived transforms must already be up to date. See ColibriManager::prepareRenderCommands
+			Derived classes change their functionality.
 			This function is mostly relevant in Renderable and its derived classes
 		@param vertexBuffer
 			Filled by most Renderable classes.
@@ -494,11 +545,16 @@ namespace Colibri
 			This is required needed so we can perform certain computations.
 		@param parentRot
 			Derived orientation of m_parent
+		@remarks
+			parentPos & parentRot are what our derived transform was calculated from.
+			See TransformStore
 		*/
 		virtual void _fillBuffersAndCommands( UiVertex * colibri_nonnull * colibri_nonnull
 											  RESTRICT_ALIAS vertexBuffer,
 											  GlyphVertex * colibri_nonnull * colibri_nonnull
 											  RESTRICT_ALIAS textVertBuffer,
+											  NineSliceRecord * colibri_nonnull * colibri_nonnull
+											  RESTRICT_ALIAS nineSliceBuffer,
 											  const Ogre::Vector2 &parentPos,
 											  const Ogre::Vector2 &parentCurrentScrollPos,
 											  const Matrix2x3 &parentRot );
@@ -530,6 +586,19 @@ namespace Colibri
 			return w1->_getZOrderInternal() < w2->_getZOrderInternal();
 		}
 
+		/** Sorts widgets by z order. The result is the same as std::stable_sort.
+			However the widgets that haven't changed their z order (see m_zOrderChanged)
+			are assumed to be already sorted, thus only the ones that changed are
+			reinserted (with a binary search) instead of sorting the whole list.
+			All the changed widgets are reinserted in a single pass, so it's cheap even
+			if many of them changed in the same frame.
+		@remarks
+			Falls back to std::stable_sort if the unchanged widgets aren't sorted (e.g. a
+			widget was just attached at the end of the list)
+		*/
+		template <typename T>
+		static void _reorderByZOrder( std::vector<T *> &widgets );
+
 	public:
 
 		/// Returns true if this widget or any parent has m_breadthFirst set to true
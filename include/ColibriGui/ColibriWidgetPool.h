@@ -0,0 +1,66 @@
+
+#pragma once
+
+#include "ColibriGui/ColibriGuiPrerequisites.h"
+
+#include <new>
+#include <vector>
+
+COLIBRI_ASSUME_NONNULL_BEGIN
+
+namespace Colibri
+{
+	/**
+	@class WidgetPool
+		Slab allocator for widgets of the same size.
+
+		Building a screen creates lots of widgets of a handful of types. Instead of heap
+		allocating each of them, ColibriManager keeps one pool per widget size and carves
+		widgets out of big slabs. Freed slots are reused by the next widget of that size.
+
+		Slabs are never released until the pool is destroyed.
+
+		See ColibriManager::_createWidget & ColibriManager::createWidgets
+	*/
+	class WidgetPool
+	{
+	public:
+		/// Alignment of every slot. Widgets can't require more than this
+		static const size_t c_alignment = 16u;
+		/// Minimum number of slots allocated at once (unless reserve asks for fewer)
+		static const size_t c_minObjectsPerSlab = 32u;
+
+	protected:
+		/// Size of each slot, multiple of c_alignment
+		size_t m_objectSize;
+
+		std::vector<void *> m_slabs;
+
+		/// Intrusive singly linked list. The first bytes of every free slot point to the next
+		void *colibri_nullable m_freeList;
+		size_t                 m_numFree;
+		size_t                 m_numAllocated;
+
+		void addSlab( size_t numObjects );
+
+	public:
+		WidgetPool( size_t objectSize );
+		~WidgetPool();
+
+		/// Ensures the next numObjects calls to allocate don't need to allocate a new slab
+		void reserve( size_t numObjects );
+
+		/// Returns uninitialized memory of getObjectSize() bytes
+		void *allocate();
+		/// ptr must have been returned by allocate(), and the object in it already destroyed
+		void deallocate( void *ptr );
+
+		size_t getObjectSize() const { return m_objectSize; }
+		size_t getNumAllocated() const { return m_numAllocated; }
+
+		/// Rounds sizeof( T ) to the slot size of the pool T would be allocated from
+		static size_t calculateObjectSize( size_t sizeBytes );
+	};
+}  // namespace Colibri
+
+COLIBRI_ASSUME_NONNULL_END
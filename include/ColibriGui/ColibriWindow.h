@@ -187,15 +187,13 @@ namespace Colibri
 		void setConsumeCursor( bool bConsumeCursor ) { m_clickable = bConsumeCursor; }
 		bool getConsumeCursor() const { return m_clickable; }
 
-		void _updateDerivedTransformOnly( const Ogre::Vector2 &parentPos,
-										  const Matrix2x3     &parentRot ) override;
-
 		void _fillBuffersAndCommands(
-			UiVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS    vertexBuffer,            //
-			GlyphVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS textVertBuffer,          //
-			const Ogre::Vector2                                         &parentPos,               //
-			const Ogre::Vector2                                         &parentCurrentScrollPos,  //
-			const Matrix2x3                                             &parentRot ) final;
+			UiVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS        vertexBuffer,            //
+			GlyphVertex *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS     textVertBuffer,          //
+			NineSliceRecord *colibri_nonnull *colibri_nonnull RESTRICT_ALIAS nineSliceBuffer,         //
+			const Ogre::Vector2                                             &parentPos,               //
+			const Ogre::Vector2                                             &parentCurrentScrollPos,  //
+			const Matrix2x3                                                 &parentRot ) final;
 	};
 }
 
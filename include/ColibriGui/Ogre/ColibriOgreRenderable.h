@@ -9,6 +9,9 @@ COLIBRI_ASSUME_NONNULL_BEGIN
 
 namespace Ogre
 {
+	class HlmsColibri;
+	struct QueuedRenderable;
+
 	/** @ingroup Api_Backend
 	@class ColibriOgreRenderables
 		ColibriOgreRenderables receive the shared Vao from their parents
@@ -21,25 +24,63 @@ namespace Ogre
 	*/
 	class ColibriOgreRenderable : public MovableObject, public Renderable
 	{
+	protected:
+		static VertexArrayObject* createPulledVao( uint32 vertexCount, bool hasUvs,
+												   IndexBufferPacked *quadIndexBuffer,
+												   VaoManager *vaoManager );
+
 	public:
-		static VertexArrayObject* createVao( uint32 vertexCount, VaoManager *vaoManager );
-		static VertexArrayObject* createTextVao( uint32 vertexCount, VaoManager *vaoManager );
+		/// Vertex format of Colibri::UiVertex, or Colibri::UiVertexCompact if compact is true
+		static VertexArrayObject* createVao( uint32 vertexCount, bool compact,
+											 VaoManager *vaoManager );
+		static VertexArrayObject* createTextVao( uint32 vertexCount, IndexBufferPacked *quadIndexBuffer,
+												 VaoManager *vaoManager );
+		static VertexArrayObject* createNineSliceVao( uint32 vertexCount,
+													  IndexBufferPacked *quadIndexBuffer,
+													  VaoManager *vaoManager );
+		/// Does not destroy the Vao's index buffer, it's shared. See createQuadIndexBuffer
 		static void destroyVao( VertexArrayObject *vao, VaoManager *vaoManager );
+
+		/** Creates a prefilled index buffer to be shared by the Vaos of 9-slice widgets
+			and text. Every quad has its own 4 vertices, and is drawn with 6 indices.
+		@param numQuads
+			Max number of quads a single draw can render.
+		@param vaoManager
+		@return
+			Buffer with numQuads * 6 indices. Caller must destroy it.
+		*/
+		static IndexBufferPacked* createQuadIndexBuffer( uint32 numQuads, VaoManager *vaoManager );
+
+		/// Creates a buffer for the vertex shader to fetch records from (e.g. one
+		/// Colibri::GlyphVertex per glyph). It's a ReadOnlyBufferPacked if
+		/// useReadOnlyBuffer is true, TexBufferPacked otherwise.
+		/// @see	HlmsColibri::needsReadOnlyBuffer
+		static BufferPacked* createRecordBuffer( size_t sizeBytes, bool useReadOnlyBuffer,
+												 VaoManager *vaoManager );
+		static void destroyRecordBuffer( BufferPacked *buffer, VaoManager *vaoManager );
 	protected:
+		/// Result of the last getMaterial call. Only valid while the keys below match
+		HlmsCache const *mCachedHlmsCache;
+		uint32 mCachedPassHash;
+		uint32 mCachedHlmsHash;
+		uint32 mCachedShaderCacheGeneration;
+
 		void setVao( VertexArrayObject *vao );
 
+		/** Same as Hlms::getMaterial, but skips the lookup when our hash (i.e. datablock),
+			the pass hash and HlmsColibri's shader cache haven't changed since the last call.
+			This is almost always the case from one frame to the next.
+		*/
+		const HlmsCache* getCachedMaterial( HlmsColibri *hlms, const HlmsCache *lastReturnedValue,
+											const HlmsCache &passCache,
+											const QueuedRenderable &queuedRenderable );
+
 	public:
 		ColibriOgreRenderable( IdType id, ObjectMemoryManager *objectMemoryManager,
 							   SceneManager* manager, uint8 renderQueueId,
 							   Colibri::ColibriManager *colibriManager );
 		virtual ~ColibriOgreRenderable();
 
-		/** Creates a prefilled index buffer to be used & reused for rendering.
-		@param vaoManager
-		@return
-		*/
-		//static Ogre::IndexBufferPacked* createIndexBuffer( VaoManager *vaoManager );
-
 		//Overrides from MovableObject
 		virtual const String& getMovableType(void) const;
 
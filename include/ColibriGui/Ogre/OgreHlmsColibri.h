@@ -45,16 +45,29 @@ namespace Ogre
 		that is different from UI widgets and from regular entities. To identify them, we overloaded
 		calculateHashForPreCreate (which gets called when a Renderable is assigned a new
 		datablock/material) and use the magic numbers "6372" to identify the Renderable as an
-		UI widget, and "6373" for text widgets. We only look for the presence of the key, and we
-		don't care about the value.
+		UI widget, "6373" for text widgets and "6374" for LabelBmp. We only look for the presence
+		of the key, and we don't care about the value.
 
 		This works because basically all UI widgets follow a different path from regular Unlit,
 		and all text widgets follow a different path from the other two (so there's a total of 3 paths).
+		UI widgets without 6373 nor 6374 are 9-slices expanded in the vertex shader from a
+		NineSliceRecord; LabelBmp still writes real vertices.
 
 		UI widgets are only meant to be rendered from a custom compositor pass we provide, which
 		is why we use fillBuffersForColibri that handles our special needs, instead of
 		overloading the regular fillBuffersForV2.
 
+		Slot layout (texture / buffer slots, shared by every path):
+			- 0 & 1: Same as HlmsUnlit (e.g. the texture matrices' TexBuffer at 1)
+			- 2: glyph atlas (pixel shader, text only). See setGlyphAtlasBuffer
+			- 3: glyph records (vertex shader, text only). See setGlyphRecordBuffer
+			- 4: 9-slice records (vertex shader, 9-slices only). See setNineSliceRecordBuffer
+			- 5 onwards: the datablock's textures & samplers (mTexUnitSlotStart)
+
+		worldMaterialIdx[drawId].y holds the first record of the draw (see fillBuffersForColibri)
+		instead of Unlit's shadow constant bias. That's only fine because UI is never rendered
+		in caster passes.
+
 		@see	CompositorPassColibriGuiProvider
 	*/
 	class HlmsColibri : public HlmsUnlit
@@ -63,6 +76,19 @@ namespace Ogre
 		// It's ReadOnlyBufferPacked on Mali
 		// It's TexBufferPacked everywhere else
 		BufferPacked *mGlyphAtlasBuffer;
+		// One LabelRecord per Label followed by its GlyphVertex, read by the vertex shader.
+		// Same buffer type as mGlyphAtlasBuffer
+		BufferPacked *mGlyphRecordBuffer;
+		// One NineSliceRecord per 9-slice widget, read by the vertex shader.
+		// Same buffer type as mGlyphAtlasBuffer
+		BufferPacked *mNineSliceRecordBuffer;
+		// What's currently bound to slots 3 & 4. The record buffers are split in chunks,
+		// thus they may change between draws
+		BufferPacked *mBoundGlyphRecordBuffer;
+		BufferPacked *mBoundNineSliceRecordBuffer;
+		// Incremented every time our shader cache is cleared, which
+		// invalidates the HlmsCache pointers our Renderables hold on to
+		uint32 mShaderCacheGeneration;
 
 #if OGRE_VERSION >= OGRE_MAKE_VERSION( 2, 3, 0 )
 		virtual void setupRootLayout( RootLayout &rootLayout );
@@ -75,6 +101,10 @@ namespace Ogre
 
 		virtual void calculateHashForPreCreate( Renderable *renderable, PiecesMap *inOutPieces );
 
+		/// Binds a record buffer (TexBufferPacked or ReadOnlyBufferPacked) to the vertex shader
+		static void bindRecordBuffer( CommandBuffer *commandBuffer, uint16 slot,
+									  BufferPacked *buffer );
+
 		virtual HlmsDatablock* createDatablockImpl( IdString datablockName,
 													const HlmsMacroblock *macroblock,
 													const HlmsBlendblock *blendblock,
@@ -87,15 +117,31 @@ namespace Ogre
 		virtual ~HlmsColibri();
 
 		void setGlyphAtlasBuffer( BufferPacked *texBuffer );
+		/// Can be changed between draws; fillBuffersForColibri rebinds it when it does
+		void setGlyphRecordBuffer( BufferPacked *texBuffer );
+		/// See setGlyphRecordBuffer
+		void setNineSliceRecordBuffer( BufferPacked *texBuffer );
+
+		virtual void clearShaderCache();
+		uint32 getShaderCacheGeneration() const { return mShaderCacheGeneration; }
 
 		/// Returns true if the GPU supports TexBufferPacked sizes so small
 		/// that we need a ReadOnlyBuffer instead.
 		static bool needsReadOnlyBuffer( const RenderSystemCapabilities *caps,
 										 const VaoManager               *vaoManager );
 
+		/**
+		@param baseVertex
+			First vertex of the draw, including the buffer's offset
+		@param recordStart
+			Index of the Label's LabelRecord in mGlyphRecordBuffer for text (in GlyphVertex
+			units), or of the first NineSliceRecord in mNineSliceRecordBuffer
+			for 9-slice widgets.
+			Ignored otherwise.
+		*/
 		uint32 fillBuffersForColibri( const HlmsCache *cache,
 									  const QueuedRenderable &queuedRenderable,
-									  bool casterPass, uint32 baseVertex,
+									  bool casterPass, uint32 baseVertex, uint32 recordStart,
 									  uint32 lastCacheHash, CommandBuffer *commandBuffer );
 
         /// @copydoc HlmsPbs::getDefaultPaths
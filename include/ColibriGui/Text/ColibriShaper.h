@@ -13,6 +13,7 @@ COLIBRI_ASSUME_NONNULL_BEGIN
 
 typedef struct FT_FaceRec_*  FT_Face;
 typedef struct FT_LibraryRec_  *FT_Library;
+typedef struct FT_SizeRec_*  FT_Size;
 
 #ifdef __ANDROID__
 struct AAsset;
@@ -42,13 +43,41 @@ namespace Colibri
 
 	class Shaper
 	{
+	public:
+		/// Maximum number of point sizes we keep an FT_Size & hb_font_t around for.
+		/// When exceeded, the least recently used size gets destroyed.
+		static const size_t c_maxCachedFontSizes;
+
 	protected:
+		/// Each point size gets its own FT_Size and hb_font_t so that switching
+		/// between sizes is just a matter of activating a different FT_Size,
+		/// instead of calling FT_Set_Char_Size + hb_ft_font_changed every time.
+		struct SizedFont
+		{
+			FontSize	ptSize;
+			FT_Size		ftSize;
+			hb_font_t	*hbFont;
+			uint32_t	lastUsed;
+		};
+		typedef std::vector<SizedFont> SizedFontVec;
+
 		hb_script_t		m_script;
 		FT_Face			m_ftFont;
 		hb_language_t	m_hbLanguage;
-		hb_font_t		*m_hbFont;
+		/// Not a strong ref. Points to the hbFont of the currently active entry in m_sizedFonts
+		hb_font_t		*colibri_nullable m_hbFont;
 		hb_buffer_t		*m_buffer;
 
+		SizedFontVec	m_sizedFonts;
+		uint32_t		m_sizedFontsLruCounter;
+
+		/// Two-level bitset of the codepoints this font has a glyph for.
+		/// m_coveragePages[codepoint >> 8u] is 0 if the font has no glyph in that
+		/// 256-codepoint page; otherwise it's 1 + the page index into m_coverageBits
+		/// (which holds 4 uint64_t per page)
+		std::vector<uint16_t> m_coveragePages;
+		std::vector<uint64_t> m_coverageBits;
+
 		std::vector<hb_feature_t> m_features;
 
 		FT_Library		m_library;
@@ -61,6 +90,28 @@ namespace Colibri
 
 		FontSize	m_ptSize; //Font size in points
 		uint16_t	m_fontIdx;
+		/// Which shaping thread this Shaper belongs to. 0 is the main thread.
+		/// See ShaperManager::setNumShapingThreads
+		uint16_t	m_threadIdx;
+
+		std::string	m_fontLocation;
+		std::string	m_language;
+
+		void openFace( const char *fontLocation );
+
+		/// Creates a new FT_Size & hb_font_t for the given size, evicting the
+		/// least recently used one if we have c_maxCachedFontSizes entries.
+		/// Returns nullptr on failure.
+		SizedFont *colibri_nullable createSizedFont( FontSize ptSize );
+
+		/// Returns the first fallback font (i.e. not us) that covers the given
+		/// codepoint. Returns nullptr if no font covers it.
+		Shaper *colibri_nullable findCoveringFallback( uint32_t codepoint ) const;
+
+		/// Does the actual shaping. See renderString
+		size_t shapeRun( const uint16_t *utf16Str, size_t stringLength, hb_direction_t dir,
+						 uint32_t richTextIdx, uint32_t clusterOffset, ShapedGlyphVec &outShapes,
+						 bool &bOutHasPrivateUse, bool substituteIfNotFound );
 
 		size_t renderWithSubstituteFont( const uint16_t *utf16Str, size_t stringLength,
 										 hb_direction_t dir, uint32_t richTextIdx,
@@ -71,6 +122,15 @@ namespace Colibri
 		Shaper( hb_script_t script, const char *fontLocation,
 				const std::string &language,
 				ShaperManager *shaperManager );
+		/** Creates a clone of 'source' to be used exclusively by a shaping worker thread.
+			The font file is opened again so that the clone gets its own FT_Face,
+			hb_font_t and hb_buffer_t. The clone shares the font index with source,
+			thus they share the same glyphs in the ShaperManager's glyph cache.
+		@param source
+		@param threadIdx
+			Index of the worker thread. Must be > 0
+		*/
+		Shaper( const Shaper &source, uint16_t threadIdx );
 		~Shaper();
 
 		void setFeatures( const std::vector<hb_feature_t> &features );
@@ -79,10 +139,35 @@ namespace Colibri
 		void setFontSize( FontSize ptSize );
 		FontSize getFontSize() const;
 
+		/// Builds the codepoint coverage bitset by walking the font's charmap.
+		/// Called by ShaperManager::addShaper. See hasCodepoint
+		void buildCodepointCoverage();
+
+		/// Returns true if this font has a glyph for the given codepoint (UTF-32)
+		bool hasCodepoint( uint32_t codepoint ) const
+		{
+			const size_t pageIdx = codepoint >> 8u;
+			if( pageIdx >= m_coveragePages.size() || !m_coveragePages[pageIdx] )
+				return false;
+			const size_t bitIdx = ( m_coveragePages[pageIdx] - 1u ) * 256u + ( codepoint & 0xFFu );
+			return ( m_coverageBits[bitIdx >> 6u] & ( uint64_t( 1u ) << ( bitIdx & 0x3Fu ) ) ) != 0u;
+		}
+
+		/** Shapes the given string and appends the results to outShapes
+		@param substituteIfNotFound
+			When true, the string is first split into segments using the codepoint
+			coverage of each font (see hasCodepoint), so that codepoints this font doesn't
+			have are shaped exactly once with a fallback font known to cover them.
+			When false, we stop at the first codepoint this font doesn't have.
+		@return
+			Number of UTF-16 code units written
+		*/
 		size_t renderString( const uint16_t *utf16Str, size_t stringLength, hb_direction_t dir,
 							 uint32_t richTextIdx, uint32_t clusterOffset, ShapedGlyphVec &outShapes,
 							 bool &bOutHasPrivateUse, bool substituteIfNotFound );
 
+		uint16_t getFontIdx() const { return m_fontIdx; }
+
 		bool operator < ( const Shaper &other ) const;
 
 		static const hb_feature_t LigatureOff;
@@ -5,9 +5,12 @@
 
 #include "OgrePrerequisites.h"
 
-#include <vector>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 COLIBRI_ASSUME_NONNULL_BEGIN
 
@@ -62,6 +65,9 @@ namespace Colibri
 		typedef std::vector<Shaper *>  ShaperVec;
 		typedef std::vector<BmpFont *> BmpFontVec;
 
+		/// See runOnShapingThreads
+		typedef void ( *ShapingJobFunc )( size_t threadIdx, void *colibri_nullable userData );
+
 	protected:
 		struct Range
 		{
@@ -116,6 +122,51 @@ namespace Colibri
 
 		/// m_shapers[0] is the default and not a strong reference
 		ShaperVec  m_shapers;
+
+		/// Shaping state owned by each worker thread (thread 0, the main thread,
+		/// uses m_bidi & m_shapers). m_workerShapers[i] belongs to thread i + 1
+		struct WorkerShapers
+		{
+			UBiDi		*bidi;
+			/// Clones of ShaperManager::m_shapers. shapers[0] is not a strong reference
+			ShaperVec	shapers;
+		};
+		std::vector<WorkerShapers> m_workerShapers;
+
+		/// m_workerThreads[i] runs with m_workerShapers[i]. They're created once by
+		/// setNumShapingThreads and sleep until runOnShapingThreads gives them a job
+		std::vector<std::thread> m_workerThreads;
+		/// Protects every m_worker* variable below
+		std::mutex               m_workerMutex;
+		std::condition_variable  m_workerJobReady;
+		std::condition_variable  m_workerJobDone;
+		ShapingJobFunc colibri_nullable m_workerJob;
+		void *colibri_nullable   m_workerJobUserData;
+		/// Incremented on every job, so that workers can tell a new job from a spurious wakeup.
+		/// Goes back to 0 when the workers are destroyed
+		uint32_t                 m_workerJobId;
+		/// Workers that haven't finished the current job yet
+		size_t                   m_numBusyWorkers;
+		bool                     m_stopWorkers;
+
+		/// When true, multiple threads are shaping and access
+		/// to the glyph cache must be serialized
+		bool m_threadedShaping;
+		std::recursive_mutex m_glyphCacheMutex;
+
+		/// Locks m_glyphCacheMutex, but only if m_threadedShaping is true
+		class ScopedGlyphCacheLock
+		{
+			std::unique_lock<std::recursive_mutex> m_lock;
+
+		public:
+			ScopedGlyphCacheLock( ShaperManager *shaperManager ) :
+				m_lock( shaperManager->m_glyphCacheMutex, std::defer_lock )
+			{
+				if( shaperManager->m_threadedShaping )
+					m_lock.lock();
+			}
+		};
 		/// Unlike m_shapers, m_bmpFonts[0] is not repeated and is a strong ref
 		BmpFontVec m_bmpFonts;
 
@@ -135,6 +186,30 @@ namespace Colibri
 		void         destroyGlyph( CachedGlyphMap::iterator glyphIt );
 		void mergeContiguousBlocks( RangeVec::iterator blockToMerge, RangeVec &blocks );
 
+		/// Main loop of m_workerThreads
+		void workerThreadMain( size_t threadIdx );
+
+		void destroyWorkerShapers();
+
+		/** Shapes a group of contiguous RichText entries that share the same readingDir.
+			BiDi analysis runs once for the whole group. Consecutive RichTexts that share
+			the same font & size are grouped into spans. The level runs are then walked in
+			visual order and each is intersected with the spans (backwards for RTL runs),
+			so the output glyphs are in visual order. Each glyph is assigned back to its
+			RichText from its cluster.
+		@param utf8Str
+			Points to the start of richTexts[0]
+		@param richTexts [in/out]
+			Array of RichTexts. Their glyphStart & glyphEnd will be set.
+		@param numRichTexts
+		@param firstRichTextIdx
+			Index of richTexts[0] (for ShapedGlyph::richTextIdx)
+		*/
+		TextHorizAlignment::TextHorizAlignment renderParagraphs(
+			const char *utf8Str, RichText *richTexts, size_t numRichTexts, uint32_t firstRichTextIdx,
+			VertReadingDir::VertReadingDir vertReadingDir, ShapedGlyphVec &outShapes,
+			bool &bOutHasPrivateUse, size_t threadIdx );
+
 	public:
 		ShaperManager( ColibriManager *colibriManager );
 		~ShaperManager();
@@ -151,6 +226,46 @@ namespace Colibri
 		///			means it will appear twice in the array
 		const ShaperVec& getShapers() const			{ return m_shapers; }
 
+		/// Returns the Shapers to be used by the given shaping thread.
+		/// See setNumShapingThreads
+		const ShaperVec &getShapers( size_t threadIdx ) const
+		{
+			return threadIdx == 0u ? m_shapers : m_workerShapers[threadIdx - 1u].shapers;
+		}
+
+		/** Sets the number of threads that can shape text in parallel (including the
+			main thread). ColibriManager will use these threads when there are lots of
+			dirty Labels (e.g. after switching language at runtime).
+
+			Each extra thread gets its own UBiDi object and its own clone of every
+			Shaper (i.e. the font files are opened again), so there is a memory cost.
+			The extra threads are created here and kept alive (sleeping) until this
+			function is called again or ShaperManager is destroyed.
+		@remarks
+			Shapers are cloned when this function is called. Changes made afterwards to the
+			original Shapers (e.g. Shaper::setFeatures) won't be seen by the clones unless
+			this function is called again. Shapers added via addShaper afterwards are
+			cloned automatically.
+
+			When using more than 1 thread, LogListener may be called from worker threads.
+		@param numThreads
+			Value in range [1; 65535]. 1 means no multithreading (default).
+		*/
+		void setNumShapingThreads( size_t numThreads );
+		size_t getNumShapingThreads() const { return m_workerShapers.size() + 1u; }
+
+		/// For internal use. Must be set to true while multiple
+		/// threads are calling renderString concurrently
+		void _setThreadedShaping( bool bThreaded ) { m_threadedShaping = bThreaded; }
+
+		/** Runs job on every shaping thread (see setNumShapingThreads) including the calling
+			thread, which gets threadIdx = 0. Returns once all of them finished.
+			The worker threads are persistent, thus no thread is created here.
+		@remarks
+			Not reentrant. Jobs must not call this function.
+		*/
+		void runOnShapingThreads( ShapingJobFunc job, void *colibri_nullable userData );
+
 		void addBmpFont( const char *fontPath, bool bBilinearFilter = true );
 
 		BmpFont *getBmpFont( size_t idx ) { return m_bmpFonts[idx]; }
@@ -190,7 +305,7 @@ namespace Colibri
 		*/
 		const CachedGlyph *acquireGlyph( FT_Face font, uint32_t codepoint, uint32_t ptSize,
 										 uint16_t fontIdx, bool bDummy );
-		/// WARNING: const_casts cachedGlyph, which means it's not thread safe
+		/// WARNING: const_casts cachedGlyph. It's only thread safe while threaded shaping is on
 		void addRefCount( const CachedGlyph *cachedGlyph );
 		/** Decreases the reference count of a glyph, for when it's not needed anymore
 		@remarks
@@ -202,7 +317,7 @@ namespace Colibri
 		*/
 		void releaseGlyph( uint32_t codepoint, uint32_t ptSize, uint16_t fontIdx );
 		/// This version is faster
-		/// WARNING: const_casts cachedGlyph, which means it's not thread safe
+		/// WARNING: const_casts cachedGlyph. It's only thread safe while threaded shaping is on
 		void releaseGlyph( const CachedGlyph *cachedGlyph );
 
 		void flushReleasedGlyphs();
@@ -218,6 +333,9 @@ namespace Colibri
 			If true, there are glyph in outShapes we inserted that
 			are in Unicode's private use.
 			See Label.
+		@param threadIdx
+			Index of the shaping thread calling us. See setNumShapingThreads.
+			Only 0 may be used unless _setThreadedShaping( true ) was called.
 		@return
 			If string is fully LTR, returns Left
 			If string is fully RTL, returns Right
@@ -227,7 +345,32 @@ namespace Colibri
 		TextHorizAlignment::TextHorizAlignment renderString(
 			const char *utf8Str, const RichText &richText, uint32_t richTextIdx,
 			VertReadingDir::VertReadingDir vertReadingDir, ShapedGlyphVec &outShapes,
-			bool &bOutHasPrivateUse );
+			bool &bOutHasPrivateUse, size_t threadIdx = 0u );
+
+		/** Shapes all the RichText entries of a string (i.e. a Label) at once.
+
+			Unlike calling the other overload once per RichText, consecutive RichTexts
+			that are contiguous and share the same readingDir are analyzed by BiDi once
+			as a whole. This is faster and produces correct embedding levels across
+			RichText boundaries.
+		@param utf8Str
+			The whole string. RichText::offset is relative to it.
+		@param richTexts [in/out]
+			Must already be validated (i.e. not go out of bounds).
+			RichText::glyphStart & glyphEnd will be set. Since RichTexts may be shaped
+			together, [glyphStart; glyphEnd) may contain glyphs from other RichTexts
+			when mixing directions. Check ShapedGlyph::richTextIdx.
+		@param vertReadingDir
+		@param outShapes
+		@param bOutHasPrivateUse
+		@param threadIdx
+		@return
+			See the other overload. If the RichTexts disagree, returns Mixed.
+		*/
+		TextHorizAlignment::TextHorizAlignment renderString(
+			const char *utf8Str, std::vector<RichText> &richTexts,
+			VertReadingDir::VertReadingDir vertReadingDir, ShapedGlyphVec &outShapes,
+			bool &bOutHasPrivateUse, size_t threadIdx = 0u );
 
 		TextHorizAlignment::TextHorizAlignment getDefaultTextDirection() const;
 		VertReadingDir::VertReadingDir getPreferredVertReadingDir() const;
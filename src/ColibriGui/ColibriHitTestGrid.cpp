@@ -0,0 +1,184 @@
+
+#include "ColibriGui/ColibriHitTestGrid.h"
+
+#include "ColibriGui/ColibriWidget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Colibri
+{
+	const size_t HitTestGrid::c_minChildrenForGrid = 32u;
+	const uint32_t HitTestGrid::c_maxCellsPerAxis = 256u;
+	//-------------------------------------------------------------------------
+	HitTestGrid::HitTestGrid() :
+		m_origin( Ogre::Vector2::ZERO ),
+		m_invCellSize( Ogre::Vector2::ZERO ),
+		m_numCellsX( 0u ),
+		m_numCellsY( 0u ),
+		m_padding( Ogre::Vector2::ZERO ),
+		m_numChildren( 0u ),
+		m_dirty( true )
+	{
+	}
+	//-------------------------------------------------------------------------
+	inline uint32_t HitTestGrid::toCell( float value, uint32_t numCells ) const
+	{
+		// Written so that NaNs end up in cell 0
+		if( !( value > 0.0f ) )
+			return 0u;
+		if( value >= static_cast<float>( numCells ) )
+			return numCells - 1u;
+		return static_cast<uint32_t>( value );
+	}
+	//-------------------------------------------------------------------------
+	void HitTestGrid::getCellRange( const Widget *child, uint32_t &outMinX, uint32_t &outMinY,
+									uint32_t &outMaxX, uint32_t &outMaxY ) const
+	{
+		// Sizes may be negative. Widget::intersects never succeeds then, but be conservative
+		const Ogre::Vector2 topLeft = child->getLocalTopLeft();
+		const Ogre::Vector2 bottomRight = topLeft + child->getSize();
+		Ogre::Vector2 minPos = topLeft;
+		Ogre::Vector2 maxPos = topLeft;
+		minPos.makeFloor( bottomRight );
+		maxPos.makeCeil( bottomRight );
+
+		minPos = ( minPos - m_padding - m_origin ) * m_invCellSize;
+		maxPos = ( maxPos + m_padding - m_origin ) * m_invCellSize;
+
+		outMinX = toCell( minPos.x, m_numCellsX );
+		outMinY = toCell( minPos.y, m_numCellsY );
+		outMaxX = toCell( maxPos.x, m_numCellsX );
+		outMaxY = toCell( maxPos.y, m_numCellsY );
+	}
+	//-------------------------------------------------------------------------
+	void HitTestGrid::update( const WidgetVec &children, size_t numChildren )
+	{
+		if( !m_dirty && m_numChildren == numChildren )
+			return;
+
+		m_dirty = false;
+		m_numChildren = numChildren;
+		m_cellStart.clear();
+		m_cellEntries.clear();
+		m_bigEntries.clear();
+		m_numCellsX = 0u;
+		m_numCellsY = 0u;
+
+		if( !numChildren )
+			return;
+
+		Ogre::Vector2 minPos( std::numeric_limits<float>::max() );
+		Ogre::Vector2 maxPos( -std::numeric_limits<float>::max() );
+
+		for( size_t i = 0u; i < numChildren; ++i )
+		{
+			const Widget *child = children[i];
+			const Ogre::Vector2 topLeft = child->getLocalTopLeft();
+			const Ogre::Vector2 bottomRight = topLeft + child->getSize();
+			minPos.makeFloor( topLeft );
+			minPos.makeFloor( bottomRight );
+			maxPos.makeCeil( topLeft );
+			maxPos.makeCeil( bottomRight );
+		}
+
+		m_padding = ( maxPos - minPos ) * 1e-4f + Ogre::Vector2( 1e-3f );
+		minPos -= m_padding;
+		maxPos += m_padding;
+
+		const Ogre::Vector2 extent = maxPos - minPos;
+		if( !( extent.x > 0.0f && extent.y > 0.0f ) )
+			return;  // NaNs or infinities. Don't use the grid at all
+
+		// Aim for about one child per cell, keeping cells roughly square
+		const float numCellsX = std::sqrt( static_cast<float>( numChildren ) * extent.x / extent.y );
+		m_numCellsX = static_cast<uint32_t>(
+			std::min( std::max( numCellsX, 1.0f ), static_cast<float>( c_maxCellsPerAxis ) ) );
+		m_numCellsY = static_cast<uint32_t>( ( numChildren + m_numCellsX - 1u ) / m_numCellsX );
+		m_numCellsY = std::min( std::max( m_numCellsY, 1u ), c_maxCellsPerAxis );
+
+		m_origin = minPos;
+		m_invCellSize = Ogre::Vector2( static_cast<float>( m_numCellsX ),
+									   static_cast<float>( m_numCellsY ) ) /
+						extent;
+
+		// Children covering more than this (e.g. backgrounds) aren't repeated in every cell
+		const uint32_t numCells = m_numCellsX * m_numCellsY;
+		const uint32_t maxCellsPerChild = std::max( numCells / 16u, 4u );
+
+		// Counting sort. First count how many children each cell has
+		m_cellStart.resize( numCells + 1u, 0u );
+		for( size_t i = 0u; i < numChildren; ++i )
+		{
+			uint32_t minX, minY, maxX, maxY;
+			getCellRange( children[i], minX, minY, maxX, maxY );
+
+			if( ( maxX - minX + 1u ) * ( maxY - minY + 1u ) > maxCellsPerChild )
+			{
+				m_bigEntries.push_back( static_cast<uint32_t>( i ) );
+			}
+			else
+			{
+				for( uint32_t y = minY; y <= maxY; ++y )
+				{
+					for( uint32_t x = minX; x <= maxX; ++x )
+						++m_cellStart[y * m_numCellsX + x + 1u];
+				}
+			}
+		}
+
+		for( uint32_t i = 0u; i < numCells; ++i )
+			m_cellStart[i + 1u] += m_cellStart[i];
+
+		// Now fill. Children are visited in order, thus each cell ends up sorted
+		m_cellEntries.resize( m_cellStart[numCells] );
+		std::vector<uint32_t> cellCursor( m_cellStart.begin(), m_cellStart.end() - 1 );
+
+		std::vector<uint32_t>::const_iterator itBig = m_bigEntries.begin();
+		std::vector<uint32_t>::const_iterator enBig = m_bigEntries.end();
+
+		for( size_t i = 0u; i < numChildren; ++i )
+		{
+			if( itBig != enBig && *itBig == i )
+			{
+				++itBig;
+				continue;
+			}
+
+			uint32_t minX, minY, maxX, maxY;
+			getCellRange( children[i], minX, minY, maxX, maxY );
+
+			for( uint32_t y = minY; y <= maxY; ++y )
+			{
+				for( uint32_t x = minX; x <= maxX; ++x )
+					m_cellEntries[cellCursor[y * m_numCellsX + x]++] = static_cast<uint32_t>( i );
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	void HitTestGrid::queryCell( const Ogre::Vector2 &localPos,
+								 const uint32_t *colibri_nullable &outBegin,
+								 const uint32_t *colibri_nullable &outEnd ) const
+	{
+		outBegin = 0;
+		outEnd = 0;
+
+		if( m_cellEntries.empty() )
+			return;
+
+		const Ogre::Vector2 cellPos = ( localPos - m_origin ) * m_invCellSize;
+		if( !( cellPos.x >= 0.0f && cellPos.y >= 0.0f &&
+			   cellPos.x < static_cast<float>( m_numCellsX ) &&
+			   cellPos.y < static_cast<float>( m_numCellsY ) ) )
+		{
+			// Outside every child (bigger ones are still in m_bigEntries)
+			return;
+		}
+
+		const uint32_t cellIdx =
+			toCell( cellPos.y, m_numCellsY ) * m_numCellsX + toCell( cellPos.x, m_numCellsX );
+		outBegin = m_cellEntries.data() + m_cellStart[cellIdx];
+		outEnd = m_cellEntries.data() + m_cellStart[cellIdx + 1u];
+	}
+}  // namespace Colibri
@@ -36,7 +36,9 @@ namespace Colibri
 		m_horizAlignment( TextHorizAlignment::Natural ),
 		m_vertAlignment( TextVertAlignment::Natural ),
 		m_vertReadingDir( VertReadingDir::Disabled ),
-		m_rasterPrivateArea( 0 )
+		m_rasterPrivateArea( 0 ),
+		m_glyphQuadsInvWindowRes( Ogre::Vector2::ZERO ),
+		m_glyphQuadsDirty( true )
 	{
 		m_overrideSkinColour = true;
 		setVao( m_manager->getTextVao() );
@@ -87,21 +89,23 @@ namespace Colibri
 		if( itor != m_privateAreaGlyphs.end() )
 			return &itor->second;
 
-		if( !m_rasterPrivateArea )
-		{
-			ShaperManager *shaperManager = m_manager->getShaperManager();
-			m_rasterPrivateArea = m_manager->createWidget<LabelBmp>( this );
-			m_rasterPrivateArea->m_rawMode = true;
-			m_rasterPrivateArea->setFont( shaperManager->getDefaultBmpFontForRasterIdx() );
-			m_rasterPrivateArea->setFontSize(
-				shaperManager->getDefaultBmpFontForRaster()->getBakedFontSize() );
-			m_rasterPrivateArea->setSize( m_size );
-		}
-
 		auto insertedIt = m_privateAreaGlyphs.insert( { state, PrivateAreaGlyphsVec() } );
 		return &insertedIt.first->second;
 	}
 	//-------------------------------------------------------------------------
+	void Label::createRasterPrivateArea()
+	{
+		COLIBRI_ASSERT_LOW( !m_rasterPrivateArea );
+
+		ShaperManager *shaperManager = m_manager->getShaperManager();
+		m_rasterPrivateArea = m_manager->createWidget<LabelBmp>( this );
+		m_rasterPrivateArea->m_rawMode = true;
+		m_rasterPrivateArea->setFont( shaperManager->getDefaultBmpFontForRasterIdx() );
+		m_rasterPrivateArea->setFontSize(
+			shaperManager->getDefaultBmpFontForRaster()->getBakedFontSize() );
+		m_rasterPrivateArea->setSize( m_size );
+	}
+	//-------------------------------------------------------------------------
 	Label::PrivateAreaGlyphsVec *Label::getPrivateAreaGlyphs( States::States state )
 	{
 		std::map<States::States, PrivateAreaGlyphsVec>::iterator itor =
@@ -322,10 +326,8 @@ namespace Colibri
 		}
 	}
 	//-------------------------------------------------------------------------
-	void Label::updateGlyphs( States::States state, bool bPlaceGlyphs )
+	void Label::shapeGlyphs( States::States state, size_t threadIdx )
 	{
-		const size_t prevNumGlyphs = m_shapes[state].size();
-
 		ShaperManager *shaperManager = m_manager->getShaperManager();
 
 		{
@@ -390,13 +392,6 @@ namespace Colibri
 							privateAreaGlyphs->clear();
 					}
 
-					if( m_currentState == state && m_glyphsPlaced[state] )
-					{
-						// placeGlyphs will call populateRasterPrivateArea for us.
-						// But otherwise we must do it ourselves.
-						populateRasterPrivateArea();
-					}
-
 					reusableFound = true;
 				}
 			}
@@ -408,50 +403,29 @@ namespace Colibri
 			if( privateAreaGlyphs )
 				privateAreaGlyphs->clear();
 
-			bool alignmentUnknown = true;
-			TextHorizAlignment::TextHorizAlignment actualHorizAlignment = TextHorizAlignment::Mixed;
+			bool bOutHasPrivateUse = false;
+			const TextHorizAlignment::TextHorizAlignment actualHorizAlignment =
+				shaperManager->renderString( m_text[state].c_str(), m_richText[state],
+											 m_vertReadingDir, m_shapes[state], bOutHasPrivateUse,
+											 threadIdx );
 
-			RichTextVec::iterator itor = m_richText[state].begin();
-			RichTextVec::iterator endt = m_richText[state].end();
-			while( itor != endt )
+			if( bOutHasPrivateUse && shaperManager->getDefaultBmpFontForRaster() )
 			{
-				RichText &richText = *itor;
-				richText.glyphStart = static_cast<uint32_t>( m_shapes[state].size() );
-				const char *utf8Str = m_text[state].c_str() + richText.offset;
-				bool bOutHasPrivateUse = false;
-				TextHorizAlignment::TextHorizAlignment actualDir = shaperManager->renderString(
-					utf8Str, richText, static_cast<uint32_t>( itor - m_richText[state].begin() ),
-					m_vertReadingDir, m_shapes[state], bOutHasPrivateUse );
-				richText.glyphEnd = static_cast<uint32_t>( m_shapes[state].size() );
-
-				if( bOutHasPrivateUse && shaperManager->getDefaultBmpFontForRaster() )
-				{
-					// Collect private area glyphs so we can later populate m_rasterPrivateArea
-					privateAreaGlyphs = createPrivateAreaGlyphs( state );
+				// Collect private area glyphs so we can later populate m_rasterPrivateArea
+				privateAreaGlyphs = createPrivateAreaGlyphs( state );
 
-					ShapedGlyphVec::const_iterator it = m_shapes[state].begin() + richText.glyphStart;
-					ShapedGlyphVec::const_iterator en = m_shapes[state].begin() + richText.glyphEnd;
+				ShapedGlyphVec::const_iterator it = m_shapes[state].begin();
+				ShapedGlyphVec::const_iterator en = m_shapes[state].end();
 
-					while( it != en )
+				while( it != en )
+				{
+					if( it->isPrivateArea )
 					{
-						if( it->isPrivateArea )
-						{
-							const uint32_t glyphIdx = uint32_t( it - m_shapes[state].begin() );
-							privateAreaGlyphs->push_back( glyphIdx );
-						}
-						++it;
+						const uint32_t glyphIdx = uint32_t( it - m_shapes[state].begin() );
+						privateAreaGlyphs->push_back( glyphIdx );
 					}
+					++it;
 				}
-
-				if( alignmentUnknown )
-				{
-					actualHorizAlignment = actualDir;
-					alignmentUnknown = true;
-				}
-				else if( actualHorizAlignment != actualDir )
-					actualHorizAlignment = TextHorizAlignment::Mixed;
-
-				++itor;
 			}
 
 			if( m_horizAlignment == TextHorizAlignment::Natural )
@@ -483,9 +457,26 @@ namespace Colibri
 		}
 
 		m_glyphsDirty[state] = false;
+	}
+	//-------------------------------------------------------------------------
+	void Label::updateGlyphs( States::States state, bool bPlaceGlyphs )
+	{
+		const size_t prevNumGlyphs = m_shapes[state].size();
+
+		shapeGlyphs( state, 0u );
+
+		if( !m_rasterPrivateArea && !m_privateAreaGlyphs.empty() )
+			createRasterPrivateArea();
 
 		if( bPlaceGlyphs && !m_glyphsPlaced[state] )
 			placeGlyphs( state );
+		else if( m_currentState == state && m_glyphsPlaced[state] )
+		{
+			// Glyphs were reused from another state that was already placed.
+			// placeGlyphs would've called populateRasterPrivateArea for us.
+			// But otherwise we must do it ourselves.
+			populateRasterPrivateArea();
+		}
 
 		const size_t currNumGlyphs = m_shapes[state].size();
 		if( currNumGlyphs > prevNumGlyphs )
@@ -620,6 +611,8 @@ namespace Colibri
 #if COLIBRIGUI_DEBUG_MEDIUM
 		m_glyphsAligned[state] = false;
 #endif
+		if( state == m_currentState )
+			m_glyphQuadsDirty = true;
 
 		if( performAlignment )
 			alignGlyphs( state );
@@ -630,6 +623,9 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void Label::alignGlyphs( States::States state )
 	{
+		if( state == m_currentState )
+			m_glyphQuadsDirty = true;
+
 		if( m_actualVertReadingDir[state] == VertReadingDir::Disabled )
 			alignGlyphsHorizReadingDir( state );
 		else
@@ -889,64 +885,22 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	inline void Label::addQuad( GlyphVertex *RESTRICT_ALIAS vertexBuffer, Ogre::Vector2 topLeft,
 								Ogre::Vector2 bottomRight, uint16_t glyphWidth, uint16_t glyphHeight,
-								uint32_t rgbaColour, Ogre::Vector2 parentDerivedTL,
-								Ogre::Vector2 parentDerivedBR, Ogre::Vector2 invSize, uint32_t offset,
-								float canvasAspectRatio, float invCanvasAspectRatio,
-								const Matrix2x3& derivedRot )
+								uint32_t rgbaColour, uint32_t offset, uint32_t labelRecordIdx )
 	{
-		TODO_this_is_a_workaround_neg_y;
-		Ogre::Vector2 tmp2d;
-
-#define COLIBRI_ADD_VERTEX( _x, _y, _u, _v, clipDistanceTop, clipDistanceLeft, clipDistanceRight, \
-							clipDistanceBottom ) \
-	tmp2d = Widget::mul( derivedRot, _x, _y * invCanvasAspectRatio ); \
-	tmp2d.y *= canvasAspectRatio; \
-	vertexBuffer->x = tmp2d.x; \
-	vertexBuffer->y = -tmp2d.y; \
-	vertexBuffer->width = glyphWidth; \
-	vertexBuffer->height = glyphHeight; \
-	vertexBuffer->offset = offset; \
-	vertexBuffer->rgbaColour = rgbaColour; \
-	vertexBuffer->clipDistance[Borders::Top] = clipDistanceTop; \
-	vertexBuffer->clipDistance[Borders::Left] = clipDistanceLeft; \
-	vertexBuffer->clipDistance[Borders::Right] = clipDistanceRight; \
-	vertexBuffer->clipDistance[Borders::Bottom] = clipDistanceBottom; \
-	++vertexBuffer
-
-		COLIBRI_ADD_VERTEX( topLeft.x, topLeft.y, 0u, 0u, ( topLeft.y - parentDerivedTL.y ) * invSize.y,
-							( topLeft.x - parentDerivedTL.x ) * invSize.x,
-							( parentDerivedBR.x - topLeft.x ) * invSize.x,
-							( parentDerivedBR.y - topLeft.y ) * invSize.y );
-
-		COLIBRI_ADD_VERTEX(
-			topLeft.x, bottomRight.y, 0u, glyphHeight, ( bottomRight.y - parentDerivedTL.y ) * invSize.y,
-			( topLeft.x - parentDerivedTL.x ) * invSize.x, ( parentDerivedBR.x - topLeft.x ) * invSize.x,
-			( parentDerivedBR.y - bottomRight.y ) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( bottomRight.x, bottomRight.y, glyphWidth, glyphHeight,
-							( bottomRight.y - parentDerivedTL.y ) * invSize.y,
-							( bottomRight.x - parentDerivedTL.x ) * invSize.x,
-							( parentDerivedBR.x - bottomRight.x ) * invSize.x,
-							( parentDerivedBR.y - bottomRight.y ) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( bottomRight.x, bottomRight.y, glyphWidth, glyphHeight,
-							( bottomRight.y - parentDerivedTL.y ) * invSize.y,
-							( bottomRight.x - parentDerivedTL.x ) * invSize.x,
-							( parentDerivedBR.x - bottomRight.x ) * invSize.x,
-							( parentDerivedBR.y - bottomRight.y ) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( bottomRight.x, topLeft.y, glyphWidth, 0u,
-							( topLeft.y - parentDerivedTL.y ) * invSize.y,
-							( bottomRight.x - parentDerivedTL.x ) * invSize.x,
-							( parentDerivedBR.x - bottomRight.x ) * invSize.x,
-							( parentDerivedBR.y - topLeft.y ) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( topLeft.x, topLeft.y, 0u, 0u, ( topLeft.y - parentDerivedTL.y ) * invSize.y,
-							( topLeft.x - parentDerivedTL.x ) * invSize.x,
-							( parentDerivedBR.x - topLeft.x ) * invSize.x,
-							( parentDerivedBR.y - topLeft.y ) * invSize.y );
-
-#undef COLIBRI_ADD_VERTEX
+		// Rotation, y flip & clipping are applied by the vertex shader using the LabelRecord
+		GlyphVertex glyph;
+		glyph.topLeft[0] = topLeft.x;
+		glyph.topLeft[1] = topLeft.y;
+		glyph.size[0] = bottomRight.x - topLeft.x;
+		glyph.size[1] = bottomRight.y - topLeft.y;
+		glyph.width = glyphWidth;
+		glyph.height = glyphHeight;
+		glyph.offset = offset;
+		glyph.rgbaColour = rgbaColour;
+		glyph.labelRecordIdx = labelRecordIdx;
+
+		// Whole-struct copy lets the compiler use wide stores into the (write combined) buffer
+		*vertexBuffer = glyph;
 	}
 	//-------------------------------------------------------------------------
 	bool Label::findNextWord( Word &inOutWord, States::States state ) const
@@ -1043,12 +997,9 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	GlyphVertex *Label::fillBackground( GlyphVertex *RESTRICT_ALIAS textVertBuffer,
 										const Ogre::Vector2 halfWindowRes,
-										const Ogre::Vector2 invWindowRes,
-										const Ogre::Vector2 parentDerivedTL,
-										const Ogre::Vector2 parentDerivedBR, const bool isHorizontal )
+										const Ogre::Vector2 invWindowRes, const bool isHorizontal,
+										const uint32_t labelRecordIdx )
 	{
-		const Ogre::Vector2 invSize = 1.0f / ( parentDerivedBR - parentDerivedTL );
-
 		// Snap position to pixels
 		Ogre::Vector2 derivedTopLeft = m_derivedTopLeft;
 		derivedTopLeft = ( derivedTopLeft + 1.0f ) * halfWindowRes;
@@ -1056,10 +1007,6 @@ namespace Colibri
 		derivedTopLeft.y = roundf( derivedTopLeft.y );
 		derivedTopLeft = derivedTopLeft * invWindowRes - 1.0f;
 
-		const Matrix2x3 derivedRot = m_derivedOrientation;
-		const float canvasAr = m_manager->getCanvasAspectRatio();
-		const float invCanvasAr = m_manager->getCanvasInvAspectRatio();
-
 		RichTextVec::const_iterator itRichText = m_richText[m_currentState].begin();
 		RichTextVec::const_iterator enRichText = m_richText[m_currentState].end();
 
@@ -1091,10 +1038,21 @@ namespace Colibri
 						prevCaretY = itor->caretPos.x;
 				}
 
+				const uint32_t richTextIdx =
+					static_cast<uint32_t>( itRichText - m_richText[m_currentState].begin() );
+
 				while( itor != end )
 				{
 					const ShapedGlyph &shapedGlyph = *itor;
 
+					// RichTexts shaped together may interleave their glyphs (see
+					// ShaperManager::renderParagraphs). Skip those that aren't ours
+					if( shapedGlyph.richTextIdx != richTextIdx )
+					{
+						++itor;
+						continue;
+					}
+
 					const bool changesLine = shapedGlyph.isNewline ||
 											 ( prevCaretY != shapedGlyph.caretPos.y && isHorizontal ) ||
 											 ( prevCaretY != shapedGlyph.caretPos.x && !isHorizontal );
@@ -1141,14 +1099,11 @@ namespace Colibri
 						topLeft = derivedTopLeft + topLeft * invWindowRes;
 						bottomRight = derivedTopLeft + bottomRight * invWindowRes;
 
-						addQuad( textVertBuffer,                                               //
-								 topLeft - backgroundDisplacement,                             //
-								 bottomRight + backgroundDisplacement,                         //
-								 1, 1,                                                         //
-								 backgroundColour, parentDerivedTL, parentDerivedBR, invSize,  //
-								 0,                                                            //
-								 canvasAr, invCanvasAr, derivedRot );
-						textVertBuffer += 6u;
+						addQuad( textVertBuffer,                        //
+								 topLeft - backgroundDisplacement,      //
+								 bottomRight + backgroundDisplacement,  //
+								 1, 1, backgroundColour, 0, labelRecordIdx );
+						++textVertBuffer;
 						m_numVertices += 6u;
 
 						Ogre::Vector2 nextCaret = shapedGlyph.caretPos;
@@ -1181,30 +1136,70 @@ namespace Colibri
 		return textVertBuffer;
 	}
 	//-------------------------------------------------------------------------
+	void Label::updateGlyphQuads( const Ogre::Vector2 &invWindowRes )
+	{
+		m_glyphQuads.clear();
+		m_glyphQuads.reserve( m_shapes[m_currentState].size() );
+
+		ShapedGlyphVec::const_iterator itor = m_shapes[m_currentState].begin();
+		ShapedGlyphVec::const_iterator endt = m_shapes[m_currentState].end();
+
+		while( itor != endt )
+		{
+			const ShapedGlyph &shapedGlyph = *itor;
+
+			if( !shapedGlyph.isNewline && !shapedGlyph.isTab && !shapedGlyph.isPrivateArea )
+			{
+				Ogre::Vector2 topLeft, bottomRight;
+				getCorners( shapedGlyph, topLeft, bottomRight );
+
+				const Ogre::Vector2 glyphSize = bottomRight - topLeft;
+
+				// Snap each glyph to pixels too
+				topLeft.x = roundf( topLeft.x );
+				topLeft.y = roundf( topLeft.y );
+				bottomRight = topLeft + glyphSize;
+
+				GlyphQuad glyphQuad;
+				glyphQuad.topLeft = topLeft * invWindowRes;
+				glyphQuad.bottomRight = bottomRight * invWindowRes;
+				glyphQuad.offsetStart = shapedGlyph.glyph->offsetStart;
+				glyphQuad.width = shapedGlyph.glyph->width;
+				glyphQuad.height = shapedGlyph.glyph->height;
+				glyphQuad.richTextIdx = shapedGlyph.richTextIdx;
+				m_glyphQuads.push_back( glyphQuad );
+			}
+
+			++itor;
+		}
+
+		m_glyphQuadsInvWindowRes = invWindowRes;
+		m_glyphQuadsDirty = false;
+	}
+	//-------------------------------------------------------------------------
 	void Label::_fillBuffersAndCommands( UiVertex **RESTRICT_ALIAS vertexBuffer,
 										 GlyphVertex **RESTRICT_ALIAS _textVertBuffer,
+										 NineSliceRecord **RESTRICT_ALIAS nineSliceBuffer,
 										 const Ogre::Vector2 &parentPos,
 										 const Ogre::Vector2 &parentCurrentScrollPos,
 										 const Matrix2x3 &parentRot )
 	{
 		GlyphVertex *RESTRICT_ALIAS textVertBuffer = *_textVertBuffer;
 
-		updateDerivedTransform( parentPos, parentRot );
-
 		m_culled = true;
 
 		m_numVertices = 0;
-		if( !m_parent->intersectsChild( this, parentCurrentScrollPos ) || m_hidden )
+		if( !m_parent->intersectsChild( this, parentCurrentScrollPos ) || m_hidden ||
+			m_outsideClipRegion )
+		{
 			return;
+		}
 
 		m_culled = false;
 
 		if( !m_visualsEnabled )
 			return;
 
-		m_currVertexBufferOffset =
-			static_cast<uint32_t>( textVertBuffer - m_manager->_getTextVertexBufferBase() );
-
 		const uint32_t shadowColour = m_shadowColour.getAsABGR();
 
 		const Ogre::Vector2 halfWindowRes = m_manager->getHalfWindowResolution();
@@ -1229,11 +1224,48 @@ namespace Colibri
 
 		const Ogre::Vector2 invSize = 1.0f / ( parentDerivedBR - parentDerivedTL );
 
+		textVertBuffer = m_manager->_reserveGlyphRecords(
+			textVertBuffer, c_labelRecordSlots + getMaxNumGlyphs(), m_currChunk );
+
+		// All our glyphs share the same transform & clip rect. Write them once
+		// before the glyphs. See LabelRecord
+		LabelRecord labelRecord;
+		memcpy( labelRecord.derivedRot, m_derivedOrientation.m, sizeof( labelRecord.derivedRot ) );
+		labelRecord.canvasAspectRatio = m_manager->getCanvasAspectRatio();
+		labelRecord.marker = c_labelRecordMarker;
+		labelRecord.parentDerivedTL[0] = parentDerivedTL.x;
+		labelRecord.parentDerivedTL[1] = parentDerivedTL.y;
+		labelRecord.parentDerivedBR[0] = parentDerivedBR.x;
+		labelRecord.parentDerivedBR[1] = parentDerivedBR.y;
+		labelRecord.invSize[0] = invSize.x;
+		labelRecord.invSize[1] = invSize.y;
+		labelRecord.invCanvasAspectRatio = m_manager->getCanvasInvAspectRatio();
+		labelRecord.markerAndIsRotated =
+			c_labelRecordMarker | ( isIdentity( m_derivedOrientation ) ? 0u : 1u );
+		// The vertex shader reads GlyphVertex as 2x uint4 and LabelRecord as 4x uint4.
+		// Both markers must land where GlyphVertex::labelRecordIdx is
+		COLIBRI_STATIC_ASSERT( sizeof( GlyphVertex ) == 2u * 16u );
+		COLIBRI_STATIC_ASSERT( offsetof( GlyphVertex, width ) == 16u );
+		COLIBRI_STATIC_ASSERT( offsetof( GlyphVertex, labelRecordIdx ) == 16u + 12u );
+		COLIBRI_STATIC_ASSERT( offsetof( LabelRecord, marker ) == 16u + 12u );
+		COLIBRI_STATIC_ASSERT( offsetof( LabelRecord, invSize ) == 3u * 16u );
+		COLIBRI_STATIC_ASSERT( offsetof( LabelRecord, markerAndIsRotated ) == 32u + 16u + 12u );
+		COLIBRI_STATIC_ASSERT( sizeof( LabelRecord ) == c_labelRecordSlots * sizeof( GlyphVertex ) );
+		memcpy( textVertBuffer, &labelRecord, sizeof( labelRecord ) );
+
+		// Our draw starts at the LabelRecord so that the next Label can be appended to it.
+		// There's one GlyphVertex per glyph, but the draw has 6 indices per glyph
+		const uint32_t labelRecordIdx =
+			static_cast<uint32_t>( textVertBuffer - m_manager->_getTextVertexBufferBase() );
+		m_currVertexBufferOffset = 6u * labelRecordIdx;
+		m_numVertices = 6u * c_labelRecordSlots;
+		textVertBuffer += c_labelRecordSlots;
+
 		if( m_usesBackground )
 		{
 			const bool isHoriz = m_actualVertReadingDir[m_currentState] == VertReadingDir::Disabled;
-			textVertBuffer = fillBackground( textVertBuffer, halfWindowRes, invWindowRes,
-											 parentDerivedTL, parentDerivedBR, isHoriz );
+			textVertBuffer =
+				fillBackground( textVertBuffer, halfWindowRes, invWindowRes, isHoriz, labelRecordIdx );
 		}
 
 		// Snap position to pixels
@@ -1243,57 +1275,40 @@ namespace Colibri
 		derivedTopLeft.y = roundf( derivedTopLeft.y );
 		derivedTopLeft = derivedTopLeft * invWindowRes - 1.0f;
 
-		const Matrix2x3 derivedRot = m_derivedOrientation;
-		const float canvasAr = m_manager->getCanvasAspectRatio();
-		const float invCanvasAr = m_manager->getCanvasInvAspectRatio();
+		if( m_glyphQuadsDirty || m_glyphQuadsInvWindowRes != invWindowRes )
+			updateGlyphQuads( invWindowRes );
 
-		ShapedGlyphVec::const_iterator itor = m_shapes[m_currentState].begin();
-		ShapedGlyphVec::const_iterator endt = m_shapes[m_currentState].end();
+		const RichTextVec &richTexts = m_richText[m_currentState];
+
+		GlyphQuadVec::const_iterator itor = m_glyphQuads.begin();
+		GlyphQuadVec::const_iterator endt = m_glyphQuads.end();
 
 		while( itor != endt )
 		{
-			const ShapedGlyph &shapedGlyph = *itor;
-
-			if( !shapedGlyph.isNewline && !shapedGlyph.isTab && !shapedGlyph.isPrivateArea )
-			{
-				Ogre::Vector2 topLeft, bottomRight;
-				getCorners( shapedGlyph, topLeft, bottomRight );
-
-				const Ogre::Vector2 glyphSize = bottomRight - topLeft;
-
-				// Snap each glyph to pixels too
-				topLeft.x = roundf( topLeft.x );
-				topLeft.y = roundf( topLeft.y );
-				bottomRight = topLeft + glyphSize;
-
-				topLeft = derivedTopLeft + topLeft * invWindowRes;
-				bottomRight = derivedTopLeft + bottomRight * invWindowRes;
-
-				if( m_shadowOutline )
-				{
-					addQuad( textVertBuffer,                                           //
-							 topLeft + shadowDisplacement,                             //
-							 bottomRight + shadowDisplacement,                         //
-							 shapedGlyph.glyph->width, shapedGlyph.glyph->height,      //
-							 shadowColour, parentDerivedTL, parentDerivedBR, invSize,  //
-							 shapedGlyph.glyph->offsetStart,                           //
-							 canvasAr, invCanvasAr, derivedRot );
-					textVertBuffer += 6u;
-					m_numVertices += 6u;
-				}
+			const GlyphQuad &glyphQuad = *itor;
 
-				const RichText &richText = m_richText[m_currentState][shapedGlyph.richTextIdx];
-
-				addQuad( textVertBuffer, topLeft, bottomRight,                        //
-						 shapedGlyph.glyph->width, shapedGlyph.glyph->height,         //
-						 richText.rgba32, parentDerivedTL, parentDerivedBR, invSize,  //
-						 shapedGlyph.glyph->offsetStart,                              //
-						 canvasAr, invCanvasAr, derivedRot );
-				textVertBuffer += 6u;
+			const Ogre::Vector2 topLeft = derivedTopLeft + glyphQuad.topLeft;
+			const Ogre::Vector2 bottomRight = derivedTopLeft + glyphQuad.bottomRight;
 
+			if( m_shadowOutline )
+			{
+				addQuad( textVertBuffer,                     //
+						 topLeft + shadowDisplacement,       //
+						 bottomRight + shadowDisplacement,   //
+						 glyphQuad.width, glyphQuad.height,  //
+						 shadowColour, glyphQuad.offsetStart, labelRecordIdx );
+				++textVertBuffer;
 				m_numVertices += 6u;
 			}
 
+			addQuad( textVertBuffer, topLeft, bottomRight,       //
+					 glyphQuad.width, glyphQuad.height,          //
+					 richTexts[glyphQuad.richTextIdx].rgba32,    //
+					 glyphQuad.offsetStart, labelRecordIdx );
+			++textVertBuffer;
+
+			m_numVertices += 6u;
+
 			++itor;
 		}
 
@@ -1309,8 +1324,8 @@ namespace Colibri
 		while( itChild != enChild )
 		{
 			( *itChild )
-				->_fillBuffersAndCommands( vertexBuffer, _textVertBuffer, outerTopLeftWithClipping,
-										   Ogre::Vector2::ZERO, finalRot );
+				->_fillBuffersAndCommands( vertexBuffer, _textVertBuffer, nineSliceBuffer,
+										   outerTopLeftWithClipping, Ogre::Vector2::ZERO, finalRot );
 			++itChild;
 		}
 	}
@@ -1327,6 +1342,34 @@ namespace Colibri
 		}
 	}
 	//-------------------------------------------------------------------------
+	void Label::_shapeDirtyGlyphs( size_t threadIdx )
+	{
+		for( size_t i = 0; i < States::NumStates; ++i )
+		{
+			if( m_glyphsDirty[i] )
+				shapeGlyphs( static_cast<States::States>( i ), threadIdx );
+		}
+	}
+	//-------------------------------------------------------------------------
+	void Label::_placeDirtyGlyphs()
+	{
+		if( !m_rasterPrivateArea && !m_privateAreaGlyphs.empty() )
+			createRasterPrivateArea();
+
+		const bool currentStateWasPlaced = m_glyphsPlaced[m_currentState];
+
+		for( size_t i = 0; i < States::NumStates; ++i )
+		{
+			if( !m_glyphsPlaced[i] )
+				placeGlyphs( static_cast<States::States>( i ) );
+		}
+
+		// placeGlyphs will call populateRasterPrivateArea for us.
+		// But otherwise (glyphs reused from a placed state) we must do it ourselves.
+		if( currentStateWasPlaced )
+			populateRasterPrivateArea();
+	}
+	//-------------------------------------------------------------------------
 	bool Label::isAnyStateDirty() const
 	{
 		bool retVal = false;
@@ -1346,6 +1389,8 @@ namespace Colibri
 		m_glyphsAligned[state] = false;
 #endif
 		m_usesBackground = false;
+		if( state == m_currentState )
+			m_glyphQuadsDirty = true;
 	}
 	//-------------------------------------------------------------------------
 	size_t Label::getMaxNumGlyphs() const
@@ -1660,6 +1705,9 @@ namespace Colibri
 		}
 
 		m_minSize = m_size;
+
+		// We changed m_position & m_size directly
+		m_parent->setHitTestGridDirty();
 	}
 	//-------------------------------------------------------------------------
 	void Label::setTransformDirty( uint32_t dirtyReason )
@@ -1694,6 +1742,8 @@ namespace Colibri
 
 		if( oldState != state )
 		{
+			m_glyphQuadsDirty = true;
+
 			// We must replace the glyphs from the new state since it could be
 			// non-dirty but its placement out of date (e.g. Label was in Idle,
 			// glyphs were placed, then changed to Highlighted state, widget was
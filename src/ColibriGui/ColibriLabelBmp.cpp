@@ -28,6 +28,10 @@ namespace Colibri
 	{
 		setVao( m_manager->getVao() );
 
+		//LabelBmp writes real vertices (UiVertex) instead of a NineSliceRecord
+		//Tell HlmsColibri to not use the 9-slice shader path
+		setCustomParameter( 6374, Ogre::Vector4( 1.0f ) );
+
 		m_numVertices = 0;
 
 		ShaperManager *shaperManager = m_manager->getShaperManager();
@@ -95,27 +99,33 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void LabelBmp::_fillBuffersAndCommands( UiVertex **RESTRICT_ALIAS _vertexBuffer,
 											GlyphVertex **RESTRICT_ALIAS _textVertBuffer,
+											NineSliceRecord **RESTRICT_ALIAS nineSliceBuffer,
 											const Ogre::Vector2 &parentPos,
 											const Ogre::Vector2 &parentCurrentScrollPos,
 											const Matrix2x3 &parentRot )
 	{
 		UiVertex *RESTRICT_ALIAS vertexBuffer = *_vertexBuffer;
 
-		updateDerivedTransform( parentPos, parentRot );
-
 		m_culled = true;
 
 		m_numVertices = 0;
-		if( !m_parent->intersectsChild( this, parentCurrentScrollPos ) || m_hidden )
+		if( !m_parent->intersectsChild( this, parentCurrentScrollPos ) || m_hidden ||
+			m_outsideClipRegion )
+		{
 			return;
+		}
 
 		m_culled = false;
 
 		if( !m_visualsEnabled )
 			return;
 
-		m_currVertexBufferOffset =
-			static_cast<uint32_t>( vertexBuffer - m_manager->_getVertexBufferBase() );
+		vertexBuffer = m_manager->_reserveVertices( vertexBuffer, getMaxNumGlyphs() * 6u, m_currChunk );
+
+		m_currVertexBufferOffset = static_cast<uint32_t>(
+			( reinterpret_cast<const uint8_t *>( vertexBuffer ) -
+			  reinterpret_cast<const uint8_t *>( m_manager->_getVertexBufferBase() ) ) /
+			m_manager->getVertexSize() );
 
 		uint8_t shadowColour[4];
 		shadowColour[0] = static_cast<uint8_t>( m_shadowColour.r * 255.0f + 0.5f );
@@ -196,31 +206,27 @@ namespace Colibri
 				topLeft = derivedTopLeft + topLeft * invWindowRes;
 				bottomRight = derivedTopLeft + bottomRight * invWindowRes;
 
+				const Ogre::Vector4 uvTopLeftBottomRight =
+					( Ogre::Vector4( bmpGlyph.bmpChar->x, bmpGlyph.bmpChar->y,
+									 bmpGlyph.bmpChar->x + bmpGlyph.bmpChar->width,
+									 bmpGlyph.bmpChar->y + bmpGlyph.bmpChar->height ) +
+					  0.5f ) *
+					texInvResolution;
+
 				if( m_shadowOutline )
 				{
-					addQuad( vertexBuffer,                      //
-							 topLeft + shadowDisplacement,      //
-							 bottomRight + shadowDisplacement,  //
-							 ( Ogre::Vector4( bmpGlyph.bmpChar->x, bmpGlyph.bmpChar->y,
-											  bmpGlyph.bmpChar->x + bmpGlyph.bmpChar->width,
-											  bmpGlyph.bmpChar->y + bmpGlyph.bmpChar->height ) +
-							   0.5f ) *
-								 texInvResolution,
-							 shadowColour, parentDerivedTL, parentDerivedBR, invSize,  //
-							 canvasAr, invCanvasAr, derivedRot );
-					vertexBuffer += 6u;
+					vertexBuffer = addQuad( vertexBuffer,                                          //
+											topLeft + shadowDisplacement,                          //
+											bottomRight + shadowDisplacement,                      //
+											uvTopLeftBottomRight,                                  //
+											shadowColour, parentDerivedTL, parentDerivedBR, invSize,  //
+											canvasAr, invCanvasAr, derivedRot );
 					m_numVertices += 6u;
 				}
 
-				addQuad( vertexBuffer, topLeft, bottomRight,  //
-						 ( Ogre::Vector4( bmpGlyph.bmpChar->x, bmpGlyph.bmpChar->y,
-										  bmpGlyph.bmpChar->x + bmpGlyph.bmpChar->width,
-										  bmpGlyph.bmpChar->y + bmpGlyph.bmpChar->height ) +
-						   0.5f ) *
-							 texInvResolution,
-						 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,  //
-						 canvasAr, invCanvasAr, derivedRot );
-				vertexBuffer += 6u;
+				vertexBuffer = addQuad( vertexBuffer, topLeft, bottomRight, uvTopLeftBottomRight,  //
+										rgbaColour, parentDerivedTL, parentDerivedBR, invSize,     //
+										canvasAr, invCanvasAr, derivedRot );
 
 				m_numVertices += 6u;
 			}
@@ -259,8 +265,8 @@ namespace Colibri
 		while( itChild != enChild )
 		{
 			( *itChild )
-				->_fillBuffersAndCommands( _vertexBuffer, _textVertBuffer, outerTopLeftWithClipping,
-										   Ogre::Vector2::ZERO, finalRot );
+				->_fillBuffersAndCommands( _vertexBuffer, _textVertBuffer, nineSliceBuffer,
+										   outerTopLeftWithClipping, Ogre::Vector2::ZERO, finalRot );
 			++itChild;
 		}
 	}
@@ -375,6 +381,9 @@ namespace Colibri
 		m_size.x = std::ceil( m_size.x );
 		m_size.y = std::ceil( m_size.y );
 		m_minSize = m_size;
+
+		// We changed m_size directly
+		m_parent->setHitTestGridDirty();
 	}
 	//-------------------------------------------------------------------------
 	void LabelBmp::setState( States::States state, bool smartHighlight )
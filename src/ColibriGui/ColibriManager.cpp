@@ -13,20 +13,58 @@
 #include "ColibriGui/Ogre/OgreHlmsColibriDatablock.h"
 #include "Vao/OgreVaoManager.h"
 #include "Vao/OgreVertexArrayObject.h"
+#include "Vao/OgreIndexBufferPacked.h"
 #include "Vao/OgreIndirectBufferPacked.h"
 #include "Math/Array/OgreObjectMemoryManager.h"
 #include "OgreHlmsManager.h"
 #include "OgreHlms.h"
 #include "OgreRoot.h"
+#include "OgreRenderSystem.h"
 #include "CommandBuffer/OgreCommandBuffer.h"
 #include "CommandBuffer/OgreCbDrawCall.h"
 
+#include <atomic>
+
 namespace Colibri
 {
 	static LogListener DefaultLogListener;
 	static ColibriListener DefaultColibriListener;
 	static const Ogre::HlmsCache c_dummyCache( 0, Ogre::HLMS_MAX, Ogre::HlmsPso() );
 
+	namespace
+	{
+		/// Adds the widget to one of our unordered lists, remembering where it is
+		template <typename T>
+		void addToRegistry( std::vector<T *> &registry, T *widget, uint32_t Widget::*idx )
+		{
+			widget->*idx = static_cast<uint32_t>( registry.size() );
+			registry.push_back( widget );
+		}
+
+		/// Removes the widget in O(1) by moving the last entry into its place
+		template <typename T>
+		void removeFromRegistry( std::vector<T *> &registry, T *widget, uint32_t Widget::*idx )
+		{
+			const uint32_t widgetIdx = widget->*idx;
+			COLIBRI_ASSERT_LOW( widgetIdx < registry.size() && registry[widgetIdx] == widget );
+
+			T *lastWidget = registry.back();
+			registry[widgetIdx] = lastWidget;
+			lastWidget->*idx = widgetIdx;
+			registry.pop_back();
+
+			widget->*idx = Widget::c_notInRegistry;
+		}
+	}  // namespace
+
+	const size_t ColibriManager::c_minDirtyLabelsForThreading = 64u;
+	const size_t ColibriManager::c_bufferShrinkRatio = 4u;
+	const uint32_t ColibriManager::c_framesBeforeBufferShrink = 300u;
+	const size_t ColibriManager::c_indirectDrawsPerChunk = 1024u;
+	const size_t ColibriManager::c_nineSliceRecordsPerChunk = 512u;
+	const size_t ColibriManager::c_glyphRecordsPerChunk = 4096u;
+	const size_t ColibriManager::c_labelBmpVerticesPerChunk = 6u * 512u;
+
 	const std::string ColibriManager::c_defaultTextDatablockNames[States::NumStates] =
 	{
 		"# Colibri Disabled Text #",
@@ -42,10 +80,14 @@ namespace Colibri
 		m_numLabelsAndBmp( 0u ),
 		m_numTextGlyphs( 0u ),
 		m_numTextGlyphsBmp( 0u ),
+		m_maxLabelGlyphs( 0u ),
+		m_maxLabelBmpGlyphs( 0u ),
+		m_numFramesBuffersOversized( 0u ),
 		m_logListener( &DefaultLogListener ),
 		m_colibriListener( &DefaultColibriListener ),
 		m_delayingDestruction( false ),
 		m_swapRTLControls( false ),
+		m_compactVertexFormat( false ),
 		m_windowNavigationDirty( false ),
 		m_numGlyphsDirty( false ),
 		m_numGlyphsBmpDirty( false ),
@@ -56,8 +98,10 @@ namespace Colibri
 		m_vaoManager( 0 ),
 		m_objectMemoryManager( 0 ),
 		m_sceneManager( 0 ),
-		m_vao( 0 ),
-		m_indirectBuffer( 0 ),
+		m_textVao( 0 ),
+		m_nineSliceVao( 0 ),
+		m_quadIndexBuffer( 0 ),
+		m_currIndirectBuffer( 0u ),
 		m_commandBuffer( 0 ),
 		m_allowingScrollAlways( false ),
 		m_allowingScrollGestureWhileButtonDown( false ),
@@ -78,7 +122,14 @@ namespace Colibri
 		m_skinManager( 0 ),
 		m_shaperManager( 0 ),
 		m_vertexBufferBase( 0 ),
-		m_textVertexBufferBase( 0 )
+		m_vertexBufferEnd( 0 ),
+		m_textVertexBufferBase( 0 ),
+		m_textVertexBufferEnd( 0 ),
+		m_nineSliceRecordBufferBase( 0 ),
+		m_nineSliceRecordBufferEnd( 0 ),
+		m_currVertexChunk( 0u ),
+		m_currGlyphRecordChunk( 0u ),
+		m_currNineSliceRecordChunk( 0u )
 	#if COLIBRIGUI_DEBUG_MEDIUM
 	,	m_fillBuffersStarted( false )
 	,	m_renderingStarted( false )
@@ -105,6 +156,25 @@ namespace Colibri
 		setOgre( 0, 0, 0 );
 		delete m_skinManager;
 		m_skinManager = 0;
+
+		if( m_numWidgets )
+		{
+			// Their memory lives in m_widgetPools. Leak it rather than leaving dangling widgets
+			m_logListener->log( "ColibriManager destroyed while widgets are still alive. "
+								"Destroy all windows first", LogSeverity::Warning );
+		}
+		else
+		{
+			std::vector<WidgetPool *>::const_iterator itor = m_widgetPools.begin();
+			std::vector<WidgetPool *>::const_iterator endt = m_widgetPools.end();
+
+			while( itor != endt )
+			{
+				delete *itor;
+				++itor;
+			}
+		}
+		m_widgetPools.clear();
 	}
 	//-------------------------------------------------------------------------
 	void ColibriManager::setLogListener( LogListener *logListener )
@@ -132,23 +202,22 @@ namespace Colibri
 	{
 		delete m_commandBuffer;
 		m_commandBuffer = 0;
-		if( m_indirectBuffer )
+		destroyAllChunks();
+		if( m_textVao )
 		{
-			if( m_indirectBuffer->getMappingState() != Ogre::MS_UNMAPPED )
-				m_indirectBuffer->unmap( Ogre::UO_UNMAP_ALL );
-			m_vaoManager->destroyIndirectBuffer( m_indirectBuffer );
-			m_indirectBuffer = 0;
+			Ogre::ColibriOgreRenderable::destroyVao( m_textVao, m_vaoManager );
+			m_textVao = 0;
 		}
-		if( m_vao )
+		if( m_nineSliceVao )
 		{
-			Ogre::ColibriOgreRenderable::destroyVao( m_vao, m_vaoManager );
-			m_vao = 0;
+			Ogre::ColibriOgreRenderable::destroyVao( m_nineSliceVao, m_vaoManager );
+			m_nineSliceVao = 0;
 		}
-		/*if( m_defaultIndexBuffer )
+		if( m_quadIndexBuffer )
 		{
-			m_vaoManager->destroyIndexBuffer( m_defaultIndexBuffer );
-			m_defaultIndexBuffer = 0;
-		}*/
+			m_vaoManager->destroyIndexBuffer( m_quadIndexBuffer );
+			m_quadIndexBuffer = 0;
+		}
 		delete m_objectMemoryManager;
 		m_objectMemoryManager = 0;
 
@@ -159,13 +228,18 @@ namespace Colibri
 		if( vaoManager )
 		{
 			m_objectMemoryManager = new Ogre::ObjectMemoryManager();
-			//m_defaultIndexBuffer = Ogre::ColibriOgreRenderable::createIndexBuffer( vaoManager );
-			m_vao = Ogre::ColibriOgreRenderable::createVao( 6u * 9u, vaoManager );
-			m_textVao = Ogre::ColibriOgreRenderable::createTextVao( 6u * 16u, vaoManager );
-			size_t requiredBytes = 1u * sizeof( Ogre::CbDrawStrip );
-			m_indirectBuffer = m_vaoManager->createIndirectBuffer( requiredBytes,
-																   Ogre::BT_DYNAMIC_PERSISTENT,
-																   0, false );
+			m_quadIndexBuffer = Ogre::ColibriOgreRenderable::createQuadIndexBuffer(
+				c_maxNineSliceWidgetsPerDraw * 9u, vaoManager );
+			m_textVao = Ogre::ColibriOgreRenderable::createTextVao(
+				c_maxNineSliceWidgetsPerDraw * ( 4u * 9u ), m_quadIndexBuffer, vaoManager );
+			m_nineSliceVao = Ogre::ColibriOgreRenderable::createNineSliceVao(
+				c_maxNineSliceWidgetsPerDraw * ( 4u * 9u ), m_quadIndexBuffer, vaoManager );
+			resizeVaos( 1u, c_labelBmpVerticesPerChunk );
+			resizeRecordBuffers( m_glyphRecordBuffers, 1u,
+								 c_glyphRecordsPerChunk * sizeof( GlyphVertex ) );
+			resizeRecordBuffers( m_nineSliceRecordBuffers, 1u,
+								 c_nineSliceRecordsPerChunk * sizeof( NineSliceRecord ) );
+			resizeIndirectBuffers( 1u );
 			m_commandBuffer = new Ogre::CommandBuffer();
 			m_commandBuffer->setCurrentRenderSystem( m_sceneManager->getDestinationRenderSystem() );
 		}
@@ -215,6 +289,18 @@ namespace Colibri
 		return m_root->getHlmsManager();
 	}
 	//-------------------------------------------------------------------------
+	void ColibriManager::setCompactVertexFormat( bool compactVertexFormat )
+	{
+		COLIBRI_ASSERT_LOW( m_vaos.empty() &&
+							"setCompactVertexFormat must be called before setOgre" );
+		m_compactVertexFormat = compactVertexFormat;
+	}
+	//-------------------------------------------------------------------------
+	size_t ColibriManager::getVertexSize() const
+	{
+		return m_compactVertexFormat ? sizeof( UiVertexCompact ) : sizeof( UiVertex );
+	}
+	//-------------------------------------------------------------------------
 	void ColibriManager::setSwapRTLControls( bool swapRtl )
 	{
 		m_swapRTLControls = swapRtl;
@@ -678,17 +764,12 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ColibriManager::updateAllDerivedTransforms()
 	{
+		propagateTransformDirty();
+
 		if( !m_widgetTransformsDirty )
 			return;
 
-		WindowVec::const_iterator itor = m_windows.begin();
-		WindowVec::const_iterator endt = m_windows.end();
-
-		while( itor != endt )
-		{
-			( *itor )->_updateDerivedTransformOnly( -Ogre::Vector2::UNIT_SCALE, Matrix2x3::IDENTITY );
-			++itor;
-		}
+		m_transformStore.update( m_windows, getInvCanvasSize2x(), getCanvasInvAspectRatio() );
 
 		m_widgetTransformsDirty = false;
 	}
@@ -790,10 +871,13 @@ namespace Colibri
 		COLIBRI_ASSERT( (!parent || parent->isWindow()) &&
 						"parent can only be null or a window!" );
 
-		Window *retVal = new Window( this );
+		Window *retVal = allocateWidget<Window>();
 
 		if( !parent )
+		{
 			m_windows.push_back( retVal );
+			m_transformStore.setLayoutDirty();
+		}
 		else
 		{
 			parent->m_childWindows.push_back( retVal );
@@ -837,15 +921,49 @@ namespace Colibri
 		return retVal;
 	}
 	//-------------------------------------------------------------------------
+	WidgetPool *ColibriManager::getWidgetPool( size_t sizeBytes )
+	{
+		const size_t objectSize = WidgetPool::calculateObjectSize( sizeBytes );
+
+		std::vector<WidgetPool *>::const_iterator itor = m_widgetPools.begin();
+		std::vector<WidgetPool *>::const_iterator endt = m_widgetPools.end();
+
+		while( itor != endt && ( *itor )->getObjectSize() != objectSize )
+			++itor;
+
+		if( itor != endt )
+			return *itor;
+
+		WidgetPool *pool = new WidgetPool( objectSize );
+		m_widgetPools.push_back( pool );
+		return pool;
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::freeWidget( Widget *widget )
+	{
+		WidgetPool *pool = widget->m_widgetPool;
+		if( pool )
+		{
+			// With multiple inheritance Widget may not be at the start of the allocation
+			void *memory = dynamic_cast<void *>( widget );
+			widget->~Widget();
+			pool->deallocate( memory );
+		}
+		else
+		{
+			delete widget;
+		}
+	}
+	//-------------------------------------------------------------------------
 	void ColibriManager::_notifyLabelCreated( Label* label )
 	{
-		m_labels.push_back( label );
+		addToRegistry( m_labels, label, &Widget::m_labelsIdx );
 		++m_numLabelsAndBmp;
 	}
 	//-------------------------------------------------------------------------
 	void ColibriManager::_notifyLabelBmpCreated( LabelBmp* label )
 	{
-		m_labelsBmp.push_back( label );
+		addToRegistry( m_labelsBmp, label, &Widget::m_labelsIdx );
 		++m_numLabelsAndBmp;
 	}
 	//-------------------------------------------------------------------------
@@ -875,16 +993,11 @@ namespace Colibri
 				m_windows.erase( itor );
 		}
 
-		// Make sure this window is not in the dirtyWidgets list. It may have duplicates
-		WidgetVec::iterator itor = std::find( m_dirtyWidgets.begin(), m_dirtyWidgets.end(), window );
-		while( itor != m_dirtyWidgets.end() )
-		{
-			itor = m_dirtyWidgets.erase( itor );
-			itor = std::find( itor, m_dirtyWidgets.end(), window );
-		}
+		removeFromTransformDirtyLists( window );
 
 		window->_destroy();
-		delete window;
+		freeWidget( window );
+		m_transformStore.setLayoutDirty();
 
 		--m_numWidgets;
 	}
@@ -903,11 +1016,6 @@ namespace Colibri
 		if( widget == m_keyboardFocusedPair.widget )
 			m_keyboardFocusedPair.widget = 0;
 
-		// If a widget was created and destroyed before update was called, there would still be some
-		// entries for that widget's labels in the dirty labels list. When update is later called it
-		// would read invalid pointers. Calling this here prevents that.
-		_updateDirtyLabels();
-
 		if( widget->isWindow() )
 		{
 			COLIBRI_ASSERT( dynamic_cast<Window*>( widget ) );
@@ -915,37 +1023,128 @@ namespace Colibri
 		}
 		else
 		{
-			// Make sure this widget is not in the dirtyWidgets list. It may have duplicates
-			WidgetVec::iterator itor = std::find( m_dirtyWidgets.begin(), m_dirtyWidgets.end(), widget );
-			while( itor != m_dirtyWidgets.end() )
-			{
-				itor = m_dirtyWidgets.erase( itor );
-				itor = std::find( itor, m_dirtyWidgets.end(), widget );
-			}
+			removeFromTransformDirtyLists( widget );
 
-			if( widget->isLabel() )
+			Label *label = 0;
+			LabelBmp *labelBmp = 0;
+
+			// destroyWidgetTree may have already removed us from m_labels & m_labelsBmp
+			if( widget->isLabel() && widget->m_labelsIdx != Widget::c_notInRegistry )
 			{
-				//We do not update m_numTextGlyphs since it's pointless to shrink it.
-				//It will eventually be recalculated anyway
-				LabelVec::iterator it = std::find( m_labels.begin(), m_labels.end(), widget );
-				Ogre::efficientVectorRemove( m_labels, it );
+				//Recalculate m_numTextGlyphs so that the buffers can eventually shrink
+				COLIBRI_ASSERT( dynamic_cast<Label *>( widget ) );
+				label = static_cast<Label *>( widget );
+				removeFromRegistry( m_labels, label, &Widget::m_labelsIdx );
 				--m_numLabelsAndBmp;
+				m_numGlyphsDirty = true;
 			}
-			else if( widget->isLabelBmp() )
+			else if( widget->isLabelBmp() && widget->m_labelsIdx != Widget::c_notInRegistry )
 			{
-				//We do not update m_numTextGlyphsBmp since it's pointless to shrink it.
-				//It will eventually be recalculated anyway
-				LabelBmpVec::iterator it = std::find( m_labelsBmp.begin(), m_labelsBmp.end(), widget );
-				Ogre::efficientVectorRemove( m_labelsBmp, it );
+				//Recalculate m_numTextGlyphsBmp so that the buffers can eventually shrink
+				COLIBRI_ASSERT( dynamic_cast<LabelBmp *>( widget ) );
+				labelBmp = static_cast<LabelBmp *>( widget );
+				removeFromRegistry( m_labelsBmp, labelBmp, &Widget::m_labelsIdx );
 				--m_numLabelsAndBmp;
+				m_numGlyphsBmpDirty = true;
 			}
 
 			widget->_destroy();
-			delete widget;
+
+			// If a label was created and destroyed before update was called, it would still be
+			// in the dirty labels list. When update is later called it would read invalid pointers
+			if( label && label->m_dirtyLabelsIdx != Widget::c_notInRegistry )
+				removeFromRegistry( m_dirtyLabels, label, &Widget::m_dirtyLabelsIdx );
+			if( labelBmp && labelBmp->m_dirtyLabelsIdx != Widget::c_notInRegistry )
+				removeFromRegistry( m_dirtyLabelBmps, labelBmp, &Widget::m_dirtyLabelsIdx );
+
+			freeWidget( widget );
 			--m_numWidgets;
+			m_transformStore.setLayoutDirty();
 		}
 	}
 	//-------------------------------------------------------------------------
+	template <typename T>
+	size_t ColibriManager::purgeTreeBeingDestroyed( std::vector<T *> &registry,
+													uint32_t Widget::*idx )
+	{
+		const size_t numEntries = registry.size();
+		size_t numKept = 0u;
+
+		for( size_t i = 0u; i < numEntries; ++i )
+		{
+			T *widget = registry[i];
+			if( widget->m_treeBeingDestroyed )
+			{
+				widget->*idx = Widget::c_notInRegistry;
+			}
+			else
+			{
+				widget->*idx = static_cast<uint32_t>( numKept );
+				registry[numKept++] = widget;
+			}
+		}
+
+		registry.resize( numKept );
+		return numEntries - numKept;
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::destroyWindowTree( Window *window ) { destroyWidgetTree( window ); }
+	//-------------------------------------------------------------------------
+	void ColibriManager::destroyWidgetTree( Widget *widget )
+	{
+		if( m_delayingDestruction )
+		{
+			// It's not safe to touch our lists now. Destroy it the regular way later
+			destroyWidget( widget );
+			return;
+		}
+
+		// Flag the whole tree. Child windows are in m_children too
+		bool bTreeHasLabels = false;
+		bool bTreeHasLabelBmps = false;
+		bool bTreeHasTransformDirty = false;
+
+		WidgetVec stack;
+		stack.push_back( widget );
+		while( !stack.empty() )
+		{
+			Widget *child = stack.back();
+			stack.pop_back();
+
+			child->m_treeBeingDestroyed = true;
+			bTreeHasLabels |= child->isLabel();
+			bTreeHasLabelBmps |= child->isLabelBmp();
+			if( child->m_pendingTransformDirty )
+			{
+				// Its m_transformDirtyQueue entry is purged below
+				child->m_pendingTransformDirty = 0u;
+				bTreeHasTransformDirty = true;
+			}
+			stack.insert( stack.end(), child->m_children.begin(), child->m_children.end() );
+		}
+
+		// One sweep per list. Afterwards destroyWidget/destroyWindow will
+		// find every widget in the tree is no longer in any of them
+		purgeTreeBeingDestroyed( m_dirtyWidgets, &Widget::m_dirtyWidgetsIdx );
+		purgeTreeBeingDestroyed( m_updateWidgets, &Widget::m_updateWidgetsIdx );
+		if( bTreeHasTransformDirty )
+			purgeTreeBeingDestroyed( m_transformDirtyQueue, &Widget::m_transformDirtyQueueIdx );
+		if( bTreeHasLabels )
+		{
+			m_numLabelsAndBmp -= purgeTreeBeingDestroyed( m_labels, &Widget::m_labelsIdx );
+			purgeTreeBeingDestroyed( m_dirtyLabels, &Widget::m_dirtyLabelsIdx );
+			m_numGlyphsDirty = true;
+		}
+		if( bTreeHasLabelBmps )
+		{
+			m_numLabelsAndBmp -= purgeTreeBeingDestroyed( m_labelsBmp, &Widget::m_labelsIdx );
+			purgeTreeBeingDestroyed( m_dirtyLabelBmps, &Widget::m_dirtyLabelsIdx );
+			m_numGlyphsBmpDirty = true;
+		}
+
+		destroyWidget( widget );
+	}
+	//-------------------------------------------------------------------------
 	void ColibriManager::destroyDelayedWidgets()
 	{
 		m_delayingDestruction = false;
@@ -998,24 +1197,90 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ColibriManager::_scheduleSetTransformDirty( Widget *widget )
 	{
-		// We may add m_dirtyWidgets more than once.
-		// This is a cheap operation so we don't care too much about duplicates.
-		// However we can still filter out two consecutive calls in a row
-		if( m_dirtyWidgets.empty() || m_dirtyWidgets.back() != widget )
-			m_dirtyWidgets.push_back( widget );
+		if( widget->m_dirtyWidgetsIdx == Widget::c_notInRegistry )
+			addToRegistry( m_dirtyWidgets, widget, &Widget::m_dirtyWidgetsIdx );
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::_queueTransformDirty( Widget *widget )
+	{
+		COLIBRI_ASSERT_LOW( !widget->m_pendingTransformDirty );
+		// propagateTransformDirty may queue a widget again after it was processed. Its old
+		// entry stays until the queue is cleared, thus m_transformDirtyQueueIdx is the latest
+		addToRegistry( m_transformDirtyQueue, widget, &Widget::m_transformDirtyQueueIdx );
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::removeFromTransformDirtyLists( Widget *widget )
+	{
+		if( widget->m_dirtyWidgetsIdx != Widget::c_notInRegistry )
+			removeFromRegistry( m_dirtyWidgets, widget, &Widget::m_dirtyWidgetsIdx );
+
+		if( widget->m_pendingTransformDirty )
+		{
+			removeFromRegistry( m_transformDirtyQueue, widget, &Widget::m_transformDirtyQueueIdx );
+			widget->m_pendingTransformDirty = 0u;
+		}
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::propagateTransformDirty()
+	{
+		WidgetVec stack;
+
+		// The overrides of setTransformDirty may queue more widgets while we iterate
+		for( size_t i = 0u; i < m_transformDirtyQueue.size(); ++i )
+		{
+			Widget *dirtyRoot = m_transformDirtyQueue[i];
+			if( !dirtyRoot->m_pendingTransformDirty )
+				continue;  // Already covered by a dirty ancestor
+
+			bool bCoveredByAncestor = false;
+			Widget *parent = dirtyRoot->m_parent;
+			while( parent && !bCoveredByAncestor )
+			{
+				bCoveredByAncestor = parent->m_pendingTransformDirty != 0u;
+				parent = parent->m_parent;
+			}
+
+			if( bCoveredByAncestor )
+				continue;
+
+			stack.push_back( dirtyRoot );
+			while( !stack.empty() )
+			{
+				Widget *widget = stack.back();
+				stack.pop_back();
+
+				const uint32_t dirtyReason = widget->m_pendingTransformDirty;
+				widget->m_pendingTransformDirty = 0u;
+
+				WidgetVec::const_iterator itor = widget->m_children.begin();
+				WidgetVec::const_iterator endt = widget->m_children.end();
+
+				while( itor != endt )
+				{
+					// Children with children will set their own m_pendingTransformDirty and
+					// end up in m_transformDirtyQueue, which we skip since we handle them now
+					Widget *child = *itor;
+					child->setTransformDirty( dirtyReason );
+					if( child->m_pendingTransformDirty )
+						stack.push_back( child );
+					++itor;
+				}
+			}
+		}
+
+		m_transformDirtyQueue.clear();
 	}
 	//-----------------------------------------------------------------------------------
 	void ColibriManager::_addUpdateWidget( Widget *widget )
 	{
-		m_updateWidgets.push_back( widget );
+		if( widget->m_updateWidgetsIdx == Widget::c_notInRegistry )
+			addToRegistry( m_updateWidgets, widget, &Widget::m_updateWidgetsIdx );
 	}
 	//-----------------------------------------------------------------------------------
 	void ColibriManager::_removeUpdateWidget( Widget *widget )
 	{
-		WidgetVec::iterator itor = std::find( m_updateWidgets.begin(), m_updateWidgets.end(), widget );
-
-		if( itor != m_updateWidgets.end() )
-			m_updateWidgets.erase( itor );
+		if( widget->m_updateWidgetsIdx != Widget::c_notInRegistry )
+			removeFromRegistry( m_updateWidgets, widget, &Widget::m_updateWidgetsIdx );
 	}
 	//-----------------------------------------------------------------------------------
 	void ColibriManager::overrideKeyboardFocusWith( const FocusPair &_focusedPair )
@@ -1056,63 +1321,231 @@ namespace Colibri
 		m_mouseCursorButtonDown = false;
 	}
 	//-----------------------------------------------------------------------------------
-	void ColibriManager::checkVertexBufferCapacity()
+	bool ColibriManager::useReadOnlyRecordBuffers() const
 	{
-		COLIBRI_ASSERT_LOW( m_dirtyLabels.empty() && "updateDirtyLabels has not been called!" );
-		COLIBRI_ASSERT_LOW( m_dirtyLabelBmps.empty() && "updateDirtyLabels has not been called!" );
-
-		bool anyVaoChanged = false;
-
-		if( m_numWidgets * sizeof( Ogre::CbDrawStrip ) > m_indirectBuffer->getNumElements() )
+		return Ogre::HlmsColibri::needsReadOnlyBuffer(
+			m_sceneManager->getDestinationRenderSystem()->getCapabilities(), m_vaoManager );
+	}
+	//-------------------------------------------------------------------------
+	bool ColibriManager::isBufferOversized( size_t requiredSize, size_t currSize, size_t minSize )
+	{
+		return currSize > minSize && requiredSize * c_bufferShrinkRatio < currSize;
+	}
+	//-------------------------------------------------------------------------
+	size_t ColibriManager::calculateNumChunks( size_t requiredSize, size_t usablePerChunk )
+	{
+		return std::max<size_t>( ( requiredSize + usablePerChunk - 1u ) / usablePerChunk, 1u );
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::resizeRecordBuffers( std::vector<Ogre::BufferPacked *> &chunks,
+											  size_t numChunks, size_t chunkBytes )
+	{
+		if( !chunks.empty() && chunks.front()->getTotalSizeBytes() != chunkBytes )
 		{
-			if( m_indirectBuffer->getMappingState() != Ogre::MS_UNMAPPED )
-				m_indirectBuffer->unmap( Ogre::UO_UNMAP_ALL );
-			m_vaoManager->destroyIndirectBuffer( m_indirectBuffer );
-			const size_t requiredBytes = m_numWidgets * sizeof( Ogre::CbDrawStrip );
-			m_indirectBuffer = m_vaoManager->createIndirectBuffer( requiredBytes,
-																   Ogre::BT_DYNAMIC_PERSISTENT,
-																   0, false );
+			//Chunk size changed. All chunks must be recreated
+			while( !chunks.empty() )
+			{
+				Ogre::ColibriOgreRenderable::destroyRecordBuffer( chunks.back(), m_vaoManager );
+				chunks.pop_back();
+			}
 		}
 
+		while( chunks.size() > numChunks )
 		{
-			// Vertex buffer for most widgets
-			const Ogre::uint32 requiredVertexCount = static_cast<Ogre::uint32>(
-				( m_numWidgets - m_numLabelsAndBmp ) * ( 6u * 9u ) +  // Regular widgets
-				( m_numTextGlyphsBmp * 6u )                           // BmpLabel
-			);
+			Ogre::ColibriOgreRenderable::destroyRecordBuffer( chunks.back(), m_vaoManager );
+			chunks.pop_back();
+		}
 
-			Ogre::VertexBufferPacked *vertexBuffer = m_vao->getBaseVertexBuffer();
-			const uint32_t currVertexCount = static_cast<uint32_t>( vertexBuffer->getNumElements() );
-			if( requiredVertexCount > currVertexCount )
+		if( chunks.size() < numChunks )
+		{
+			const bool useReadOnlyBuffers = useReadOnlyRecordBuffers();
+			while( chunks.size() < numChunks )
 			{
-				const Ogre::uint32 newVertexCount = std::max( requiredVertexCount,
-															  currVertexCount +
-															  (currVertexCount >> 1u) );
-				Ogre::ColibriOgreRenderable::destroyVao( m_vao, m_vaoManager );
-				m_vao = Ogre::ColibriOgreRenderable::createVao( newVertexCount, m_vaoManager );
+				chunks.push_back( Ogre::ColibriOgreRenderable::createRecordBuffer(
+					chunkBytes, useReadOnlyBuffers, m_vaoManager ) );
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	bool ColibriManager::resizeVaos( size_t numChunks, size_t chunkVertices )
+	{
+		bool firstVaoChanged = false;
 
-				anyVaoChanged = true;
+		if( !m_vaos.empty() &&
+			m_vaos.front()->getBaseVertexBuffer()->getNumElements() != chunkVertices )
+		{
+			while( !m_vaos.empty() )
+			{
+				Ogre::ColibriOgreRenderable::destroyVao( m_vaos.back(), m_vaoManager );
+				m_vaos.pop_back();
 			}
 		}
 
+		while( m_vaos.size() > numChunks )
 		{
-			//Vertex buffer for text
-			const Ogre::uint32 requiredVertexCount =
-					static_cast<Ogre::uint32>( m_numTextGlyphs * 6u );
+			Ogre::ColibriOgreRenderable::destroyVao( m_vaos.back(), m_vaoManager );
+			m_vaos.pop_back();
+		}
+
+		while( m_vaos.size() < numChunks )
+		{
+			firstVaoChanged |= m_vaos.empty();
+			m_vaos.push_back( Ogre::ColibriOgreRenderable::createVao(
+				static_cast<Ogre::uint32>( chunkVertices ), m_compactVertexFormat, m_vaoManager ) );
+		}
+
+		return firstVaoChanged;
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::resizeIndirectBuffers( size_t numChunks )
+	{
+		while( m_indirectBuffers.size() > numChunks )
+		{
+			Ogre::IndirectBufferPacked *indirectBuffer = m_indirectBuffers.back();
+			if( indirectBuffer->getMappingState() != Ogre::MS_UNMAPPED )
+				indirectBuffer->unmap( Ogre::UO_UNMAP_ALL );
+			m_vaoManager->destroyIndirectBuffer( indirectBuffer );
+			m_indirectBuffers.pop_back();
+		}
 
-			Ogre::VertexBufferPacked *vertexBuffer = m_textVao->getBaseVertexBuffer();
-			const Ogre::uint32 currVertexCount = (uint32_t)vertexBuffer->getNumElements();
-			if( requiredVertexCount > currVertexCount )
+		while( m_indirectBuffers.size() < numChunks )
+		{
+			m_indirectBuffers.push_back( m_vaoManager->createIndirectBuffer(
+				c_indirectDrawsPerChunk * sizeof( Ogre::CbDrawIndexed ),
+				Ogre::BT_DYNAMIC_PERSISTENT, 0, false ) );
+		}
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::destroyAllChunks()
+	{
+		if( !m_vaoManager )
+			return;
+
+		resizeVaos( 0u, 0u );
+		resizeRecordBuffers( m_glyphRecordBuffers, 0u, 0u );
+		resizeRecordBuffers( m_nineSliceRecordBuffers, 0u, 0u );
+		resizeIndirectBuffers( 0u );
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::checkVertexBufferCapacity()
+	{
+		COLIBRI_ASSERT_LOW( m_dirtyLabels.empty() && "updateDirtyLabels has not been called!" );
+		COLIBRI_ASSERT_LOW( m_dirtyLabelBmps.empty() && "updateDirtyLabels has not been called!" );
+
+		bool anyVaoChanged = false;
+
+		const size_t numNineSliceWidgets = m_numWidgets - m_numLabelsAndBmp;
+		//Each Label writes a LabelRecord before its glyphs
+		const size_t numTextRecords = m_numTextGlyphs + m_labels.size() * c_labelRecordSlots;
+		const size_t maxLabelRecords = m_maxLabelGlyphs + c_labelRecordSlots;
+		const size_t maxLabelBmpVertices = m_maxLabelBmpGlyphs * 6u;
+
+		//A Label (or LabelBmp) never crosses chunks, thus chunks must hold at least two of
+		//the biggest one, otherwise too much would be wasted at the end of each chunk
+		const size_t glyphRecordsPerChunk =
+			std::max<size_t>( c_glyphRecordsPerChunk, maxLabelRecords * 2u );
+		const size_t labelBmpVerticesPerChunk =
+			std::max<size_t>( c_labelBmpVerticesPerChunk, maxLabelBmpVertices * 2u );
+
+		//Every Renderable (windows included, all counted in m_numWidgets) goes through
+		//Renderable::_addCommands at most once per frame, whether depth or breadth first,
+		//and each call adds at most one indirect draw: Label breaks, record chunk changes
+		//and c_maxNineSliceWidgetsPerDraw only decide whether that draw is new or appended.
+		//
+		//CbDrawIndexed is the biggest of the two draws we emit. When the draw types are mixed,
+		//what's left at the end of a chunk may be too small for a CbDrawIndexed
+		const size_t requiredIndirectChunks =
+			calculateNumChunks( m_numWidgets, c_indirectDrawsPerChunk - 1u );
+		//Vertex buffer for LabelBmp. Regular widgets use m_nineSliceVao
+		const size_t requiredVaoChunks =
+			calculateNumChunks( m_numTextGlyphsBmp * 6u,
+								labelBmpVerticesPerChunk - maxLabelBmpVertices + 1u );
+		//One GlyphVertex per glyph, one NineSliceRecord per regular widget
+		const size_t requiredGlyphChunks = calculateNumChunks(
+			numTextRecords, glyphRecordsPerChunk - maxLabelRecords + 1u );
+		const size_t requiredNineSliceChunks =
+			calculateNumChunks( numNineSliceWidgets, c_nineSliceRecordsPerChunk );
+
+		//Only shrink once the buffers have stayed oversized for a while, so that UIs which
+		//briefly create and destroy lots of widgets (e.g. while switching screens) don't
+		//end up destroying and creating chunks back and forth every frame.
+		if( isBufferOversized( requiredIndirectChunks, m_indirectBuffers.size(), 1u ) ||
+			isBufferOversized( requiredVaoChunks, m_vaos.size(), 1u ) ||
+			isBufferOversized( requiredGlyphChunks, m_glyphRecordBuffers.size(), 1u ) ||
+			isBufferOversized( requiredNineSliceChunks, m_nineSliceRecordBuffers.size(), 1u ) )
+		{
+			++m_numFramesBuffersOversized;
+		}
+		else
+		{
+			m_numFramesBuffersOversized = 0u;
+		}
+
+		const bool bShrink = m_numFramesBuffersOversized >= c_framesBeforeBufferShrink;
+		if( bShrink )
+			m_numFramesBuffersOversized = 0u;
+
+		//Growing only appends chunks. Existing ones are kept as is
+		resizeIndirectBuffers(
+			bShrink ? requiredIndirectChunks
+					: std::max( requiredIndirectChunks, m_indirectBuffers.size() ) );
+		anyVaoChanged |= resizeVaos(
+			bShrink ? requiredVaoChunks : std::max( requiredVaoChunks, m_vaos.size() ),
+			labelBmpVerticesPerChunk );
+		resizeRecordBuffers(
+			m_glyphRecordBuffers,
+			bShrink ? requiredGlyphChunks
+					: std::max( requiredGlyphChunks, m_glyphRecordBuffers.size() ),
+			glyphRecordsPerChunk * sizeof( GlyphVertex ) );
+		resizeRecordBuffers(
+			m_nineSliceRecordBuffers,
+			bShrink ? requiredNineSliceChunks
+					: std::max( requiredNineSliceChunks, m_nineSliceRecordBuffers.size() ),
+			c_nineSliceRecordsPerChunk * sizeof( NineSliceRecord ) );
+
+		//The Vaos of regular widgets and text reference the index buffer,
+		//so they must be recreated if it changes. Destroy the old one afterwards.
+		//Neither of them grows with the number of widgets: every draw starts at the
+		//beginning of the Vao, and a single draw covers at most c_maxNineSliceWidgetsPerDraw
+		//9-slice widgets (9 quads each) or as many Labels as fit. The biggest Label
+		//(plus its LabelRecord) must fit in a single draw.
+		Ogre::IndexBufferPacked *oldQuadIndexBuffer = 0;
+		{
+			const Ogre::uint32 requiredQuads = static_cast<Ogre::uint32>( std::max<size_t>(
+				c_maxNineSliceWidgetsPerDraw * 9u, m_maxLabelGlyphs + c_labelRecordSlots ) );
+			const Ogre::uint32 currQuads =
+				static_cast<Ogre::uint32>( m_quadIndexBuffer->getNumElements() / 6u );
+			if( requiredQuads > currQuads )
 			{
-				const Ogre::uint32 newVertexCount = std::max( requiredVertexCount,
-															  currVertexCount +
-															  (currVertexCount >> 1u) );
-				Ogre::ColibriOgreRenderable::destroyVao( m_textVao, m_vaoManager );
-				m_textVao = Ogre::ColibriOgreRenderable::createTextVao( newVertexCount, m_vaoManager );
-				anyVaoChanged = true;
+				const Ogre::uint32 newQuads = std::max( requiredQuads, currQuads + (currQuads >> 1u) );
+				oldQuadIndexBuffer = m_quadIndexBuffer;
+				m_quadIndexBuffer =
+					Ogre::ColibriOgreRenderable::createQuadIndexBuffer( newQuads, m_vaoManager );
 			}
 		}
 
+		if( oldQuadIndexBuffer )
+		{
+			//Vertex buffer for regular widgets. It's never written to, we only need
+			//36 vertices per widget to draw. See ColibriOgreRenderable::createNineSliceVao
+			Ogre::ColibriOgreRenderable::destroyVao( m_nineSliceVao, m_vaoManager );
+			m_nineSliceVao = Ogre::ColibriOgreRenderable::createNineSliceVao(
+				c_maxNineSliceWidgetsPerDraw * ( 4u * 9u ), m_quadIndexBuffer, m_vaoManager );
+
+			//Vertex buffer for text. It's never written to, we only need 4 vertices
+			//per glyph to draw. See ColibriOgreRenderable::createTextVao
+			//It covers the whole index buffer so that consecutive Labels can share a draw
+			const Ogre::uint32 textVertexCount =
+				static_cast<Ogre::uint32>( ( m_quadIndexBuffer->getNumElements() / 6u ) * 4u );
+			Ogre::ColibriOgreRenderable::destroyVao( m_textVao, m_vaoManager );
+			m_textVao = Ogre::ColibriOgreRenderable::createTextVao( textVertexCount, m_quadIndexBuffer,
+																	m_vaoManager );
+			anyVaoChanged = true;
+		}
+
+		if( oldQuadIndexBuffer )
+			m_vaoManager->destroyIndexBuffer( oldQuadIndexBuffer );
+
 		if( anyVaoChanged )
 		{
 			WindowVec::const_iterator itor = m_windows.begin();
@@ -1120,7 +1553,7 @@ namespace Colibri
 
 			while( itor != end )
 			{
-				(*itor)->broadcastNewVao( m_vao, m_textVao );
+				(*itor)->broadcastNewVao( m_vaos.front(), m_textVao, m_nineSliceVao );
 				++itor;
 			}
 		}
@@ -1151,105 +1584,39 @@ namespace Colibri
 			++itor;
 		}
 
-		//Search for them again
+		//Search for them again. Only widgets that come after each widget are candidates
+		//(the ones before already had their chance, and setNextWidget reciprocates)
+		m_navigableWidgets.clear();
 		itor = container.begin() + start;
-
 		while( itor != end )
 		{
-			Widget *widget = *itor;
-
-			if( widget->isKeyboardNavigable() )
-			{
-				Widget *closestSiblings[Borders::NumBorders] = { 0, 0, 0, 0 };
-				float closestSiblingDistances[Borders::NumBorders] =
-				{
-					std::numeric_limits<float>::max(),
-					std::numeric_limits<float>::max(),
-					std::numeric_limits<float>::max(),
-					std::numeric_limits<float>::max()
-				};
-
-				typename std::vector<T>::const_iterator it2 = itor + 1u;
-				while( it2 != end )
-				{
-					Widget *widget2 = *it2;
+			if( ( *itor )->isKeyboardNavigable() )
+				m_navigableWidgets.push_back( *itor );
+			++itor;
+		}
 
-					if( widget2->isKeyboardNavigable() )
-					{
-						const Ogre::Vector2 cornerToCorner[4] =
-						{
-							widget2->m_position -
-							widget->m_position,
-
-							Ogre::Vector2( widget2->getRight(), widget2->m_position.y ) -
-							Ogre::Vector2( widget->getRight(), widget->m_position.y ),
-
-							Ogre::Vector2( widget2->m_position.x, widget2->getBottom() ) -
-							Ogre::Vector2( widget->m_position.x, widget->getBottom() ),
-
-							Ogre::Vector2( widget2->getRight(), widget2->getBottom() ) -
-							Ogre::Vector2( widget->getRight(), widget->getBottom() ),
-						};
-
-						for( size_t i=0; i<4u; ++i )
-						{
-							Ogre::Vector2 dirTo = cornerToCorner[i];
-
-							const float dirLength = dirTo.normalise();
-
-							const float cosAngle( dirTo.dotProduct( Ogre::Vector2::UNIT_X ) );
-
-							if( dirLength < closestSiblingDistances[Borders::Right] &&
-								cosAngle >= cosf( Ogre::Degree( 45.0f ).valueRadians() ) )
-							{
-								closestSiblings[Borders::Right] = widget2;
-								closestSiblingDistances[Borders::Right] = dirLength;
-							}
-
-							if( dirLength < closestSiblingDistances[Borders::Left] &&
-								cosAngle <= cosf( Ogre::Degree( 135.0f ).valueRadians() ) )
-							{
-								closestSiblings[Borders::Left] = widget2;
-								closestSiblingDistances[Borders::Left] = dirLength;
-							}
-
-							if( cosAngle <= cosf( Ogre::Degree( 45.0f ).valueRadians() ) &&
-								cosAngle >= cosf( Ogre::Degree( 135.0f ).valueRadians() ) )
-							{
-								float crossProduct = dirTo.crossProduct( Ogre::Vector2::UNIT_X );
-
-								if( crossProduct >= 0.0f )
-								{
-									if( dirLength < closestSiblingDistances[Borders::Top] )
-									{
-										closestSiblings[Borders::Top] = widget2;
-										closestSiblingDistances[Borders::Top] = dirLength;
-									}
-								}
-								else
-								{
-									if( dirLength < closestSiblingDistances[Borders::Bottom] )
-									{
-										closestSiblings[Borders::Bottom] = widget2;
-										closestSiblingDistances[Borders::Bottom] = dirLength;
-									}
-								}
-							}
-						}
-					}
+		m_navigationGrid.build( m_navigableWidgets );
 
-					++it2;
-				}
+		const size_t numNavigable = m_navigableWidgets.size();
+		for( size_t i = 0u; i < numNavigable; ++i )
+		{
+			Widget *widget = m_navigableWidgets[i];
 
-				for( size_t i=0; i<4u; ++i )
+			for( size_t j = 0u; j < 4u; ++j )
+			{
+				if( widget->m_autoSetNextWidget[j] && !widget->m_nextWidget[j] )
 				{
-					if( widget->m_autoSetNextWidget[i] && !widget->m_nextWidget[i] )
-						widget->setNextWidget( closestSiblings[i], static_cast<Borders::Borders>( i ) );
+					const uint32_t closestIdx = m_navigationGrid.findClosest(
+						static_cast<uint32_t>( i ), static_cast<Borders::Borders>( j ) );
+					Widget *closestSibling = closestIdx != NavigationGrid::c_invalidIdx
+												 ? m_navigableWidgets[closestIdx]
+												 : 0;
+					widget->setNextWidget( closestSibling, static_cast<Borders::Borders>( j ) );
 				}
 			}
-
-			++itor;
 		}
+
+		m_navigableWidgets.clear();
 	}
 	//-------------------------------------------------------------------------
 	void ColibriManager::autosetNavigation( Window *window )
@@ -1291,19 +1658,83 @@ namespace Colibri
 		m_numGlyphsBmpDirty = true;
 	}
 	//-------------------------------------------------------------------------
+	namespace
+	{
+		struct ShapeDirtyLabelsJob
+		{
+			const LabelVec *dirtyLabels;
+			std::atomic<size_t> nextLabel;
+		};
+	}  // namespace
+
+	/// Job for ColibriManager::updateDirtyLabelsThreaded, run by every shaping thread.
+	/// Threads grab labels in small batches until there are none left.
+	static void shapeDirtyLabelsWorker( size_t threadIdx, void *userData )
+	{
+		ShapeDirtyLabelsJob *job = static_cast<ShapeDirtyLabelsJob *>( userData );
+
+		const size_t c_labelsPerBatch = 8u;
+		const LabelVec &dirtyLabels = *job->dirtyLabels;
+		const size_t numLabels = dirtyLabels.size();
+
+		size_t idx = job->nextLabel.fetch_add( c_labelsPerBatch );
+		while( idx < numLabels )
+		{
+			const size_t endIdx = std::min( idx + c_labelsPerBatch, numLabels );
+			for( ; idx < endIdx; ++idx )
+				dirtyLabels[idx]->_shapeDirtyGlyphs( threadIdx );
+			idx = job->nextLabel.fetch_add( c_labelsPerBatch );
+		}
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::updateDirtyLabelsThreaded()
+	{
+		ShapeDirtyLabelsJob job;
+		job.dirtyLabels = &m_dirtyLabels;
+		job.nextLabel = 0u;
+
+		m_shaperManager->_setThreadedShaping( true );
+		m_shaperManager->runOnShapingThreads( shapeDirtyLabelsWorker, &job );
+		m_shaperManager->_setThreadedShaping( false );
+
+		// Placing glyphs may create widgets, which is not thread safe.
+		LabelVec::const_iterator itor = m_dirtyLabels.begin();
+		LabelVec::const_iterator endt = m_dirtyLabels.end();
+
+		while( itor != endt )
+		{
+			( *itor )->m_dirtyLabelsIdx = Widget::c_notInRegistry;
+			( *itor )->_placeDirtyGlyphs();
+			++itor;
+		}
+
+		// We didn't track whether the number of glyphs grew
+		_notifyNumGlyphsIsDirty();
+	}
+	//-------------------------------------------------------------------------
 	void ColibriManager::_updateDirtyLabels()
 	{
 		COLIBRI_ASSERT_MEDIUM( !m_fillBuffersStarted );
 		COLIBRI_ASSERT_MEDIUM( !m_renderingStarted );
 
 		{
-			LabelVec::const_iterator itor = m_dirtyLabels.begin();
-			LabelVec::const_iterator endt = m_dirtyLabels.end();
-
-			while( itor != endt )
+			const size_t numShapingThreads = m_shaperManager->getNumShapingThreads();
+			if( numShapingThreads > 1u && m_dirtyLabels.size() >= c_minDirtyLabelsForThreading )
 			{
-				( *itor )->_updateDirtyGlyphs();
-				++itor;
+				updateDirtyLabelsThreaded();
+			}
+			else
+			{
+				LabelVec::const_iterator itor = m_dirtyLabels.begin();
+				LabelVec::const_iterator endt = m_dirtyLabels.end();
+
+				while( itor != endt )
+				{
+					// Reset first, in case updating flags the label as dirty again
+					( *itor )->m_dirtyLabelsIdx = Widget::c_notInRegistry;
+					( *itor )->_updateDirtyGlyphs();
+					++itor;
+				}
 			}
 
 			m_dirtyLabels.clear();
@@ -1311,12 +1742,15 @@ namespace Colibri
 			if( m_numGlyphsDirty )
 			{
 				m_numTextGlyphs = 0;
-				itor = m_labels.begin();
-				endt = m_labels.end();
+				m_maxLabelGlyphs = 0;
+				LabelVec::const_iterator itor = m_labels.begin();
+				LabelVec::const_iterator endt = m_labels.end();
 
 				while( itor != endt )
 				{
-					m_numTextGlyphs += ( *itor )->getMaxNumGlyphs();
+					const size_t maxNumGlyphs = ( *itor )->getMaxNumGlyphs();
+					m_numTextGlyphs += maxNumGlyphs;
+					m_maxLabelGlyphs = std::max( m_maxLabelGlyphs, maxNumGlyphs );
 					++itor;
 				}
 
@@ -1330,6 +1764,7 @@ namespace Colibri
 
 			while( itor != endt )
 			{
+				( *itor )->m_dirtyLabelsIdx = Widget::c_notInRegistry;
 				( *itor )->_updateDirtyGlyphs();
 				++itor;
 			}
@@ -1339,12 +1774,15 @@ namespace Colibri
 			if( m_numGlyphsBmpDirty )
 			{
 				m_numTextGlyphsBmp = 0;
+				m_maxLabelBmpGlyphs = 0;
 				itor = m_labelsBmp.begin();
 				endt = m_labelsBmp.end();
 
 				while( itor != endt )
 				{
-					m_numTextGlyphsBmp += ( *itor )->getMaxNumGlyphs();
+					const size_t maxNumGlyphs = ( *itor )->getMaxNumGlyphs();
+					m_numTextGlyphsBmp += maxNumGlyphs;
+					m_maxLabelBmpGlyphs = std::max( m_maxLabelBmpGlyphs, maxNumGlyphs );
 					++itor;
 				}
 
@@ -1381,16 +1819,11 @@ namespace Colibri
 		m_zOrderHasDirtyChildren = false;
 	}
 	//-------------------------------------------------------------------------
-	bool compareZOrder( const Window* w1, const Window* w2 )
-	{
-		return w1->_getZOrderInternal() < w2->_getZOrderInternal();
-	}
-	//-------------------------------------------------------------------------
 	void ColibriManager::reorderWindowVec( bool windowInListDirty, WindowVec &windows )
 	{
 		if( windowInListDirty )
 		{
-			std::stable_sort( windows.begin(), windows.end(), compareZOrder );
+			Widget::_reorderByZOrder( windows );
 		}
 
 		WindowVec::iterator itor = windows.begin();
@@ -1416,6 +1849,11 @@ namespace Colibri
 		m_widgetTransformsDirty = true;
 	}
 	//-------------------------------------------------------------------------
+	void ColibriManager::_setTransformLayoutDirty()
+	{
+		m_transformStore.setLayoutDirty();
+	}
+	//-------------------------------------------------------------------------
 	void ColibriManager::_setZOrderWindowDirty( bool windowInListDirty )
 	{
 		m_zOrderWidgetDirty = true;
@@ -1424,10 +1862,15 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ColibriManager::_addDirtyLabel( Label *label )
 	{
-		m_dirtyLabels.push_back( label );
+		if( label->m_dirtyLabelsIdx == Widget::c_notInRegistry )
+			addToRegistry( m_dirtyLabels, label, &Widget::m_dirtyLabelsIdx );
 	}
 	//-------------------------------------------------------------------------
-	void ColibriManager::_addDirtyLabelBmp( LabelBmp *label ) { m_dirtyLabelBmps.push_back( label ); }
+	void ColibriManager::_addDirtyLabelBmp( LabelBmp *label )
+	{
+		if( label->m_dirtyLabelsIdx == Widget::c_notInRegistry )
+			addToRegistry( m_dirtyLabelBmps, label, &Widget::m_dirtyLabelsIdx );
+	}
 	//-------------------------------------------------------------------------
 	void ColibriManager::scrollToWidget( Widget *widget )
 	{
@@ -1582,6 +2025,7 @@ namespace Colibri
 
 			while( itor != endt )
 			{
+				( *itor )->m_dirtyWidgetsIdx = Widget::c_notInRegistry;
 				( *itor )->setTransformDirty( Widget::TransformDirtyAll );
 				++itor;
 			}
@@ -1589,6 +2033,8 @@ namespace Colibri
 			m_dirtyWidgets.clear();
 		}
 
+		propagateTransformDirty();
+
 		if( cursorFocusDirty )
 		{
 			//Scroll changed, cursor may now be highlighting a different widget
@@ -1609,44 +2055,209 @@ namespace Colibri
 		}
 	}
 	//-------------------------------------------------------------------------
+	void ColibriManager::mapFirstChunks()
+	{
+		Ogre::VertexBufferPacked *vertexBuffer = m_vaos.front()->getBaseVertexBuffer();
+		Ogre::BufferPacked *glyphRecordBuffer = m_glyphRecordBuffers.front();
+		Ogre::BufferPacked *nineSliceRecordBuffer = m_nineSliceRecordBuffers.front();
+
+		m_vertexBufferBase = reinterpret_cast<UiVertex *>(
+			vertexBuffer->map( 0, vertexBuffer->getNumElements() ) );
+		m_vertexBufferEnd = reinterpret_cast<UiVertex *>(
+			reinterpret_cast<uint8_t *>( m_vertexBufferBase ) +
+			vertexBuffer->getNumElements() * getVertexSize() );
+		m_textVertexBufferBase = reinterpret_cast<GlyphVertex *>(
+			glyphRecordBuffer->map( 0, glyphRecordBuffer->getNumElements() ) );
+		m_textVertexBufferEnd =
+			m_textVertexBufferBase + glyphRecordBuffer->getTotalSizeBytes() / sizeof( GlyphVertex );
+		m_nineSliceRecordBufferBase = reinterpret_cast<NineSliceRecord *>(
+			nineSliceRecordBuffer->map( 0, nineSliceRecordBuffer->getNumElements() ) );
+		m_nineSliceRecordBufferEnd =
+			m_nineSliceRecordBufferBase +
+			nineSliceRecordBuffer->getTotalSizeBytes() / sizeof( NineSliceRecord );
+
+		m_currVertexChunk = 0u;
+		m_currGlyphRecordChunk = 0u;
+		m_currNineSliceRecordChunk = 0u;
+	}
+	//-------------------------------------------------------------------------
+	UiVertex *ColibriManager::_reserveVertices( UiVertex *vertexBuffer, size_t numVertices,
+												uint32_t &outChunk )
+	{
+		COLIBRI_ASSERT_HIGH( m_fillBuffersStarted );
+
+		const size_t vertexSize = getVertexSize();
+		uint8_t *vertexBufferBytes = reinterpret_cast<uint8_t *>( vertexBuffer );
+		if( vertexBufferBytes + numVertices * vertexSize >
+			reinterpret_cast<uint8_t *>( m_vertexBufferEnd ) )
+		{
+			const size_t elementsWritten =
+				size_t( vertexBufferBytes - reinterpret_cast<uint8_t *>( m_vertexBufferBase ) ) /
+				vertexSize;
+			m_vaos[m_currVertexChunk]->getBaseVertexBuffer()->unmap( Ogre::UO_KEEP_PERSISTENT, 0u,
+																	 elementsWritten );
+
+			++m_currVertexChunk;
+			COLIBRI_ASSERT_LOW( m_currVertexChunk < m_vaos.size() &&
+								"checkVertexBufferCapacity did not reserve enough chunks!" );
+
+			Ogre::VertexBufferPacked *nextBuffer = m_vaos[m_currVertexChunk]->getBaseVertexBuffer();
+			m_vertexBufferBase = reinterpret_cast<UiVertex *>(
+				nextBuffer->map( 0, nextBuffer->getNumElements() ) );
+			m_vertexBufferEnd =
+				reinterpret_cast<UiVertex *>( reinterpret_cast<uint8_t *>( m_vertexBufferBase ) +
+											  nextBuffer->getNumElements() * vertexSize );
+			vertexBuffer = m_vertexBufferBase;
+		}
+
+		outChunk = m_currVertexChunk;
+		return vertexBuffer;
+	}
+	//-------------------------------------------------------------------------
+	GlyphVertex *ColibriManager::_reserveGlyphRecords( GlyphVertex *textVertBuffer,
+													   size_t numRecords, uint32_t &outChunk )
+	{
+		COLIBRI_ASSERT_HIGH( m_fillBuffersStarted );
+
+		if( textVertBuffer + numRecords > m_textVertexBufferEnd )
+		{
+			const size_t bytesWritten =
+				size_t( textVertBuffer - m_textVertexBufferBase ) * sizeof( GlyphVertex );
+			m_glyphRecordBuffers[m_currGlyphRecordChunk]->unmap( Ogre::UO_KEEP_PERSISTENT, 0u,
+																 bytesWritten );
+
+			++m_currGlyphRecordChunk;
+			COLIBRI_ASSERT_LOW( m_currGlyphRecordChunk < m_glyphRecordBuffers.size() &&
+								"checkVertexBufferCapacity did not reserve enough chunks!" );
+
+			Ogre::BufferPacked *nextBuffer = m_glyphRecordBuffers[m_currGlyphRecordChunk];
+			m_textVertexBufferBase = reinterpret_cast<GlyphVertex *>(
+				nextBuffer->map( 0, nextBuffer->getNumElements() ) );
+			m_textVertexBufferEnd =
+				m_textVertexBufferBase + nextBuffer->getTotalSizeBytes() / sizeof( GlyphVertex );
+			textVertBuffer = m_textVertexBufferBase;
+		}
+
+		outChunk = m_currGlyphRecordChunk;
+		return textVertBuffer;
+	}
+	//-------------------------------------------------------------------------
+	NineSliceRecord *ColibriManager::_reserveNineSliceRecords( NineSliceRecord *nineSliceBuffer,
+															   size_t numRecords,
+															   uint32_t &outChunk )
+	{
+		COLIBRI_ASSERT_HIGH( m_fillBuffersStarted );
+
+		if( nineSliceBuffer + numRecords > m_nineSliceRecordBufferEnd )
+		{
+			const size_t bytesWritten =
+				size_t( nineSliceBuffer - m_nineSliceRecordBufferBase ) * sizeof( NineSliceRecord );
+			m_nineSliceRecordBuffers[m_currNineSliceRecordChunk]->unmap( Ogre::UO_KEEP_PERSISTENT,
+																		 0u, bytesWritten );
+
+			++m_currNineSliceRecordChunk;
+			COLIBRI_ASSERT_LOW( m_currNineSliceRecordChunk < m_nineSliceRecordBuffers.size() &&
+								"checkVertexBufferCapacity did not reserve enough chunks!" );
+
+			Ogre::BufferPacked *nextBuffer = m_nineSliceRecordBuffers[m_currNineSliceRecordChunk];
+			m_nineSliceRecordBufferBase = reinterpret_cast<NineSliceRecord *>(
+				nextBuffer->map( 0, nextBuffer->getNumElements() ) );
+			m_nineSliceRecordBufferEnd =
+				m_nineSliceRecordBufferBase +
+				nextBuffer->getTotalSizeBytes() / sizeof( NineSliceRecord );
+			nineSliceBuffer = m_nineSliceRecordBufferBase;
+		}
+
+		outChunk = m_currNineSliceRecordChunk;
+		return nineSliceBuffer;
+	}
+	//-------------------------------------------------------------------------
+	void ColibriManager::_mapNextIndirectBuffer( ApiEncapsulatedObjects &apiObject )
+	{
+		COLIBRI_ASSERT_HIGH( m_renderingStarted );
+
+		if( m_vaoManager->supportsIndirectBuffers() )
+			m_indirectBuffers[m_currIndirectBuffer]->unmap( Ogre::UO_KEEP_PERSISTENT );
+
+		++m_currIndirectBuffer;
+		COLIBRI_ASSERT_MEDIUM( m_currIndirectBuffer < m_indirectBuffers.size() &&
+							   "checkVertexBufferCapacity did not reserve enough chunks!" );
+		//Should never happen (see the bound in checkVertexBufferCapacity). But if a future
+		//draw-break rule emits more than one draw per widget, grow instead of writing past
+		//the end. checkVertexBufferCapacity shrinks it back if it wasn't needed
+		if( m_currIndirectBuffer >= m_indirectBuffers.size() )
+			resizeIndirectBuffers( m_currIndirectBuffer + 1u );
+
+		Ogre::IndirectBufferPacked *indirectBuffer = m_indirectBuffers[m_currIndirectBuffer];
+		apiObject.indirectBuffer = indirectBuffer;
+		if( m_vaoManager->supportsIndirectBuffers() )
+		{
+			apiObject.indirectDraw = reinterpret_cast<uint8_t *>(
+				indirectBuffer->map( 0, indirectBuffer->getNumElements() ) );
+		}
+		else
+		{
+			apiObject.indirectDraw = reinterpret_cast<uint8_t *>( indirectBuffer->getSwBufferPtr() );
+		}
+		apiObject.startIndirectDraw = apiObject.indirectDraw;
+		apiObject.endIndirectDraw = apiObject.indirectDraw + indirectBuffer->getTotalSizeBytes();
+		//The last draw of the previous chunk can no longer be taken back
+		apiObject.drawCountPtr = 0;
+	}
+	//-------------------------------------------------------------------------
 	void ColibriManager::prepareRenderCommands()
 	{
 #if COLIBRIGUI_DEBUG_MEDIUM
 		m_fillBuffersStarted = true;
 #endif
 
-		Ogre::VertexBufferPacked *vertexBuffer = m_vao->getBaseVertexBuffer();
-		Ogre::VertexBufferPacked *vertexBufferText = m_textVao->getBaseVertexBuffer();
+		mapFirstChunks();
 
-		UiVertex *vertex = reinterpret_cast<UiVertex*>(
-							   vertexBuffer->map( 0, vertexBuffer->getNumElements() ) );
-		UiVertex *startOffset = vertex;
-		m_vertexBufferBase = startOffset;
+		UiVertex *vertex = m_vertexBufferBase;
+		GlyphVertex *vertexText = m_textVertexBufferBase;
+		NineSliceRecord *nineSlice = m_nineSliceRecordBufferBase;
 
-		GlyphVertex *vertexText = reinterpret_cast<GlyphVertex*>(
-									  vertexBufferText->map( 0, vertexBufferText->getNumElements() ) );
-		GlyphVertex *startOffsetText = vertexText;
-		m_textVertexBufferBase = startOffsetText;
+		// Scrolling & some resizes (e.g. Label::sizeToFit) don't flag transforms as dirty,
+		// thus always bring them up to date. _fillBuffersAndCommands relies on them
+		propagateTransformDirty();
+		m_transformStore.update( m_windows, getInvCanvasSize2x(), getCanvasInvAspectRatio() );
+		m_widgetTransformsDirty = false;
 
 		WindowVec::const_iterator itor = m_windows.begin();
 		WindowVec::const_iterator end  = m_windows.end();
 
 		while( itor != end )
 		{
-			( *itor )->_fillBuffersAndCommands( &vertex, &vertexText, -Ogre::Vector2::UNIT_SCALE,
-												Ogre::Vector2::ZERO, Matrix2x3::IDENTITY );
+			( *itor )->_fillBuffersAndCommands( &vertex, &vertexText, &nineSlice,
+												-Ogre::Vector2::UNIT_SCALE, Ogre::Vector2::ZERO,
+												Matrix2x3::IDENTITY );
 			++itor;
 		}
 
-		const size_t elementsWritten = size_t( vertex - startOffset );
-		const size_t elementsWrittenText = size_t( vertexText - startOffsetText );
-		COLIBRI_ASSERT( elementsWritten <= vertexBuffer->getNumElements() );
-		COLIBRI_ASSERT( elementsWrittenText <= vertexBufferText->getNumElements() );
-		vertexBuffer->unmap( Ogre::UO_KEEP_PERSISTENT, 0u, elementsWritten );
-		vertexBufferText->unmap( Ogre::UO_KEEP_PERSISTENT, 0u, elementsWrittenText );
+		//Unmap the chunks we were writing to when we finished. Previous ones already were
+		const size_t elementsWritten = size_t( reinterpret_cast<uint8_t *>( vertex ) -
+											   reinterpret_cast<uint8_t *>( m_vertexBufferBase ) ) /
+									   getVertexSize();
+		const size_t bytesWrittenText =
+			size_t( vertexText - m_textVertexBufferBase ) * sizeof( GlyphVertex );
+		const size_t bytesWrittenNineSlice =
+			size_t( nineSlice - m_nineSliceRecordBufferBase ) * sizeof( NineSliceRecord );
+		COLIBRI_ASSERT( vertex <= m_vertexBufferEnd );
+		COLIBRI_ASSERT( vertexText <= m_textVertexBufferEnd );
+		COLIBRI_ASSERT( nineSlice <= m_nineSliceRecordBufferEnd );
+		m_vaos[m_currVertexChunk]->getBaseVertexBuffer()->unmap( Ogre::UO_KEEP_PERSISTENT, 0u,
+																 elementsWritten );
+		m_glyphRecordBuffers[m_currGlyphRecordChunk]->unmap( Ogre::UO_KEEP_PERSISTENT, 0u,
+															 bytesWrittenText );
+		m_nineSliceRecordBuffers[m_currNineSliceRecordChunk]->unmap( Ogre::UO_KEEP_PERSISTENT, 0u,
+																	 bytesWrittenNineSlice );
 
 		m_vertexBufferBase = 0;
+		m_vertexBufferEnd = 0;
 		m_textVertexBufferBase = 0;
+		m_textVertexBufferEnd = 0;
+		m_nineSliceRecordBufferBase = 0;
+		m_nineSliceRecordBufferEnd = 0;
 
 #if COLIBRIGUI_DEBUG_MEDIUM
 		m_fillBuffersStarted = false;
@@ -1669,6 +2280,8 @@ namespace Colibri
 		// Ideally ShapeManagers should be shared between ColibriManagers for maximum
 		// efficiency. But if they're not, we not to bind our own atlas with our glyphs
 		m_shaperManager->prepareToRender();
+		hlmsColibri->setGlyphRecordBuffer( m_glyphRecordBuffers.front() );
+		hlmsColibri->setNineSliceRecordBuffer( m_nineSliceRecordBuffers.front() );
 
 		apiObjects.lastHlmsCache = &c_dummyCache;
 
@@ -1677,18 +2290,20 @@ namespace Colibri
 		apiObjects.hlms = hlmsColibri;
 		apiObjects.lastVaoName = 0;
 		apiObjects.commandBuffer = m_commandBuffer;
-		apiObjects.indirectBuffer = m_indirectBuffer;
+		m_currIndirectBuffer = 0u;
+		Ogre::IndirectBufferPacked *indirectBuffer = m_indirectBuffers.front();
+		apiObjects.indirectBuffer = indirectBuffer;
 		if( m_vaoManager->supportsIndirectBuffers() )
 		{
 			apiObjects.indirectDraw = reinterpret_cast<uint8_t*>(
-										  m_indirectBuffer->map( 0,
-																 m_indirectBuffer->getNumElements() ) );
+										  indirectBuffer->map( 0, indirectBuffer->getNumElements() ) );
 		}
 		else
 		{
-			apiObjects.indirectDraw = reinterpret_cast<uint8_t*>( m_indirectBuffer->getSwBufferPtr() );
+			apiObjects.indirectDraw = reinterpret_cast<uint8_t*>( indirectBuffer->getSwBufferPtr() );
 		}
 		apiObjects.startIndirectDraw = apiObjects.indirectDraw;
+		apiObjects.endIndirectDraw = apiObjects.indirectDraw + indirectBuffer->getTotalSizeBytes();
 		apiObjects.lastDatablock = 0;
 		apiObjects.baseInstanceAndIndirectBuffers = 0;
 		if( m_vaoManager->supportsIndirectBuffers() )
@@ -1697,10 +2312,15 @@ namespace Colibri
 			apiObjects.baseInstanceAndIndirectBuffers = 1;
 		apiObjects.drawCmd = 0;
 		apiObjects.drawCountPtr = 0;
+		apiObjects.lastDrawSize = 0;
+		apiObjects.quadIndexBufferStart = (uint32_t)m_quadIndexBuffer->_getFinalBufferStart();
 		apiObjects.primCount = 0;
-		apiObjects.basePrimCount[0] = (uint32_t)m_vao->getBaseVertexBuffer()->_getFinalBufferStart();
+		apiObjects.basePrimCount[0] =
+			(uint32_t)m_nineSliceVao->getBaseVertexBuffer()->_getFinalBufferStart();
 		apiObjects.basePrimCount[1] = (uint32_t)m_textVao->getBaseVertexBuffer()->_getFinalBufferStart();
 		apiObjects.nextFirstVertex = 0;
+		apiObjects.nextRecordStart = 0;
+		apiObjects.nextRecordChunk = 0;
 
 		m_breadthFirst[0].clear();
 		m_breadthFirst[1].clear();
@@ -1716,18 +2336,10 @@ namespace Colibri
 			++itor;
 		}
 
-		if( apiObjects.drawCountPtr && apiObjects.drawCountPtr->primCount == 0u )
-		{
-			// Adreno 618 will GPU crash if we send an indirect cmd with vertex_count = 0
-			--apiObjects.drawCmd->numDraws;
-			// Since we only emit CbDrawStrip we can assume the previous cmd
-			// issued a CbDrawStrip, so take it back. Otherwise we'd have to
-			// save what our last cmd was.
-			apiObjects.indirectDraw -= sizeof( Ogre::CbDrawStrip );
-		}
+		Renderable::_removeEmptyDraw( apiObjects );
 
 		if( m_vaoManager->supportsIndirectBuffers() )
-			m_indirectBuffer->unmap( Ogre::UO_KEEP_PERSISTENT );
+			m_indirectBuffers[m_currIndirectBuffer]->unmap( Ogre::UO_KEEP_PERSISTENT );
 
 		hlms->preCommandBufferExecution( m_commandBuffer );
 		m_commandBuffer->execute();
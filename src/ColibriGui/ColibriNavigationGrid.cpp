@@ -0,0 +1,354 @@
+
+#include "ColibriGui/ColibriNavigationGrid.h"
+
+#include "ColibriGui/ColibriWidget.h"
+
+#include "OgreMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Colibri
+{
+	const uint32_t NavigationGrid::c_maxCellsPerAxis = 256u;
+	const uint32_t NavigationGrid::c_invalidIdx = 0xFFFFFFFFu;
+
+	namespace
+	{
+		/// Returns true if the cell at the given offset (in cells) from the query point may
+		/// contain points in the direction's cone. Points are in the cone of Right when the
+		/// angle is within [-45°; 45°] i.e. when dx >= |dy|. 3 cells of slack make up for
+		/// the points and the query being anywhere inside their cells, and for rounding
+		inline bool isInCone( int32_t offX, int32_t offY, Borders::Borders direction )
+		{
+			switch( direction )
+			{
+			case Borders::Top:
+				return -offY + 3 >= std::abs( offX );
+			case Borders::Left:
+				return -offX + 3 >= std::abs( offY );
+			case Borders::Right:
+				return offX + 3 >= std::abs( offY );
+			case Borders::Bottom:
+			case Borders::NumBorders:
+				return offY + 3 >= std::abs( offX );
+			}
+			return true;
+		}
+
+		struct ClosestQuery
+		{
+			const Ogre::Vector2 *corners;
+			uint32_t             corner;
+			uint32_t             widgetIdx;
+			Borders::Borders     direction;
+			Ogre::Vector2        origin;
+			float                cos45;
+			float                cos135;
+
+			float    closestDistance;
+			uint32_t closestIdx;
+
+			/// Same criteria as the brute force autosetNavigation, except that on equal
+			/// distances the candidate that comes first wins (the brute force version sees
+			/// the candidates in order, and only replaces when strictly closer)
+			void test( const uint32_t *itor, const uint32_t *end )
+			{
+				while( itor != end )
+				{
+					const uint32_t candidateIdx = *itor++;
+
+					if( candidateIdx <= widgetIdx )
+						continue;
+
+					Ogre::Vector2 dirTo = corners[candidateIdx * 4u + corner] - origin;
+
+					const float dirLength = dirTo.normalise();
+
+					if( !( dirLength < closestDistance ||
+						   ( dirLength == closestDistance && candidateIdx < closestIdx ) ) )
+					{
+						continue;
+					}
+
+					const float cosAngle( dirTo.dotProduct( Ogre::Vector2::UNIT_X ) );
+
+					bool bMatches;
+					switch( direction )
+					{
+					case Borders::Right:
+						bMatches = cosAngle >= cos45;
+						break;
+					case Borders::Left:
+						bMatches = cosAngle <= cos135;
+						break;
+					case Borders::Top:
+					case Borders::Bottom:
+					case Borders::NumBorders:
+					default:
+						bMatches = cosAngle <= cos45 && cosAngle >= cos135;
+						if( bMatches )
+						{
+							const float crossProduct = dirTo.crossProduct( Ogre::Vector2::UNIT_X );
+							bMatches = ( crossProduct >= 0.0f ) == ( direction == Borders::Top );
+						}
+						break;
+					}
+
+					if( bMatches )
+					{
+						closestDistance = dirLength;
+						closestIdx = candidateIdx;
+					}
+				}
+			}
+		};
+	}  // namespace
+	//-------------------------------------------------------------------------
+	NavigationGrid::NavigationGrid() :
+		m_origin( Ogre::Vector2::ZERO ),
+		m_cellSize( std::numeric_limits<float>::max() ),
+		m_invCellSize( 0.0f ),
+		m_numCellsX( 1u ),
+		m_numCellsY( 1u )
+	{
+	}
+	//-------------------------------------------------------------------------
+	inline uint32_t NavigationGrid::toCell( float value, uint32_t numCells ) const
+	{
+		// Written so that NaNs end up in cell 0
+		if( !( value > 0.0f ) )
+			return 0u;
+		if( value >= static_cast<float>( numCells ) )
+			return numCells - 1u;
+		return static_cast<uint32_t>( value );
+	}
+	//-------------------------------------------------------------------------
+	inline void NavigationGrid::getCell( const Ogre::Vector2 &pos, uint32_t &outX,
+										 uint32_t &outY ) const
+	{
+		const Ogre::Vector2 cellPos = ( pos - m_origin ) * m_invCellSize;
+		outX = toCell( cellPos.x, m_numCellsX );
+		outY = toCell( cellPos.y, m_numCellsY );
+	}
+	//-------------------------------------------------------------------------
+	void NavigationGrid::build( const WidgetVec &widgets )
+	{
+		const size_t numWidgets = widgets.size();
+
+		m_corners.resize( numWidgets * 4u );
+
+		Ogre::Vector2 minPos( std::numeric_limits<float>::max() );
+		Ogre::Vector2 maxPos( -std::numeric_limits<float>::max() );
+
+		for( size_t i = 0u; i < numWidgets; ++i )
+		{
+			const Widget *widget = widgets[i];
+			const Ogre::Vector2 &position = widget->getLocalTopLeft();
+			Ogre::Vector2 *corners = &m_corners[i * 4u];
+			corners[0] = position;
+			corners[1] = Ogre::Vector2( widget->getRight(), position.y );
+			corners[2] = Ogre::Vector2( position.x, widget->getBottom() );
+			corners[3] = Ogre::Vector2( widget->getRight(), widget->getBottom() );
+
+			for( size_t j = 0u; j < 4u; ++j )
+			{
+				minPos.makeFloor( corners[j] );
+				maxPos.makeCeil( corners[j] );
+			}
+		}
+
+		// A single cell with everything works with NaNs and infinities (it's just slow)
+		m_origin = Ogre::Vector2::ZERO;
+		m_cellSize = std::numeric_limits<float>::max();
+		m_invCellSize = 0.0f;
+		m_numCellsX = 1u;
+		m_numCellsY = 1u;
+
+		const Ogre::Vector2 padding = ( maxPos - minPos ) * 1e-4f + Ogre::Vector2( 1e-3f );
+		const Ogre::Vector2 extent = maxPos - minPos + 2.0f * padding;
+
+		if( numWidgets && extent.x > 0.0f && extent.y > 0.0f &&
+			extent.x < std::numeric_limits<float>::max() &&
+			extent.y < std::numeric_limits<float>::max() )
+		{
+			// Square cells, about one widget per cell
+			float cellSize = std::sqrt( extent.x / static_cast<float>( numWidgets ) ) *
+							 std::sqrt( extent.y );
+			cellSize = std::max( cellSize, extent.x / static_cast<float>( c_maxCellsPerAxis ) );
+			cellSize = std::max( cellSize, extent.y / static_cast<float>( c_maxCellsPerAxis ) );
+
+			m_numCellsX = static_cast<uint32_t>( std::min(
+				std::max( std::ceil( extent.x / cellSize ), 1.0f ),
+				static_cast<float>( c_maxCellsPerAxis ) ) );
+			m_numCellsY = static_cast<uint32_t>( std::min(
+				std::max( std::ceil( extent.y / cellSize ), 1.0f ),
+				static_cast<float>( c_maxCellsPerAxis ) ) );
+
+			m_origin = minPos - padding;
+			m_cellSize = std::max( extent.x / static_cast<float>( m_numCellsX ),
+								   extent.y / static_cast<float>( m_numCellsY ) );
+			m_invCellSize = 1.0f / m_cellSize;
+		}
+
+		const uint32_t numCells = m_numCellsX * m_numCellsY;
+
+		// Counting sort. Widgets are visited in order, thus each cell ends up sorted
+		for( uint32_t corner = 0u; corner < 4u; ++corner )
+		{
+			std::vector<uint32_t> &cellStart = m_cellStart[corner];
+			std::vector<uint32_t> &cellEntries = m_cellEntries[corner];
+
+			cellStart.clear();
+			cellStart.resize( numCells + 1u, 0u );
+			cellEntries.resize( numWidgets );
+
+			for( size_t i = 0u; i < numWidgets; ++i )
+			{
+				uint32_t x, y;
+				getCell( m_corners[i * 4u + corner], x, y );
+				++cellStart[y * m_numCellsX + x + 1u];
+			}
+
+			for( uint32_t i = 0u; i < numCells; ++i )
+				cellStart[i + 1u] += cellStart[i];
+
+			for( size_t i = 0u; i < numWidgets; ++i )
+			{
+				uint32_t x, y;
+				getCell( m_corners[i * 4u + corner], x, y );
+				// cellStart[cellIdx] is used as a cursor, and is restored below
+				cellEntries[cellStart[y * m_numCellsX + x]++] = static_cast<uint32_t>( i );
+			}
+
+			for( uint32_t i = numCells; i > 0u; --i )
+				cellStart[i] = cellStart[i - 1u];
+			cellStart[0] = 0u;
+		}
+
+		// Walk backwards accumulating the cells of the widgets that come after each one
+		m_remainingCells.resize( numWidgets * 4u );
+		for( uint32_t corner = 0u; corner < 4u; ++corner )
+		{
+			CellRange range;
+			range.minX = static_cast<uint16_t>( m_numCellsX );
+			range.minY = static_cast<uint16_t>( m_numCellsY );
+			range.maxX = 0u;
+			range.maxY = 0u;
+
+			for( size_t i = numWidgets; i--; )
+			{
+				m_remainingCells[i * 4u + corner] = range;
+
+				uint32_t x, y;
+				getCell( m_corners[i * 4u + corner], x, y );
+				range.minX = std::min( range.minX, static_cast<uint16_t>( x ) );
+				range.minY = std::min( range.minY, static_cast<uint16_t>( y ) );
+				range.maxX = std::max( range.maxX, static_cast<uint16_t>( x ) );
+				range.maxY = std::max( range.maxY, static_cast<uint16_t>( y ) );
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	uint32_t NavigationGrid::findClosest( uint32_t widgetIdx, Borders::Borders direction ) const
+	{
+		ClosestQuery query;
+		query.corners = m_corners.data();
+		query.widgetIdx = widgetIdx;
+		query.direction = direction;
+		query.cos45 = cosf( Ogre::Degree( 45.0f ).valueRadians() );
+		query.cos135 = cosf( Ogre::Degree( 135.0f ).valueRadians() );
+		query.closestDistance = std::numeric_limits<float>::max();
+		query.closestIdx = c_invalidIdx;
+
+		const int32_t numCellsX = static_cast<int32_t>( m_numCellsX );
+
+		for( uint32_t corner = 0u; corner < 4u; ++corner )
+		{
+			const CellRange &range = m_remainingCells[widgetIdx * 4u + corner];
+			if( range.minX > range.maxX )
+				break;  // We're the last widget
+
+			const uint32_t *cellStart = m_cellStart[corner].data();
+			const uint32_t *cellEntries = m_cellEntries[corner].data();
+
+			query.corner = corner;
+			query.origin = m_corners[widgetIdx * 4u + corner];
+
+			uint32_t uCellX, uCellY;
+			getCell( query.origin, uCellX, uCellY );
+			const int32_t cellX = static_cast<int32_t>( uCellX );
+			const int32_t cellY = static_cast<int32_t>( uCellY );
+
+			const int32_t rangeMinX = range.minX;
+			const int32_t rangeMinY = range.minY;
+			const int32_t rangeMaxX = range.maxX;
+			const int32_t rangeMaxY = range.maxY;
+
+			// Past this ring, no cell with candidates intersects the cone. See isInCone
+			int32_t maxRing;
+			switch( direction )
+			{
+			case Borders::Top:
+				maxRing = cellY - rangeMinY;
+				break;
+			case Borders::Left:
+				maxRing = cellX - rangeMinX;
+				break;
+			case Borders::Right:
+				maxRing = rangeMaxX - cellX;
+				break;
+			case Borders::Bottom:
+			case Borders::NumBorders:
+			default:
+				maxRing = rangeMaxY - cellY;
+				break;
+			}
+			maxRing = std::max( maxRing, 0 ) + 3;
+
+			for( int32_t ring = 0; ring <= maxRing; ++ring )
+			{
+				// Everything in this ring is at least ( ring - 1 ) cells away. One more
+				// cell of slack for rounding. Equal distances must still be visited
+				if( ring >= 2 && static_cast<float>( ring - 2 ) * m_cellSize > query.closestDistance )
+					break;
+
+				const int32_t minY = std::max( cellY - ring, rangeMinY );
+				const int32_t maxY = std::min( cellY + ring, rangeMaxY );
+
+				for( int32_t y = minY; y <= maxY; ++y )
+				{
+					const int32_t offY = y - cellY;
+
+					// The top & bottom rows of the ring are full. Otherwise only the
+					// cells at both ends of the row belong to this ring
+					int32_t minX = cellX - ring;
+					int32_t maxX = cellX + ring;
+					int32_t step = 2 * ring;
+					if( std::abs( offY ) == ring )
+					{
+						minX = std::max( minX, rangeMinX );
+						maxX = std::min( maxX, rangeMaxX );
+						step = 1;
+					}
+
+					for( int32_t x = minX; x <= maxX; x += step )
+					{
+						if( x < rangeMinX || x > rangeMaxX ||
+							!isInCone( x - cellX, offY, direction ) )
+						{
+							continue;
+						}
+
+						const uint32_t cellIdx = static_cast<uint32_t>( y * numCellsX + x );
+						query.test( cellEntries + cellStart[cellIdx],
+									cellEntries + cellStart[cellIdx + 1u] );
+					}
+				}
+			}
+		}
+
+		return query.closestIdx;
+	}
+}  // namespace Colibri
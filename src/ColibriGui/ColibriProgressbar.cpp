@@ -8,7 +8,6 @@
 #include "OgreHlmsManager.h"
 #include "OgreHlmsSamplerblock.h"
 #include "OgreHlmsUnlitDatablock.h"
-#include "OgreLwString.h"
 
 namespace Colibri
 {
@@ -21,11 +20,9 @@ namespace Colibri
 		m_animSpeed( 0.0f ),
 		m_animLength( 1.0f ),
 		m_accumTime( 0.0f ),
-		m_displayType( BehindGlass ),
-		m_skinCopy( 0 )
+		m_displayType( BehindGlass )
 	{
 		memset( m_layers, 0, sizeof( m_layers ) );
-		memset( m_progressLayerDatablock, 0, sizeof( m_progressLayerDatablock ) );
 	}
 	//-------------------------------------------------------------------------
 	void Progressbar::_initialize()
@@ -57,7 +54,7 @@ namespace Colibri
 		}
 
 		{
-			// Clone the progress layer's skin and assign that clone
+			// Assign the progress layer's skin
 			const SkinWidgetTypes::SkinWidgetTypes skinWidgetTypeProgress =
 				m_displayType == Basic ? SkinWidgetTypes::ProgressbarLayer1
 									   : SkinWidgetTypes::ProgressbarLayer0;
@@ -65,10 +62,8 @@ namespace Colibri
 			SkinInfo const *const *skinInfo = m_manager->getDefaultSkin(
 				static_cast<SkinWidgetTypes::SkinWidgetTypes>( skinWidgetTypeProgress ) );
 
-			COLIBRI_ASSERT_LOW( !m_progressLayerDatablock[0] && "_initialize already called!" );
-
 			SkinInfo const *colibri_nonnull newSkinInfos[States::NumStates];
-			cloneSkinAndDatablock( skinInfo, newSkinInfos, defaultSkinPack->progressBarIsAnimated );
+			setupProgressSkins( skinInfo, newSkinInfos, defaultSkinPack->progressBarIsAnimated );
 
 			Renderable *progressLayer = getProgressLayer();
 			progressLayer->_setSkinPack( newSkinInfos );
@@ -92,8 +87,6 @@ namespace Colibri
 		// m_layers[i] are children of us, so they will be destroyed by our super class
 		for( size_t i = 0u; i < 2u; ++i )
 			m_layers[i] = 0;
-
-		destroyClonedData();
 	}
 	//-------------------------------------------------------------------------
 	Renderable *colibri_nullable Progressbar::getFrameLayer()
@@ -154,12 +147,12 @@ namespace Colibri
 		}
 
 		{
-			// Clone the progress layer's skin and assign that clone
+			// Assign the progress layer's skin
 			Ogre::IdString skinPackProgressName =
 				m_displayType == Basic ? skinPackLayer1Name : skinPackLayer0Name;
 
 			SkinInfo const *colibri_nonnull newSkinInfos[States::NumStates];
-			cloneSkinAndDatablock( skinPackProgressName, newSkinInfos );
+			setupProgressSkins( skinPackProgressName, newSkinInfos );
 
 			Renderable *progressLayer = getProgressLayer();
 			progressLayer->_setSkinPack( newSkinInfos );
@@ -178,9 +171,9 @@ namespace Colibri
 		updateProgressbar();
 	}
 	//-------------------------------------------------------------------------
-	void Progressbar::cloneSkinAndDatablock( Ogre::IdString skinPackName,
-											 const SkinInfo *colibri_nonnull *colibri_nonnull
-												 outSkinInfos )
+	void Progressbar::setupProgressSkins( Ogre::IdString skinPackName,
+										  const SkinInfo *colibri_nonnull *colibri_nonnull
+											  outSkinInfos )
 	{
 		SkinManager *skinManager = m_manager->getSkinManager();
 		const SkinPack *skinPack = skinManager->findSkinPack( skinPackName, LogSeverity::Fatal );
@@ -195,95 +188,58 @@ namespace Colibri
 		if( !skinInfos[States::Disabled] || !skinInfos[States::Disabled] )
 		{
 			m_manager->getLogListener()->log(
-				"Progressbar::cloneSkinAndDatablock called but skin pack did not specify a skin for "
+				"Progressbar::setupProgressSkins called but skin pack did not specify a skin for "
 				"Idle and/or Disabled states for the progress layer. "
 				"Progressbar will not look correctly",
 				LogSeverity::Warning );
 		}
 		else
 		{
-			cloneSkinAndDatablock( skinInfos, outSkinInfos, skinPack->progressBarIsAnimated );
+			setupProgressSkins( skinInfos, outSkinInfos, skinPack->progressBarIsAnimated );
 		}
 	}
 	//-------------------------------------------------------------------------
-	void Progressbar::cloneSkinAndDatablock( const SkinInfo *const *skinInfos,
-											 SkinInfo const **outSkinInfos, const bool bIsAnimated )
+	void Progressbar::setupProgressSkins( const SkinInfo *const *skinInfos,
+										  SkinInfo const **outSkinInfos, const bool bIsAnimated )
 	{
-		Ogre::HlmsManager *hlmsManager = m_manager->getOgreHlmsManager();
-
-		// Temporarily assign a different skin since we need to destroy
-		// this one (and switching would cause reading dangling pointers)
-		getProgressLayer()->_setSkinPack( skinInfos );
-		destroyClonedData();
+		memcpy( outSkinInfos, skinInfos, sizeof( SkinInfo * ) * States::NumStates );
 
 		if( !bIsAnimated )
 		{
-			memcpy( outSkinInfos, skinInfos, sizeof( SkinInfo * ) * States::NumStates );
+			getProgressLayer()->_setUvAnimation( false, false, 1.0f, 0.0f );
 			return;
 		}
 
-		Ogre::HlmsDatablock *datablocks[2] = {
-			hlmsManager->getDatablock( skinInfos[States::Disabled]->stateInfo.materialName ),
-			hlmsManager->getDatablock( skinInfos[States::Idle]->stateInfo.materialName ),
-		};
-
-		for( size_t i = 0u; i < 2u; ++i )
-		{
-			char tmpBuffer[128];
-			Ogre::LwString matName( Ogre::LwString::FromEmptyPointer( tmpBuffer, sizeof( tmpBuffer ) ) );
-			matName.a( "Colibri/Progressbar/Clone/", i == 0u ? "Disabled" : "Idle", getId() );
-
-			Ogre::HlmsDatablock *newClone = datablocks[i]->clone( matName.c_str() );
-
-			COLIBRI_ASSERT_HIGH( dynamic_cast<Ogre::HlmsUnlitDatablock *>( newClone ) );
-
-			m_progressLayerDatablock[i] = static_cast<Ogre::HlmsUnlitDatablock *>( newClone );
-
-			Ogre::HlmsSamplerblock samplerblock;
-			samplerblock.setAddressingMode( Ogre::TAM_WRAP );
-			m_progressLayerDatablock[i]->setSamplerblock( 0u, samplerblock );
-			m_progressLayerDatablock[i]->setEnableAnimationMatrix( 0u, true );
-
-			Ogre::Matrix4 animMat( Ogre::Matrix4::IDENTITY );
-			animMat.setTrans( Ogre::Vector3( 0, 0, 0 ) );
-			animMat.setScale( Ogre::Vector3( m_animLength, 1.0f, 1.0f ) );
-			m_progressLayerDatablock[i]->setAnimationMatrix( 0u, animMat );
-		}
-
-		memcpy( outSkinInfos, skinInfos, sizeof( SkinInfo * ) * States::NumStates );
-
-		m_skinCopy = new SkinInfo[2];
-		memset( m_skinCopy, 0, sizeof( SkinInfo ) * 2u );
+		setWrapAddressing( skinInfos[States::Disabled]->stateInfo.materialName );
+		setWrapAddressing( skinInfos[States::Idle]->stateInfo.materialName );
 
-		m_skinCopy[0] = *skinInfos[States::Disabled];
-		m_skinCopy[1] = *skinInfos[States::Idle];
-
-		for( size_t i = 0u; i < 2u; ++i )
-		{
-			m_skinCopy[i].materialName = *m_progressLayerDatablock[i]->getNameStr();
-			m_skinCopy[i].stateInfo.materialName = m_progressLayerDatablock[i]->getName();
-		}
+		getProgressLayer()->_setUvAnimation( true, false, m_animLength, 0.0f );
 
 		// Set all states to match States::Idle, except Disabled (see our class' remarks)
 		for( size_t i = 0u; i < States::NumStates; ++i )
-			outSkinInfos[i] = &m_skinCopy[1];
-		outSkinInfos[States::Disabled] = &m_skinCopy[0];
+			outSkinInfos[i] = skinInfos[States::Idle];
+		outSkinInfos[States::Disabled] = skinInfos[States::Disabled];
 	}
 	//-------------------------------------------------------------------------
-	void Progressbar::destroyClonedData()
+	void Progressbar::setWrapAddressing( Ogre::IdString datablockName )
 	{
-		for( size_t i = 0u; i < 2u; ++i )
+		Ogre::HlmsManager *hlmsManager = m_manager->getOgreHlmsManager();
+		Ogre::HlmsDatablock *datablock = hlmsManager->getDatablock( datablockName );
+
+		COLIBRI_ASSERT_HIGH( dynamic_cast<Ogre::HlmsUnlitDatablock *>( datablock ) );
+		Ogre::HlmsUnlitDatablock *unlitDatablock = static_cast<Ogre::HlmsUnlitDatablock *>( datablock );
+
+		Ogre::HlmsSamplerblock samplerblock;
+		const Ogre::HlmsSamplerblock *currSamplerblock = unlitDatablock->getSamplerblock( 0u );
+		if( currSamplerblock )
+			samplerblock = *currSamplerblock;
+
+		// Many Progressbars share this datablock. Only the first one needs to change it
+		if( samplerblock.mU != Ogre::TAM_WRAP || samplerblock.mV != Ogre::TAM_WRAP )
 		{
-			if( m_progressLayerDatablock[i] )
-			{
-				Ogre::Hlms *creator = m_progressLayerDatablock[i]->getCreator();
-				creator->destroyDatablock( m_progressLayerDatablock[i]->getName() );
-				m_progressLayerDatablock[i] = 0;
-			}
+			samplerblock.setAddressingMode( Ogre::TAM_WRAP );
+			unlitDatablock->setSamplerblock( 0u, samplerblock );
 		}
-
-		delete[] m_skinCopy;
-		m_skinCopy = 0;
 	}
 	//-------------------------------------------------------------------------
 	void Progressbar::updateProgressbar()
@@ -359,25 +315,8 @@ namespace Colibri
 		if( m_currentState == States::Disabled )
 			return;
 
-		Ogre::Matrix4 animMat;
-		animMat.makeTransform( Ogre::Vector3( -m_accumTime, 0, 0 ),
-							   Ogre::Vector3( m_animLength * m_progress, 1.0f, 1.0f ),
-							   Ogre::Quaternion::IDENTITY );
-
-		if( m_vertical )
-		{
-#ifndef M_PI
-			const float M_PI = 3.14159265358979323846f;
-#endif
-			Ogre::Matrix4 animMat2;
-			animMat2.makeTransform(
-				Ogre::Vector3::ZERO, Ogre::Vector3::UNIT_SCALE,
-				Ogre::Quaternion( Ogre::Radian( (float)M_PI / 2.0f ), Ogre::Vector3::UNIT_Z ) );
-			animMat = animMat * animMat2;
-		}
-
-		for( size_t i = 0u; i < 2u; ++i )
-			m_progressLayerDatablock[i]->setAnimationMatrix( 0u, animMat );
+		getProgressLayer()->_setUvAnimation( true, m_vertical, m_animLength * m_progress,
+											 m_accumTime );
 
 		m_accumTime += timeSinceLast * m_animSpeed * m_animLength;
 		float intPart;
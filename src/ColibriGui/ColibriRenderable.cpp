@@ -33,8 +33,12 @@ namespace Colibri
 		m_colour( Ogre::ColourValue::White ),
 		m_numVertices( 6u * 9u ),
 		m_currVertexBufferOffset( 0 ),
-		m_visualsEnabled( true )
+		m_currChunk( 0 ),
+		m_visualsEnabled( true ),
+		m_uvAnimationFlags( 0u )
 	{
+		m_uvAnimation[0] = 1.0f;
+		m_uvAnimation[1] = 0.0f;
 		m_zOrder = _wrapZOrderInternalId( 0 );
 		memset( m_stateInformation, 0, sizeof( m_stateInformation ) );
 		for( size_t i = 0u; i < States::NumStates; ++i )
@@ -62,6 +66,19 @@ namespace Colibri
 		return m_visualsEnabled;
 	}
 	//-------------------------------------------------------------------------
+	void Renderable::_setUvAnimation( bool bEnabled, bool bVertical, float scale, float offset )
+	{
+		m_uvAnimationFlags = 0u;
+		if( bEnabled )
+		{
+			m_uvAnimationFlags = NineSliceFlags::UvAnimated;
+			if( bVertical )
+				m_uvAnimationFlags |= NineSliceFlags::UvAnimatedVertical;
+		}
+		m_uvAnimation[0] = scale;
+		m_uvAnimation[1] = offset;
+	}
+	//-------------------------------------------------------------------------
 	void Renderable::setColour( bool overrideSkinColour, const Ogre::ColourValue &colour )
 	{
 		m_overrideSkinColour = overrideSkinColour;
@@ -199,10 +216,56 @@ namespace Colibri
 		setClipBorders( clipBorders );
 	}
 	//-------------------------------------------------------------------------
-	void Renderable::broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao )
+	void Renderable::broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao,
+									  Ogre::VertexArrayObject *nineSliceVao )
+	{
+		if( isLabel() )
+			setVao( textVao );
+		else if( isLabelBmp() )
+			setVao( vao );
+		else
+			setVao( nineSliceVao );
+		Widget::broadcastNewVao( vao, textVao, nineSliceVao );
+	}
+	//-------------------------------------------------------------------------
+	void Renderable::_removeEmptyDraw( ApiEncapsulatedObjects &apiObject )
+	{
+		if( apiObject.drawCountPtr && *apiObject.drawCountPtr == 0u )
+		{
+			// Adreno 618 will GPU crash if we send an indirect cmd with vertex_count = 0
+			--apiObject.drawCmd->numDraws;
+			// Take back the CbDrawStrip or CbDrawIndexed we issued
+			apiObject.indirectDraw -= apiObject.lastDrawSize;
+		}
+	}
+	//-------------------------------------------------------------------------
+	void Renderable::addIndirectDraw( ApiEncapsulatedObjects &apiObject, bool bIndexed,
+									  uint32_t firstVertex, uint32_t baseInstance )
 	{
-		setVao( !isLabel() ? vao : textVao );
-		Widget::broadcastNewVao( vao, textVao );
+		using namespace Ogre;
+
+		if( bIndexed )
+		{
+			CbDrawIndexed *drawIndexed = reinterpret_cast<CbDrawIndexed*>( apiObject.indirectDraw );
+			drawIndexed->primCount			= 0;
+			drawIndexed->instanceCount		= 1u;
+			drawIndexed->firstVertexIndex	= apiObject.quadIndexBufferStart;
+			drawIndexed->baseVertex			= firstVertex;
+			drawIndexed->baseInstance		= baseInstance;
+			apiObject.drawCountPtr = &drawIndexed->primCount;
+			apiObject.lastDrawSize = sizeof( CbDrawIndexed );
+		}
+		else
+		{
+			CbDrawStrip *drawStrip = reinterpret_cast<CbDrawStrip*>( apiObject.indirectDraw );
+			drawStrip->primCount		= 0;
+			drawStrip->instanceCount	= 1u;
+			drawStrip->firstVertexIndex	= firstVertex;
+			drawStrip->baseInstance		= baseInstance;
+			apiObject.drawCountPtr = &drawStrip->primCount;
+			apiObject.lastDrawSize = sizeof( CbDrawStrip );
+		}
+		apiObject.indirectDraw += apiObject.lastDrawSize;
 	}
 	//-------------------------------------------------------------------------
 	void Renderable::_addCommands( ApiEncapsulatedObjects &apiObject, bool collectingBreadthFirst )
@@ -220,10 +283,8 @@ namespace Colibri
 
 			uint32 lastHlmsCacheHash = apiObject.lastHlmsCache->hash;
 			VertexArrayObject *vao = mVaoPerLod[0].back();
-			const HlmsCache *hlmsCache = apiObject.hlms->getMaterial( apiObject.lastHlmsCache,
-																	  *apiObject.passCache,
-																	  queuedRenderable,
-																	  false );
+			const HlmsCache *hlmsCache = getCachedMaterial( apiObject.hlms, apiObject.lastHlmsCache,
+															*apiObject.passCache, queuedRenderable );
 			if( lastHlmsCacheHash != hlmsCache->hash )
 			{
 				CbPipelineStateObject *psoCmd = commandBuffer->addCommand<CbPipelineStateObject>();
@@ -235,111 +296,137 @@ namespace Colibri
 			}
 
 			const bool bIsLabel = isLabel();
-			const size_t widgetType = bIsLabel ? 1u : 0u;
+			const size_t widgetType = bIsLabel ? 1u : ( isLabelBmp() ? 2u : 0u );
+			// Regular widgets & Labels are drawn indexed with 4 vertices per quad.
+			// LabelBmps write actual vertices, 6 per quad.
+			const bool bIndexed = widgetType != 2u;
+
+			// LabelBmp vertices are split in chunks, each with its own Vao
+			if( widgetType == 2u )
+				vao = m_manager->_getVao( m_currChunk );
+
+			// m_currVertexBufferOffset & m_numVertices always count 6 vertices per quad
+			// (i.e. for indexed draws they count indices)
+			const uint32 numVertices = bIndexed ? ( m_numVertices / 6u ) * 4u : m_numVertices;
+			// Labels have 6 indices per GlyphVertex, regular widgets have 54 per NineSliceRecord.
+			uint32 recordStart = 0u;
+			if( widgetType == 0u )
+				recordStart = m_currVertexBufferOffset / ( 6u * 9u );
+			else if( widgetType == 1u )
+				recordStart = m_currVertexBufferOffset / 6u;
+
+			uint32 firstVertex;
+			bool bAppendsToDraw;
+			if( bIndexed )
+			{
+				// The shader only cares about the vertex ID relative to the start of the draw,
+				// so draws always start at the beginning of the Vao. That keeps the Vaos sized
+				// for a single draw instead of growing with every widget.
+				// A widget can be appended if its records follow the previous one's and it
+				// still fits in the Vao; otherwise it starts a new draw.
+				// Text doesn't get a drawId per Label (its glyph count is arbitrary), thus
+				// appended Labels must also use the same material as the first one.
+				const uint32 drawVertexCount =
+					apiObject.nextFirstVertex - apiObject.basePrimCount[widgetType];
+				bAppendsToDraw =
+					apiObject.lastVaoName == vao->getVaoName() &&
+					apiObject.nextRecordStart == recordStart &&
+					apiObject.nextRecordChunk == m_currChunk &&
+					( !bIsLabel || apiObject.lastDatablock == mHlmsDatablock ) &&
+					drawVertexCount + numVertices <= vao->getBaseVertexBuffer()->getNumElements();
+				firstVertex = apiObject.basePrimCount[widgetType];
+				if( bAppendsToDraw )
+					firstVertex += drawVertexCount;
+			}
+			else
+			{
+				firstVertex = static_cast<uint32>( vao->getBaseVertexBuffer()->_getFinalBufferStart() ) +
+							  m_currVertexBufferOffset;
+				bAppendsToDraw = apiObject.nextFirstVertex == firstVertex;
+			}
 
-			const uint32 firstVertex = m_currVertexBufferOffset + apiObject.basePrimCount[widgetType];
+			// Records are split in chunks too. Bind the one ours are in (if it changed,
+			// HlmsColibri adds a command, and thus a new draw command follows)
+			if( widgetType == 0u )
+			{
+				apiObject.hlms->setNineSliceRecordBuffer(
+					m_manager->_getNineSliceRecordBuffer( m_currChunk ) );
+			}
+			else if( widgetType == 1u )
+			{
+				apiObject.hlms->setGlyphRecordBuffer( m_manager->_getGlyphRecordBuffer( m_currChunk ) );
+			}
 
 			uint32 baseInstance = apiObject.hlms->fillBuffersForColibri(
 									  hlmsCache, queuedRenderable, false,
-									  firstVertex,
+									  firstVertex, recordStart,
 									  lastHlmsCacheHash, apiObject.commandBuffer );
 
-			if( apiObject.drawCmd != commandBuffer->getLastCommand() ||
-				apiObject.lastVaoName != vao->getVaoName() )
+			bool bNewCommand = apiObject.drawCmd != commandBuffer->getLastCommand() ||
+							   apiObject.lastVaoName != vao->getVaoName();
+			if( bNewCommand || !bAppendsToDraw )
 			{
-				if( apiObject.drawCountPtr && apiObject.drawCountPtr->primCount == 0u )
+				_removeEmptyDraw( apiObject );
+
+				// All draws of a command must be in the same indirect buffer chunk
+				if( apiObject.indirectDraw + sizeof( CbDrawIndexed ) > apiObject.endIndirectDraw )
 				{
-					// Adreno 618 will GPU crash if we send an indirect cmd with vertex_count = 0
-					--apiObject.drawCmd->numDraws;
-					// Since we only emit CbDrawStrip we can assume the previous cmd
-					// issued a CbDrawStrip, so take it back. Otherwise we'd have to
-					// save what our last cmd was.
-					apiObject.indirectDraw -= sizeof( CbDrawStrip );
+					m_manager->_mapNextIndirectBuffer( apiObject );
+					bNewCommand = true;
 				}
 
+				if( bNewCommand )
 				{
 					*commandBuffer->addCommand<CbVao>() = CbVao( vao );
 					*commandBuffer->addCommand<CbIndirectBuffer>() =
 							CbIndirectBuffer( apiObject.indirectBuffer );
 					apiObject.lastVaoName = vao->getVaoName();
-				}
-
-				void *offset = reinterpret_cast<void *>(
-					ptrdiff_t( apiObject.indirectBuffer->_getFinalBufferStart() ) +
-					( apiObject.indirectDraw - apiObject.startIndirectDraw ) );
-
-				CbDrawCallStrip *drawCall = commandBuffer->addCommand<CbDrawCallStrip>();
-				*drawCall = CbDrawCallStrip( apiObject.baseInstanceAndIndirectBuffers, vao, offset );
-				drawCall->numDraws = 1u;
-				apiObject.drawCmd = drawCall;
-				apiObject.primCount = 0;
-				apiObject.lastDatablock = mHlmsDatablock;
 
-				apiObject.drawCountPtr = reinterpret_cast<CbDrawStrip*>( apiObject.indirectDraw );
-				apiObject.drawCountPtr->primCount		= 0;
-				apiObject.drawCountPtr->instanceCount	= 1u;
-				apiObject.drawCountPtr->firstVertexIndex= firstVertex;
-				apiObject.drawCountPtr->baseInstance	= baseInstance;
-				apiObject.indirectDraw += sizeof( CbDrawStrip );
-			}
-			else if( bIsLabel && apiObject.lastDatablock != mHlmsDatablock )
-			{
-				if( apiObject.drawCountPtr && apiObject.drawCountPtr->primCount == 0u )
-				{
-					// Adreno 618 will GPU crash if we send an indirect cmd with vertex_count = 0
-					--apiObject.drawCmd->numDraws;
-					// Since we only emit CbDrawStrip we can assume the previous cmd
-					// issued a CbDrawStrip, so take it back. Otherwise we'd have to
-					// save what our last cmd was.
-					apiObject.indirectDraw -= sizeof( CbDrawStrip );
+					void *offset = reinterpret_cast<void *>(
+						ptrdiff_t( apiObject.indirectBuffer->_getFinalBufferStart() ) +
+						( apiObject.indirectDraw - apiObject.startIndirectDraw ) );
+
+					if( bIndexed )
+					{
+						CbDrawCallIndexed *drawCall = commandBuffer->addCommand<CbDrawCallIndexed>();
+						*drawCall = CbDrawCallIndexed( apiObject.baseInstanceAndIndirectBuffers, vao,
+													   offset );
+						apiObject.drawCmd = drawCall;
+					}
+					else
+					{
+						CbDrawCallStrip *drawCall = commandBuffer->addCommand<CbDrawCallStrip>();
+						*drawCall = CbDrawCallStrip( apiObject.baseInstanceAndIndirectBuffers, vao,
+													 offset );
+						apiObject.drawCmd = drawCall;
+					}
+					apiObject.drawCmd->numDraws = 1u;
 				}
-
-				//Text has arbitrary number of of vertices, thus we can't properly calculate the drawId
-				//and therefore the material ID unless we issue a start a new draw.
-				CbDrawCallStrip *drawCall = static_cast<CbDrawCallStrip*>( apiObject.drawCmd );
-				++drawCall->numDraws;
-				apiObject.primCount = 0;
-				apiObject.lastDatablock = mHlmsDatablock;
-
-				apiObject.drawCountPtr = reinterpret_cast<CbDrawStrip*>( apiObject.indirectDraw );
-				apiObject.drawCountPtr->primCount		= 0;
-				apiObject.drawCountPtr->instanceCount	= 1u;
-				apiObject.drawCountPtr->firstVertexIndex= firstVertex;
-				apiObject.drawCountPtr->baseInstance	= baseInstance;
-				apiObject.indirectDraw += sizeof( CbDrawStrip );
-			}
-			else if( apiObject.nextFirstVertex != firstVertex )
-			{
-				if( apiObject.drawCountPtr && apiObject.drawCountPtr->primCount == 0u )
+				else
 				{
-					// Adreno 618 will GPU crash if we send an indirect cmd with vertex_count = 0
-					--apiObject.drawCmd->numDraws;
-					// Since we only emit CbDrawStrip we can assume the previous cmd
-					// issued a CbDrawStrip, so take it back. Otherwise we'd have to
-					// save what our last cmd was.
-					apiObject.indirectDraw -= sizeof( CbDrawStrip );
+					//Text has arbitrary number of of vertices, thus we can't properly calculate
+					//the drawId and therefore the material ID unless we issue a start a new draw.
+					//So a Label with a different datablock starts a new draw.
+					//
+					//Otherwise we're most likely rendering using breadth first (which breaks
+					//ordering, thus the records jumped) or the draw reached the Vao's size.
+					//Add a new draw without creating a new command
+					++apiObject.drawCmd->numDraws;
 				}
 
-				//If we're here, we're most likely rendering using breadth first.
-				//Unfortunately, breadth first breaks ordering, thus firstVertex jumped.
-				//Add a new draw without creating a new command
-				CbDrawCallStrip *drawCall = static_cast<CbDrawCallStrip*>( apiObject.drawCmd );
-				++drawCall->numDraws;
 				apiObject.primCount = 0;
 				apiObject.lastDatablock = mHlmsDatablock;
 
-				apiObject.drawCountPtr = reinterpret_cast<CbDrawStrip*>( apiObject.indirectDraw );
-				apiObject.drawCountPtr->primCount		= 0;
-				apiObject.drawCountPtr->instanceCount	= 1u;
-				apiObject.drawCountPtr->firstVertexIndex= firstVertex;
-				apiObject.drawCountPtr->baseInstance	= baseInstance;
-				apiObject.indirectDraw += sizeof( CbDrawStrip );
+				addIndirectDraw( apiObject, bIndexed, firstVertex, baseInstance );
 			}
 
 			apiObject.primCount += m_numVertices;
-			apiObject.drawCountPtr->primCount = apiObject.primCount;
+			*apiObject.drawCountPtr = apiObject.primCount;
 
-			apiObject.nextFirstVertex = firstVertex + m_numVertices;
+			apiObject.nextFirstVertex = firstVertex + numVertices;
+			// A Label takes one record per glyph plus its LabelRecord
+			apiObject.nextRecordStart = recordStart + ( bIsLabel ? m_numVertices / 6u : 1u );
+			apiObject.nextRecordChunk = m_currChunk;
 		}
 
 		addChildrenCommands( apiObject, collectingBreadthFirst );
@@ -356,11 +443,13 @@ namespace Colibri
 											 RESTRICT_ALIAS vertexBuffer,
 											 GlyphVertex * colibri_nonnull * colibri_nonnull
 											 RESTRICT_ALIAS textVertBuffer,
+											 NineSliceRecord * colibri_nonnull * colibri_nonnull
+											 RESTRICT_ALIAS nineSliceBuffer,
 											 const Ogre::Vector2 &parentPos,
 											 const Ogre::Vector2 &parentCurrentScrollPos,
 											 const Matrix2x3 &parentRot )
 	{
-		_fillBuffersAndCommands( vertexBuffer, textVertBuffer, parentPos,
+		_fillBuffersAndCommands( vertexBuffer, textVertBuffer, nineSliceBuffer, parentPos,
 								 parentCurrentScrollPos, parentRot, Ogre::Vector2::ZERO, false );
 	}
 }
@@ -3,10 +3,13 @@
 
 #include "ColibriGui/ColibriWindow.h"
 #include "ColibriGui/ColibriManager.h"
+#include "ColibriGui/ColibriSimd.h"
 #include "ColibriGui/Ogre/ColibriOgreRenderable.h"
 
 #include "OgreBitwise.h"
 
+#include <stddef.h>
+
 #define TODO_borderRepeatSize
 #define TODO_this_is_a_workaround_neg_y
 
@@ -15,7 +18,7 @@ COLIBRI_ASSUME_NONNULL_BEGIN
 namespace Colibri
 {
 	//-------------------------------------------------------------------------
-	inline void Renderable::addQuad( UiVertex * RESTRICT_ALIAS vertexBuffer,
+	inline UiVertex* Renderable::addQuad( UiVertex * RESTRICT_ALIAS vertexBuffer,
 									 Ogre::Vector2 topLeft,
 									 Ogre::Vector2 bottomRight,
 									 Ogre::Vector4 uvTopLeftBottomRight,
@@ -28,96 +31,101 @@ namespace Colibri
 									 const Matrix2x3& derivedRot )
 	{
 		TODO_this_is_a_workaround_neg_y;
-		Ogre::Vector2 tmp2d;
-
-		#define COLIBRI_ADD_VERTEX( _x, _y, _u, _v, clipDistanceTop, clipDistanceLeft, \
-									clipDistanceRight, clipDistanceBottom ) \
-			tmp2d = Widget::mul( derivedRot, _x, _y * invCanvasAspectRatio ); \
-			tmp2d.y *= canvasAspectRatio; \
-			vertexBuffer->x = tmp2d.x; \
-			vertexBuffer->y = -tmp2d.y; \
-			vertexBuffer->u = static_cast<uint16_t>( _u * 65535.0f ); \
-			vertexBuffer->v = static_cast<uint16_t>( _v * 65535.0f ); \
-			vertexBuffer->rgbaColour[0] = rgbaColour[0]; \
-			vertexBuffer->rgbaColour[1] = rgbaColour[1]; \
-			vertexBuffer->rgbaColour[2] = rgbaColour[2]; \
-			vertexBuffer->rgbaColour[3] = rgbaColour[3]; \
-			vertexBuffer->clipDistance[Borders::Top]	= clipDistanceTop; \
-			vertexBuffer->clipDistance[Borders::Left]	= clipDistanceLeft; \
-			vertexBuffer->clipDistance[Borders::Right]	= clipDistanceRight; \
-			vertexBuffer->clipDistance[Borders::Bottom]	= clipDistanceBottom; \
-			++vertexBuffer
-
-		COLIBRI_ADD_VERTEX( topLeft.x, topLeft.y,
-							uvTopLeftBottomRight.x, uvTopLeftBottomRight.y,
-							(topLeft.y - parentDerivedTL.y) * invSize.y,
-							(topLeft.x - parentDerivedTL.x) * invSize.x,
-							(parentDerivedBR.x - topLeft.x) * invSize.x,
-							(parentDerivedBR.y - topLeft.y) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( topLeft.x, bottomRight.y,
-							uvTopLeftBottomRight.x, uvTopLeftBottomRight.w,
-							(bottomRight.y - parentDerivedTL.y) * invSize.y,
-							(topLeft.x - parentDerivedTL.x) * invSize.x,
-							(parentDerivedBR.x - topLeft.x) * invSize.x,
-							(parentDerivedBR.y - bottomRight.y) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( bottomRight.x, bottomRight.y,
-							uvTopLeftBottomRight.z, uvTopLeftBottomRight.w,
-							(bottomRight.y - parentDerivedTL.y) * invSize.y,
-							(bottomRight.x - parentDerivedTL.x) * invSize.x,
-							(parentDerivedBR.x - bottomRight.x) * invSize.x,
-							(parentDerivedBR.y - bottomRight.y) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( bottomRight.x, bottomRight.y,
-							uvTopLeftBottomRight.z, uvTopLeftBottomRight.w,
-							(bottomRight.y - parentDerivedTL.y) * invSize.y,
-							(bottomRight.x - parentDerivedTL.x) * invSize.x,
-							(parentDerivedBR.x - bottomRight.x) * invSize.x,
-							(parentDerivedBR.y - bottomRight.y) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( bottomRight.x, topLeft.y,
-							uvTopLeftBottomRight.z, uvTopLeftBottomRight.y,
-							(topLeft.y - parentDerivedTL.y) * invSize.y,
-							(bottomRight.x - parentDerivedTL.x) * invSize.x,
-							(parentDerivedBR.x - bottomRight.x) * invSize.x,
-							(parentDerivedBR.y - topLeft.y) * invSize.y );
-
-		COLIBRI_ADD_VERTEX( topLeft.x, topLeft.y,
-							uvTopLeftBottomRight.x, uvTopLeftBottomRight.y,
-							(topLeft.y - parentDerivedTL.y) * invSize.y,
-							(topLeft.x - parentDerivedTL.x) * invSize.x,
-							(parentDerivedBR.x - topLeft.x) * invSize.x,
-							(parentDerivedBR.y - topLeft.y) * invSize.y );
-
-		#undef COLIBRI_ADD_VERTEX
+
+		float posX[4], posY[4];
+		float clipDistance[4 * Borders::NumBorders];
+		transformQuadCorners( topLeft, bottomRight, parentDerivedTL, parentDerivedBR, invSize,
+							  canvasAspectRatio, invCanvasAspectRatio, derivedRot,
+							  !isIdentity( derivedRot ), posX, posY, clipDistance );
+
+		const uint16_t u0 = static_cast<uint16_t>( uvTopLeftBottomRight.x * 65535.0f );
+		const uint16_t v0 = static_cast<uint16_t>( uvTopLeftBottomRight.y * 65535.0f );
+		const uint16_t u1 = static_cast<uint16_t>( uvTopLeftBottomRight.z * 65535.0f );
+		const uint16_t v1 = static_cast<uint16_t>( uvTopLeftBottomRight.w * 65535.0f );
+		const uint16_t cornerU[4] = { u0, u0, u1, u1 };
+		const uint16_t cornerV[4] = { v0, v1, v1, v0 };
+
+		if( m_manager->useCompactVertexFormat() )
+		{
+			UiVertexCompact corners[4];
+			for( size_t i = 0u; i < 4u; ++i )
+			{
+				corners[i].x = toCompactPosition( posX[i] );
+				corners[i].y = toCompactPosition( posY[i] );
+				corners[i].u = cornerU[i];
+				corners[i].v = cornerV[i];
+				memcpy( corners[i].rgbaColour, rgbaColour, sizeof( corners[i].rgbaColour ) );
+				for( size_t j = 0u; j < Borders::NumBorders; ++j )
+				{
+					corners[i].clipDistance[j] =
+						Ogre::Bitwise::floatToHalf( clipDistance[i * Borders::NumBorders + j] );
+				}
+			}
+
+			UiVertexCompact *RESTRICT_ALIAS compactBuffer =
+				reinterpret_cast<UiVertexCompact *>( vertexBuffer );
+			compactBuffer[0] = corners[0];
+			compactBuffer[1] = corners[1];
+			compactBuffer[2] = corners[2];
+			compactBuffer[3] = corners[2];
+			compactBuffer[4] = corners[3];
+			compactBuffer[5] = corners[0];
+			return reinterpret_cast<UiVertex *>( compactBuffer + 6u );
+		}
+
+		UiVertex corners[4];
+		for( size_t i = 0u; i < 4u; ++i )
+		{
+			corners[i].x = posX[i];
+			corners[i].y = posY[i];
+			corners[i].u = cornerU[i];
+			corners[i].v = cornerV[i];
+			memcpy( corners[i].rgbaColour, rgbaColour, sizeof( corners[i].rgbaColour ) );
+			memcpy( corners[i].clipDistance, &clipDistance[i * Borders::NumBorders],
+					sizeof( corners[i].clipDistance ) );
+		}
+
+		// Whole-struct copies let the compiler use wide stores into the (write combined) buffer
+		vertexBuffer[0] = corners[0];
+		vertexBuffer[1] = corners[1];
+		vertexBuffer[2] = corners[2];
+		vertexBuffer[3] = corners[2];
+		vertexBuffer[4] = corners[3];
+		vertexBuffer[5] = corners[0];
+		return vertexBuffer + 6u;
 	}
 	//-------------------------------------------------------------------------
 	inline void Renderable::_fillBuffersAndCommands( UiVertex * colibri_nonnull * colibri_nonnull
 													 RESTRICT_ALIAS _vertexBuffer,
 													 GlyphVertex * colibri_nonnull * colibri_nonnull
 													 RESTRICT_ALIAS _textVertBuffer,
+													 NineSliceRecord * colibri_nonnull * colibri_nonnull
+													 RESTRICT_ALIAS _nineSliceBuffer,
 													 const Ogre::Vector2 &parentPos,
 													 const Ogre::Vector2 &parentScrollPos,
 													 const Matrix2x3 &parentRot,
 													 const Ogre::Vector2 &currentScrollPos,
 													 bool forWindows )
 	{
-		UiVertex * RESTRICT_ALIAS vertexBuffer = *_vertexBuffer;
-
-		updateDerivedTransform( parentPos, parentRot );
+		NineSliceRecord * RESTRICT_ALIAS nineSliceBuffer = *_nineSliceBuffer;
 
 		m_culled = true;
 
 		if( forWindows )
 		{
-			if( (m_parent && !m_parent->intersectsChild( this, parentScrollPos )) || m_hidden )
+			if( (m_parent && !m_parent->intersectsChild( this, parentScrollPos )) || m_hidden ||
+				m_outsideClipRegion )
+			{
 				return;
+			}
 		}
 		else
 		{
-			if( !m_parent->intersectsChild( this, parentScrollPos ) || m_hidden )
+			if( !m_parent->intersectsChild( this, parentScrollPos ) || m_hidden ||
+				m_outsideClipRegion )
+			{
 				return;
+			}
 		}
 
 		m_culled = false;
@@ -152,8 +160,11 @@ namespace Colibri
 
 		if( m_visualsEnabled )
 		{
-			m_currVertexBufferOffset =
-				static_cast<uint32_t>( vertexBuffer - m_manager->_getVertexBufferBase() );
+			nineSliceBuffer = m_manager->_reserveNineSliceRecords( nineSliceBuffer, 1u, m_currChunk );
+
+			// There's one NineSliceRecord per widget, but the draw has 54 indices per widget
+			m_currVertexBufferOffset = ( 6u * 9u ) * static_cast<uint32_t>(
+				nineSliceBuffer - m_manager->_getNineSliceRecordBufferBase() );
 
 			uint8_t rgbaColour[4];
 			rgbaColour[0] = static_cast<uint8_t>( m_colour.r * 255.0f + 0.5f );
@@ -184,73 +195,51 @@ namespace Colibri
 			const float canvasAr = m_manager->getCanvasAspectRatio();
 			const float invCanvasAr = m_manager->getCanvasInvAspectRatio();
 
-			// 1st row
-			addQuad( vertexBuffer,                                           //
-					 outerTopLeft, innerTopLeft,                             //
-					 stateInfo.uvTopLeftBottomRight[0],                      //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,  //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			addQuad( vertexBuffer,                                           //
-					 Ogre::Vector2( innerTopLeft.x, outerTopLeft.y ),        //
-					 Ogre::Vector2( innerBottomRight.x, innerTopLeft.y ),    //
-					 stateInfo.uvTopLeftBottomRight[1],                      //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,  //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			addQuad( vertexBuffer,                                           //
-					 Ogre::Vector2( innerBottomRight.x, outerTopLeft.y ),    //
-					 Ogre::Vector2( outerBottomRight.x, innerTopLeft.y ),    //
-					 stateInfo.uvTopLeftBottomRight[2],                      //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,  //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			// 2nd row
-			addQuad( vertexBuffer,                                           //
-					 Ogre::Vector2( outerTopLeft.x, innerTopLeft.y ),        //
-					 Ogre::Vector2( innerTopLeft.x, innerBottomRight.y ),    //
-					 stateInfo.uvTopLeftBottomRight[3],                      //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,  //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			addQuad( vertexBuffer,                                             //
-					 Ogre::Vector2( innerTopLeft.x, innerTopLeft.y ),          //
-					 Ogre::Vector2( innerBottomRight.x, innerBottomRight.y ),  //
-					 stateInfo.uvTopLeftBottomRight[4],                        //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,    //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			addQuad( vertexBuffer,                                             //
-					 Ogre::Vector2( innerBottomRight.x, innerTopLeft.y ),      //
-					 Ogre::Vector2( outerBottomRight.x, innerBottomRight.y ),  //
-					 stateInfo.uvTopLeftBottomRight[5],                        //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,    //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			// 3rd row
-			addQuad( vertexBuffer,                                           //
-					 Ogre::Vector2( outerTopLeft.x, innerBottomRight.y ),    //
-					 Ogre::Vector2( innerTopLeft.x, outerBottomRight.y ),    //
-					 stateInfo.uvTopLeftBottomRight[6],                      //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,  //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			addQuad( vertexBuffer,                                             //
-					 Ogre::Vector2( innerTopLeft.x, innerBottomRight.y ),      //
-					 Ogre::Vector2( innerBottomRight.x, outerBottomRight.y ),  //
-					 stateInfo.uvTopLeftBottomRight[7],                        //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,    //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-			addQuad( vertexBuffer,                                             //
-					 Ogre::Vector2( innerBottomRight.x, innerBottomRight.y ),  //
-					 Ogre::Vector2( outerBottomRight.x, outerBottomRight.y ),  //
-					 stateInfo.uvTopLeftBottomRight[8],                        //
-					 rgbaColour, parentDerivedTL, parentDerivedBR, invSize,    //
-					 canvasAr, invCanvasAr, this->m_derivedOrientation );
-			vertexBuffer += 6u;
-
-			*_vertexBuffer = vertexBuffer;
+			// Write a single record. The vertex shader expands it into the 3x3 grid
+			NineSliceRecord record;
+			record.gridX[0] = outerTopLeft.x;
+			record.gridX[1] = innerTopLeft.x;
+			record.gridX[2] = innerBottomRight.x;
+			record.gridX[3] = outerBottomRight.x;
+			record.gridY[0] = outerTopLeft.y;
+			record.gridY[1] = innerTopLeft.y;
+			record.gridY[2] = innerBottomRight.y;
+			record.gridY[3] = outerBottomRight.y;
+			memcpy( record.derivedRot, this->m_derivedOrientation.m, sizeof( record.derivedRot ) );
+			record.canvasAspectRatio = canvasAr;
+			record.invCanvasAspectRatio = invCanvasAr;
+			record.parentDerivedTL[0] = parentDerivedTL.x;
+			record.parentDerivedTL[1] = parentDerivedTL.y;
+			record.parentDerivedBR[0] = parentDerivedBR.x;
+			record.parentDerivedBR[1] = parentDerivedBR.y;
+			record.invSize[0] = invSize.x;
+			record.invSize[1] = invSize.y;
+			memcpy( record.rgbaColour, rgbaColour, sizeof( record.rgbaColour ) );
+			record.flags = m_uvAnimationFlags;
+			if( !isIdentity( this->m_derivedOrientation ) )
+				record.flags |= NineSliceFlags::Rotated;
+			for( size_t i = 0u; i < GridLocations::NumGridLocations; ++i )
+			{
+				const Ogre::Vector4 &uv = stateInfo.uvTopLeftBottomRight[i];
+				record.uvTopLeftBottomRight[i][0] = static_cast<uint16_t>( uv.x * 65535.0f );
+				record.uvTopLeftBottomRight[i][1] = static_cast<uint16_t>( uv.y * 65535.0f );
+				record.uvTopLeftBottomRight[i][2] = static_cast<uint16_t>( uv.z * 65535.0f );
+				record.uvTopLeftBottomRight[i][3] = static_cast<uint16_t>( uv.w * 65535.0f );
+			}
+			record.uvAnimation[0] = m_uvAnimation[0];
+			record.uvAnimation[1] = m_uvAnimation[1];
+
+			// The vertex shader reads the record as 11x uint4 with hardcoded indices
+			COLIBRI_STATIC_ASSERT( sizeof( NineSliceRecord ) == 11u * 16u );
+			COLIBRI_STATIC_ASSERT( offsetof( NineSliceRecord, invSize ) == 5u * 16u );
+			COLIBRI_STATIC_ASSERT( offsetof( NineSliceRecord, uvTopLeftBottomRight ) == 6u * 16u );
+			COLIBRI_STATIC_ASSERT( offsetof( NineSliceRecord, uvAnimation ) == 10u * 16u + 8u );
+
+			// Whole-struct copy lets the compiler use wide stores into the (write combined) buffer
+			*nineSliceBuffer = record;
+			++nineSliceBuffer;
+
+			*_nineSliceBuffer = nineSliceBuffer;
 		}
 
 		const Matrix2x3 &finalRot = this->m_derivedOrientation;
@@ -263,7 +252,7 @@ namespace Colibri
 
 		while( itor != end )
 		{
-			(*itor)->_fillBuffersAndCommands( _vertexBuffer, _textVertBuffer,
+			(*itor)->_fillBuffersAndCommands( _vertexBuffer, _textVertBuffer, _nineSliceBuffer,
 											 outerTopLeftWithClipping, currentScrollPos, finalRot );
 			++itor;
 		}
@@ -0,0 +1,318 @@
+
+#include "ColibriGui/ColibriTransformStore.h"
+
+#include "ColibriGui/ColibriSimd.h"
+#include "ColibriGui/ColibriWindow.h"
+
+#include <algorithm>
+
+namespace Colibri
+{
+	namespace
+	{
+		/// Used for leftovers that don't fill a whole SIMD register, and when there's no SIMD
+		struct ScalarOps
+		{
+			typedef float Real;
+			static const uint32_t c_width = 1u;
+
+			static Real load( const float *src ) { return *src; }
+			static void store( float *dst, Real v ) { *dst = v; }
+			static Real set1( float v ) { return v; }
+			static Real gather( const float *src, const uint32_t *idx ) { return src[idx[0]]; }
+			static Real add( Real a, Real b ) { return a + b; }
+			static Real sub( Real a, Real b ) { return a - b; }
+			static Real mul( Real a, Real b ) { return a * b; }
+		};
+
+#if defined( COLIBRI_SIMD_SSE2 )
+		struct SimdOps
+		{
+			typedef __m128 Real;
+			static const uint32_t c_width = 4u;
+
+			static Real load( const float *src ) { return _mm_loadu_ps( src ); }
+			static void store( float *dst, Real v ) { _mm_storeu_ps( dst, v ); }
+			static Real set1( float v ) { return _mm_set1_ps( v ); }
+			static Real gather( const float *src, const uint32_t *idx )
+			{
+				return _mm_setr_ps( src[idx[0]], src[idx[1]], src[idx[2]], src[idx[3]] );
+			}
+			static Real add( Real a, Real b ) { return _mm_add_ps( a, b ); }
+			static Real sub( Real a, Real b ) { return _mm_sub_ps( a, b ); }
+			static Real mul( Real a, Real b ) { return _mm_mul_ps( a, b ); }
+		};
+#elif defined( COLIBRI_SIMD_NEON )
+		struct SimdOps
+		{
+			typedef float32x4_t Real;
+			static const uint32_t c_width = 4u;
+
+			static Real load( const float *src ) { return vld1q_f32( src ); }
+			static void store( float *dst, Real v ) { vst1q_f32( dst, v ); }
+			static Real set1( float v ) { return vdupq_n_f32( v ); }
+			static Real gather( const float *src, const uint32_t *idx )
+			{
+				const float values[4] = { src[idx[0]], src[idx[1]], src[idx[2]], src[idx[3]] };
+				return vld1q_f32( values );
+			}
+			static Real add( Real a, Real b ) { return vaddq_f32( a, b ); }
+			static Real sub( Real a, Real b ) { return vsubq_f32( a, b ); }
+			// Don't use vmlaq_f32: it may get fused, which would break bit-exactness
+			static Real mul( Real a, Real b ) { return vmulq_f32( a, b ); }
+		};
+#endif
+	}  // namespace
+
+	TransformStore::TransformStore() : m_layoutDirty( true ) {}
+	//-------------------------------------------------------------------------
+	void TransformStore::rebuildLayout( const WindowVec &windows )
+	{
+		m_widgets.clear();
+		m_parentIdx.clear();
+		m_levelStart.clear();
+
+		// Placeholder parent of the root windows
+		m_widgets.push_back( 0 );
+		m_parentIdx.push_back( 0u );
+		m_levelStart.push_back( 0u );
+
+		m_widgets.insert( m_widgets.end(), windows.begin(), windows.end() );
+		m_parentIdx.resize( m_widgets.size(), 0u );
+
+		uint32_t levelStart = 1u;
+		while( levelStart != m_widgets.size() )
+		{
+			m_levelStart.push_back( levelStart );
+
+			const uint32_t levelEnd = static_cast<uint32_t>( m_widgets.size() );
+			for( uint32_t parentIdx = levelStart; parentIdx != levelEnd; ++parentIdx )
+			{
+				const WidgetVec &children = m_widgets[parentIdx]->m_children;
+				m_widgets.insert( m_widgets.end(), children.begin(), children.end() );
+				m_parentIdx.resize( m_widgets.size(), parentIdx );
+			}
+
+			levelStart = levelEnd;
+		}
+		m_levelStart.push_back( static_cast<uint32_t>( m_widgets.size() ) );
+
+		const size_t numWidgets = m_widgets.size();
+		m_data.resize( NumAttributes * numWidgets );
+
+		// What ColibriManager passes to the root windows in _fillBuffersAndCommands
+		m_data[ChildOriginX * numWidgets] = -1.0f;
+		m_data[ChildOriginY * numWidgets] = -1.0f;
+		m_data[DerivedRot00 * numWidgets] = 1.0f;
+		m_data[DerivedRot01 * numWidgets] = 0.0f;
+		m_data[DerivedRot02 * numWidgets] = 0.0f;
+		m_data[DerivedRot10 * numWidgets] = 0.0f;
+		m_data[DerivedRot11 * numWidgets] = 1.0f;
+		m_data[DerivedRot12 * numWidgets] = 0.0f;
+		m_data[InnerClipMinX * numWidgets] = -1.0f;
+		m_data[InnerClipMinY * numWidgets] = -1.0f;
+		m_data[InnerClipMaxX * numWidgets] = 1.0f;
+		m_data[InnerClipMaxY * numWidgets] = 1.0f;
+
+		m_skipChildren.clear();
+		m_skipChildren.resize( numWidgets, 0u );
+
+		m_layoutDirty = false;
+	}
+	//-------------------------------------------------------------------------
+	template <typename Ops>
+	uint32_t TransformStore::updateWidgets( uint32_t i, uint32_t end, Ogre::Vector2 invCanvasSize2x,
+											float invCanvasAr )
+	{
+		typedef typename Ops::Real Real;
+
+		const size_t numWidgets = m_widgets.size();
+		float *RESTRICT_ALIAS d[NumAttributes];
+		for( size_t j = 0u; j < NumAttributes; ++j )
+			d[j] = &m_data[j * numWidgets];
+
+		const Real invCanvasSizeX = Ops::set1( invCanvasSize2x.x );
+		const Real invCanvasSizeY = Ops::set1( invCanvasSize2x.y );
+		const Real invAr = Ops::set1( invCanvasAr );
+		const Real half = Ops::set1( 0.5f );
+
+		for( ; end - i >= Ops::c_width; i += Ops::c_width )
+		{
+			// Same math as Widget::updateDerivedTransform
+			const uint32_t *parentIdx = &m_parentIdx[i];
+			const Real parentPosX = Ops::gather( d[ChildOriginX], parentIdx );
+			const Real parentPosY = Ops::gather( d[ChildOriginY], parentIdx );
+			const Real parentRot00 = Ops::gather( d[DerivedRot00], parentIdx );
+			const Real parentRot01 = Ops::gather( d[DerivedRot01], parentIdx );
+			const Real parentRot02 = Ops::gather( d[DerivedRot02], parentIdx );
+			const Real parentRot10 = Ops::gather( d[DerivedRot10], parentIdx );
+			const Real parentRot11 = Ops::gather( d[DerivedRot11], parentIdx );
+			const Real parentRot12 = Ops::gather( d[DerivedRot12], parentIdx );
+
+			const Real topLeftX =
+				Ops::add( parentPosX, Ops::mul( Ops::load( d[PosX] + i ), invCanvasSizeX ) );
+			const Real topLeftY =
+				Ops::add( parentPosY, Ops::mul( Ops::load( d[PosY] + i ), invCanvasSizeY ) );
+			const Real bottomRightX =
+				Ops::add( topLeftX, Ops::mul( Ops::load( d[SizeX] + i ), invCanvasSizeX ) );
+			const Real bottomRightY =
+				Ops::add( topLeftY, Ops::mul( Ops::load( d[SizeY] + i ), invCanvasSizeY ) );
+
+			const Real ndcCenterX = Ops::mul( Ops::add( topLeftX, bottomRightX ), half );
+			const Real ndcCenterY =
+				Ops::mul( Ops::mul( Ops::add( topLeftY, bottomRightY ), half ), invAr );
+
+			const Real orientation0 = Ops::load( d[Orientation0] + i );
+			const Real orientation1 = Ops::load( d[Orientation1] + i );
+			const Real orientation2 = Ops::load( d[Orientation2] + i );
+			const Real orientation3 = Ops::load( d[Orientation3] + i );
+
+			const Real centerDiffX =
+				Ops::sub( ndcCenterX, Ops::add( Ops::mul( orientation0, ndcCenterX ),
+												Ops::mul( orientation1, ndcCenterY ) ) );
+			const Real centerDiffY =
+				Ops::sub( ndcCenterY, Ops::add( Ops::mul( orientation2, ndcCenterX ),
+												Ops::mul( orientation3, ndcCenterY ) ) );
+
+			// mul( parentRot, localRot )
+			Ops::store( d[DerivedRot00] + i, Ops::add( Ops::mul( parentRot00, orientation0 ),
+													   Ops::mul( parentRot01, orientation2 ) ) );
+			Ops::store( d[DerivedRot01] + i, Ops::add( Ops::mul( parentRot00, orientation1 ),
+													   Ops::mul( parentRot01, orientation3 ) ) );
+			Ops::store( d[DerivedRot02] + i,
+						Ops::add( Ops::add( Ops::mul( parentRot00, centerDiffX ),
+											Ops::mul( parentRot01, centerDiffY ) ),
+								  parentRot02 ) );
+			Ops::store( d[DerivedRot10] + i, Ops::add( Ops::mul( parentRot10, orientation0 ),
+													   Ops::mul( parentRot11, orientation2 ) ) );
+			Ops::store( d[DerivedRot11] + i, Ops::add( Ops::mul( parentRot10, orientation1 ),
+													   Ops::mul( parentRot11, orientation3 ) ) );
+			Ops::store( d[DerivedRot12] + i,
+						Ops::add( Ops::add( Ops::mul( parentRot10, centerDiffX ),
+											Ops::mul( parentRot11, centerDiffY ) ),
+								  parentRot12 ) );
+
+			Ops::store( d[DerivedTopLeftX] + i, topLeftX );
+			Ops::store( d[DerivedTopLeftY] + i, topLeftY );
+			Ops::store( d[DerivedBottomRightX] + i, bottomRightX );
+			Ops::store( d[DerivedBottomRightY] + i, bottomRightY );
+			Ops::store( d[ChildOriginX] + i, Ops::add( topLeftX, Ops::load( d[ChildOffsetX] + i ) ) );
+			Ops::store( d[ChildOriginY] + i, Ops::add( topLeftY, Ops::load( d[ChildOffsetY] + i ) ) );
+		}
+
+		return i;
+	}
+	//-------------------------------------------------------------------------
+	void TransformStore::update( const WindowVec &windows, Ogre::Vector2 invCanvasSize2x,
+								 float invCanvasAr )
+	{
+		if( m_layoutDirty )
+			rebuildLayout( windows );
+
+		const size_t numWidgets = m_widgets.size();
+		float *RESTRICT_ALIAS data = &m_data[0];
+
+		// Level 0 is the placeholder, it's never updated
+		const size_t numLevels = m_levelStart.size() - 1u;
+		for( size_t level = 1u; level < numLevels; ++level )
+		{
+			const uint32_t levelBegin = m_levelStart[level];
+			const uint32_t levelEnd = m_levelStart[level + 1u];
+
+			// Gather the local transforms of the widgets that can be seen
+			for( uint32_t i = levelBegin; i < levelEnd; ++i )
+			{
+				const Widget *widget = m_widgets[i];
+
+				// Windows aren't clipped to their parent window. They may be seen even if it
+				// can't (and since windows are never skipped, their parent is always up to date)
+				m_skipChildren[i] = widget->isWindow() ? 0u : m_skipChildren[m_parentIdx[i]];
+				if( m_skipChildren[i] )
+					continue;
+
+				data[PosX * numWidgets + i] = widget->m_position.x;
+				data[PosY * numWidgets + i] = widget->m_position.y;
+				data[SizeX * numWidgets + i] = widget->m_size.x;
+				data[SizeY * numWidgets + i] = widget->m_size.y;
+				data[Orientation0 * numWidgets + i] = widget->m_orientation.x;
+				data[Orientation1 * numWidgets + i] = widget->m_orientation.y;
+				data[Orientation2 * numWidgets + i] = widget->m_orientation.z;
+				data[Orientation3 * numWidgets + i] = widget->m_orientation.w;
+
+				const Ogre::Vector2 childOffset =
+					( widget->m_clipBorderTL - widget->getCurrentScroll() ) * invCanvasSize2x;
+				data[ChildOffsetX * numWidgets + i] = childOffset.x;
+				data[ChildOffsetY * numWidgets + i] = childOffset.y;
+			}
+
+			// The skipped widgets are updated too (with stale data) so that the rest stays
+			// contiguous. It's cheaper than splitting the level, and the results are discarded
+			uint32_t i = levelBegin;
+#if defined( COLIBRI_SIMD_SSE2 ) || defined( COLIBRI_SIMD_NEON )
+			i = updateWidgets<SimdOps>( i, levelEnd, invCanvasSize2x, invCanvasAr );
+#endif
+			updateWidgets<ScalarOps>( i, levelEnd, invCanvasSize2x, invCanvasAr );
+
+			// Write the results back, and cull the subtrees that can't be seen
+			for( i = levelBegin; i < levelEnd; ++i )
+			{
+				Widget *widget = m_widgets[i];
+
+				if( m_skipChildren[i] )
+				{
+#if COLIBRIGUI_DEBUG >= COLIBRIGUI_DEBUG_MEDIUM
+					widget->m_transformOutOfDate = true;
+#endif
+					continue;
+				}
+
+				widget->m_derivedTopLeft.x = data[DerivedTopLeftX * numWidgets + i];
+				widget->m_derivedTopLeft.y = data[DerivedTopLeftY * numWidgets + i];
+				widget->m_derivedBottomRight.x = data[DerivedBottomRightX * numWidgets + i];
+				widget->m_derivedBottomRight.y = data[DerivedBottomRightY * numWidgets + i];
+				widget->m_derivedOrientation.m[0][0] = data[DerivedRot00 * numWidgets + i];
+				widget->m_derivedOrientation.m[0][1] = data[DerivedRot01 * numWidgets + i];
+				widget->m_derivedOrientation.m[0][2] = data[DerivedRot02 * numWidgets + i];
+				widget->m_derivedOrientation.m[1][0] = data[DerivedRot10 * numWidgets + i];
+				widget->m_derivedOrientation.m[1][1] = data[DerivedRot11 * numWidgets + i];
+				widget->m_derivedOrientation.m[1][2] = data[DerivedRot12 * numWidgets + i];
+#if COLIBRIGUI_DEBUG >= COLIBRIGUI_DEBUG_MEDIUM
+				widget->m_transformOutOfDate = false;
+#endif
+
+				// Same region _fillBuffersAndCommands clips us to (i.e. Widget::m_accumMinClipTL
+				// & m_accumMaxClipBR). Windows are only clipped to the screen
+				Ogre::Vector2 accumMinClip( -1.0f );
+				Ogre::Vector2 accumMaxClip( 1.0f );
+				if( !widget->isWindow() )
+				{
+					const size_t parentIdx = m_parentIdx[i];
+					accumMinClip.x = data[InnerClipMinX * numWidgets + parentIdx];
+					accumMinClip.y = data[InnerClipMinY * numWidgets + parentIdx];
+					accumMaxClip.x = data[InnerClipMaxX * numWidgets + parentIdx];
+					accumMaxClip.y = data[InnerClipMaxY * numWidgets + parentIdx];
+				}
+
+				const Ogre::Vector2 derivedTL = widget->m_derivedTopLeft;
+				const Ogre::Vector2 derivedBR = widget->m_derivedBottomRight;
+
+				// Our widgets are clipped to us, thus if we can't be seen, neither can they.
+				// Our child windows aren't; they don't inherit m_skipChildren (see above)
+				const bool outsideClipRegion =
+					std::max( derivedTL.x, accumMinClip.x ) > std::min( derivedBR.x, accumMaxClip.x ) ||
+					std::max( derivedTL.y, accumMinClip.y ) > std::min( derivedBR.y, accumMaxClip.y );
+				widget->m_outsideClipRegion = outsideClipRegion;
+				m_skipChildren[i] = outsideClipRegion;
+
+				Ogre::Vector2 innerMinClip = derivedTL + widget->m_clipBorderTL * invCanvasSize2x;
+				Ogre::Vector2 innerMaxClip = derivedBR - widget->m_clipBorderBR * invCanvasSize2x;
+				innerMinClip.makeCeil( accumMinClip );
+				innerMaxClip.makeFloor( accumMaxClip );
+				data[InnerClipMinX * numWidgets + i] = innerMinClip.x;
+				data[InnerClipMinY * numWidgets + i] = innerMinClip.y;
+				data[InnerClipMaxX * numWidgets + i] = innerMaxClip.x;
+				data[InnerClipMaxY * numWidgets + i] = innerMaxClip.y;
+			}
+		}
+	}
+}  // namespace Colibri
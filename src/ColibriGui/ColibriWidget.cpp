@@ -3,6 +3,7 @@
 #include "ColibriGui/ColibriWindow.h"
 
 #include "ColibriGui/ColibriManager.h"
+#include "ColibriGui/ColibriHitTestGrid.h"
 
 #define TODO_account_rotation
 
@@ -18,6 +19,57 @@ namespace Colibri
 	};
 
 	const Matrix2x3 Matrix2x3::IDENTITY( 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f );
+	const uint32_t Widget::c_notInRegistry;
+
+	namespace
+	{
+		/// A widget whose z order changed. See Widget::_reorderByZOrder
+		struct ZOrderChange
+		{
+			Widget *widget;
+			/// Number of unchanged widgets that were before 'widget' in the list
+			size_t numUnchangedBefore;
+			/// 'widget' goes right before the unchanged widget at this index
+			size_t insertIdx;
+		};
+
+		bool compareZOrderChange( const ZOrderChange &a, const ZOrderChange &b )
+		{
+			return a.widget->_getZOrderInternal() < b.widget->_getZOrderInternal();
+		}
+
+		bool zOrderLessThanWidget( uint16_t zOrder, const Widget *widget )
+		{
+			return zOrder < widget->_getZOrderInternal();
+		}
+
+		bool widgetLessThanZOrder( const Widget *widget, uint16_t zOrder )
+		{
+			return widget->_getZOrderInternal() < zOrder;
+		}
+
+		/// widgets[0; numUnchanged) contains the unchanged widgets, and the rest of the list
+		/// is garbage. Inserts the changed widgets at their insertIdx, from back to front
+		/// so that every widget is moved at most once. changes must be sorted by insertIdx
+		template <typename T>
+		void insertZOrderChanges( std::vector<T *> &widgets, size_t numUnchanged,
+								  const std::vector<ZOrderChange> &changes )
+		{
+			size_t dstIdx = widgets.size();
+			size_t srcIdx = numUnchanged;
+
+			std::vector<ZOrderChange>::const_reverse_iterator itor = changes.rbegin();
+			std::vector<ZOrderChange>::const_reverse_iterator endt = changes.rend();
+
+			while( itor != endt )
+			{
+				while( srcIdx > itor->insertIdx )
+					widgets[--dstIdx] = widgets[--srcIdx];
+				widgets[--dstIdx] = static_cast<T *>( itor->widget );
+				++itor;
+			}
+		}
+	}  // namespace
 
 	Widget::Widget( ColibriManager *manager ) :
 		m_parent( 0 ),
@@ -33,6 +85,7 @@ namespace Colibri
 		m_mouseReleaseTriggersPrimaryAction( true ),
 		m_consumesScroll( false ),
 		m_culled( false ),
+		m_outsideClipRegion( false ),
 		m_breadthFirst( false ),
 		m_userId( 0 ),
 		m_currentState( States::Idle ),
@@ -49,7 +102,17 @@ namespace Colibri
 		m_accumMaxClipBR( 1.0f ),
 		m_zOrderDirty( false ),
 		m_zOrderHasDirtyChildren( false ),
-		m_zOrder( _wrapZOrderInternalId( 0 ) )  // WARNING: Relies on virtual calls (won't work right)
+		m_zOrderChanged( false ),
+		m_zOrder( _wrapZOrderInternalId( 0 ) ),  // WARNING: Relies on virtual calls (won't work right)
+		m_pendingTransformDirty( 0u ),
+		m_dirtyWidgetsIdx( c_notInRegistry ),
+		m_transformDirtyQueueIdx( c_notInRegistry ),
+		m_updateWidgetsIdx( c_notInRegistry ),
+		m_labelsIdx( c_notInRegistry ),
+		m_dirtyLabelsIdx( c_notInRegistry ),
+		m_treeBeingDestroyed( false ),
+		m_widgetPool( 0 ),
+		m_hitTestGrid( 0 )
 #if COLIBRIGUI_DEBUG >= COLIBRIGUI_DEBUG_MEDIUM
 		,
 		m_transformOutOfDate( false ),
@@ -64,6 +127,8 @@ namespace Colibri
 	Widget::~Widget()
 	{
 		COLIBRI_ASSERT( m_children.empty() && "_destroy not called before deleting!" );
+		delete m_hitTestGrid;
+		m_hitTestGrid = 0;
 	}
 	//-------------------------------------------------------------------------
 	size_t Widget::notifyParentChildIsDestroyed( Widget *childWidgetBeingRemoved )
@@ -81,6 +146,7 @@ namespace Colibri
 			//It may not be found if we're also in destruction phase
 			retVal = static_cast<size_t>( itor - m_children.begin() );
 			m_children.erase( itor );
+			setHitTestGridDirty();
 
 			COLIBRI_ASSERT( (retVal < m_numWidgets && !childWidgetBeingRemoved->isWindow()) ||
 							(retVal >= m_numWidgets && childWidgetBeingRemoved->isWindow()) );
@@ -247,12 +313,14 @@ namespace Colibri
 			}
 			parent->m_children.insert( parent->m_children.begin() + ptrdiff_t( idx ), this );
 			++parent->m_numWidgets;  // Must be incremented regardless of whether it's a renderable
+			parent->setHitTestGridDirty();
 		}
 		else
 		{
 			parent->m_children.push_back( this );
 		}
 		parent->setWidgetNavigationDirty();
+		m_manager->_setTransformLayoutDirty();
 		setTransformDirty( TransformDirtyPosition | TransformDirtyOrientation );
 	}
 	//-------------------------------------------------------------------------
@@ -672,35 +740,56 @@ namespace Colibri
 		if( retVal.widget || ( retVal.window && retVal.window->getClickable() ) )
 			return retVal;
 
-		if( !this->intersects( newPosNdc ) )
+		// If we can't be seen, don't look at our widgets; their transforms may be out of date.
+		// (Our child windows aren't clipped to us, that's why they were still checked above)
+		if( m_outsideClipRegion || !this->intersects( newPosNdc ) )
 			return FocusPair();
 
 		Ogre::Vector2 currentScroll = getCurrentScroll();
 
-		WidgetVec::const_iterator itor = m_children.begin();
-		WidgetVec::const_iterator endt = m_children.begin() + ptrdiff_t( m_numWidgets );
+		// The last child (i.e. topmost) that is hit wins, thus go backwards and stop at the first
+		if( m_numWidgets < HitTestGrid::c_minChildrenForGrid )
+		{
+			WidgetVec::const_reverse_iterator ritor =
+				m_children.rbegin() + ptrdiff_t( m_children.size() - m_numWidgets );
+			WidgetVec::const_reverse_iterator rendt = m_children.rend();
 
-		while( itor != endt )
+			while( ritor != rendt &&
+				   !setIdleCursorMovedOnChild( *ritor, newPosNdc, currentScroll, retVal ) )
+			{
+				++ritor;
+			}
+		}
+		else
 		{
-			Widget *widget = *itor;
-			if( ( widget->m_clickable || widget->m_childrenClickable ) &&  //
-				!widget->isDisabled() &&                                   //
-				!widget->isHidden() &&                                     //
-				this->intersectsChild( widget, currentScroll ) &&          //
-				widget->intersects( newPosNdc ) )
+			if( !m_hitTestGrid )
+				m_hitTestGrid = new HitTestGrid();
+			m_hitTestGrid->update( m_children, m_numWidgets );
+
+			// Bring the cursor to the space our children's m_position is in
+			const Ogre::Vector2 localPos =
+				( newPosNdc - m_derivedTopLeft ) / m_manager->getInvCanvasSize2x() -
+				m_clipBorderTL + currentScroll;
+
+			const uint32_t *cellBegin, *cellEnd;
+			m_hitTestGrid->queryCell( localPos, cellBegin, cellEnd );
+			const std::vector<uint32_t> &bigEntries = m_hitTestGrid->getBigEntries();
+			const uint32_t *bigBegin = bigEntries.data();
+			const uint32_t *bigEnd = bigEntries.data() + bigEntries.size();
+
+			// Both lists are sorted. Merge them backwards
+			bool bFound = false;
+			while( !bFound && ( cellBegin != cellEnd || bigBegin != bigEnd ) )
 			{
-				if( widget->m_clickable )
-					retVal.widget = widget;
+				uint32_t childIdx;
+				if( bigBegin == bigEnd || ( cellBegin != cellEnd && *( cellEnd - 1 ) > *( bigEnd - 1 ) ) )
+					childIdx = *--cellEnd;
+				else
+					childIdx = *--bigEnd;
 
-				if( widget->m_childrenClickable )
-				{
-					FocusPair childFocusPair;
-					childFocusPair = widget->_setIdleCursorMoved( newPosNdc );
-					if( childFocusPair.widget )
-						retVal = childFocusPair;
-				}
+				bFound = setIdleCursorMovedOnChild( m_children[childIdx], newPosNdc, currentScroll,
+													retVal );
 			}
-			++itor;
 		}
 
 		retVal.window = getFirstParentWindow();
@@ -708,54 +797,75 @@ namespace Colibri
 		return retVal;
 	}
 	//-------------------------------------------------------------------------
-	void Widget::notifyCursorMoved( const Ogre::Vector2& posNDC )
+	bool Widget::setIdleCursorMovedOnChild( Widget *child, const Ogre::Vector2 &newPosNdc,
+											const Ogre::Vector2 &currentScroll,
+											FocusPair &outFocusPair )
 	{
+		if( ( child->m_clickable || child->m_childrenClickable ) &&  //
+			!child->isDisabled() &&                                  //
+			!child->isHidden() &&                                    //
+			!child->m_outsideClipRegion &&                           //
+			this->intersectsChild( child, currentScroll ) &&         //
+			child->intersects( newPosNdc ) )
+		{
+			// Our grandchildren are on top of child
+			if( child->m_childrenClickable )
+			{
+				const FocusPair childFocusPair = child->_setIdleCursorMoved( newPosNdc );
+				if( childFocusPair.widget )
+				{
+					outFocusPair = childFocusPair;
+					return true;
+				}
+			}
+
+			if( child->m_clickable )
+			{
+				outFocusPair.widget = child;
+				return true;
+			}
+		}
+
+		return false;
 	}
 	//-------------------------------------------------------------------------
-	void Widget::broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao )
+	void Widget::setHitTestGridDirty()
 	{
-		WidgetVec::const_iterator itor = m_children.begin();
-		WidgetVec::const_iterator end  = m_children.end();
-
-		while( itor != end )
-		{
-			(*itor)->broadcastNewVao( vao, textVao );
-			++itor;
-		}
+		if( m_hitTestGrid )
+			m_hitTestGrid->setDirty();
 	}
 	//-------------------------------------------------------------------------
-	void Widget::_updateDerivedTransformOnly( const Ogre::Vector2 &parentPos,
-											  const Matrix2x3 &parentRot )
+	void Widget::notifyCursorMoved( const Ogre::Vector2& posNDC )
+	{
+	}
+	//-------------------------------------------------------------------------
+	void Widget::broadcastNewVao( Ogre::VertexArrayObject *vao, Ogre::VertexArrayObject *textVao,
+								  Ogre::VertexArrayObject *nineSliceVao )
 	{
-		updateDerivedTransform( parentPos, parentRot );
-
-		const Ogre::Vector2 invCanvasSize2x	= m_manager->getInvCanvasSize2x();
-		const Ogre::Vector2 outerTopLeft	= this->m_derivedTopLeft;
-		const Ogre::Vector2 outerTopLeftWithClipping = outerTopLeft + m_clipBorderTL * invCanvasSize2x;
-
-		const Matrix2x3 &finalRot = this->m_derivedOrientation;
 		WidgetVec::const_iterator itor = m_children.begin();
 		WidgetVec::const_iterator end  = m_children.end();
 
 		while( itor != end )
 		{
-			(*itor)->_updateDerivedTransformOnly( outerTopLeftWithClipping, finalRot );
+			(*itor)->broadcastNewVao( vao, textVao, nineSliceVao );
 			++itor;
 		}
 	}
 	//-------------------------------------------------------------------------
 	void Widget::_fillBuffersAndCommands( UiVertex ** RESTRICT_ALIAS vertexBuffer,
 										  GlyphVertex ** RESTRICT_ALIAS textVertBuffer,
+										  NineSliceRecord ** RESTRICT_ALIAS nineSliceBuffer,
 										  const Ogre::Vector2 &parentPos,
 										  const Ogre::Vector2 &parentCurrentScrollPos,
 										  const Matrix2x3 &parentRot )
 	{
-		updateDerivedTransform( parentPos, parentRot );
-
 		m_culled = true;
 
-		if( !m_parent->intersectsChild( this, parentCurrentScrollPos ) || m_hidden )
+		if( !m_parent->intersectsChild( this, parentCurrentScrollPos ) || m_hidden ||
+			m_outsideClipRegion )
+		{
 			return;
+		}
 
 		m_culled = false;
 
@@ -782,7 +892,7 @@ namespace Colibri
 
 		while( itor != end )
 		{
-			(*itor)->_fillBuffersAndCommands( vertexBuffer, textVertBuffer,
+			(*itor)->_fillBuffersAndCommands( vertexBuffer, textVertBuffer, nineSliceBuffer,
 											  outerTopLeftWithClipping, currentScrollPos,
 											  m_derivedOrientation );
 			++itor;
@@ -952,13 +1062,19 @@ namespace Colibri
 #if COLIBRIGUI_DEBUG >= COLIBRIGUI_DEBUG_MEDIUM
 		m_transformOutOfDate = true;
 #endif
-		WidgetVec::const_iterator itor = m_children.begin();
-		WidgetVec::const_iterator end  = m_children.end();
+		// Our parent's grid is built from our local transform, which
+		// doesn't change when it's our parent the one who changed
+		if( m_parent && ( dirtyReason & ( TransformDirtyPosition | TransformDirtyScale ) ) &&
+			( !( dirtyReason & TransformDirtyParentCaller ) || dirtyReason == TransformDirtyAll ) )
+		{
+			m_parent->setHitTestGridDirty();
+		}
 
-		while( itor != end )
+		if( !m_children.empty() )
 		{
-			(*itor)->setTransformDirty( TransformDirtyParentCaller | dirtyReason );
-			++itor;
+			if( !m_pendingTransformDirty )
+				m_manager->_queueTransformDirty( this );
+			m_pendingTransformDirty |= dirtyReason | TransformDirtyParentCaller;
 		}
 
 		m_manager->_setWidgetTransformsDirty();
@@ -993,6 +1109,7 @@ namespace Colibri
 		}
 
 		m_zOrder = _wrapZOrderInternalId( z );
+		m_zOrderChanged = true;
 		notifyZOrderChildWindowIsDirty( true );
 		//The above function sets this to true in the case of recursive calls up the tree.
 		//However from here we know no children should be set as dirty, so set it back to false.
@@ -1031,7 +1148,8 @@ namespace Colibri
 	{
 		if( widgetInListDirty )
 		{
-			std::stable_sort( widgets.begin(), widgets.end(), _compareWidgetZOrder );
+			_reorderByZOrder( widgets );
+			setHitTestGridDirty();
 		}
 
 		WidgetVec::iterator itor = widgets.begin();
@@ -1057,6 +1175,76 @@ namespace Colibri
 		}
 	}
 	//-------------------------------------------------------------------------
+	template <typename T>
+	void Widget::_reorderByZOrder( std::vector<T *> &widgets )
+	{
+		std::vector<ZOrderChange> changes;
+
+		// Pull out the widgets that changed, leaving the unchanged ones
+		// (which should still be sorted) at the front
+		const size_t numWidgets = widgets.size();
+		size_t numUnchanged = 0u;
+		uint16_t prevZOrder = 0u;
+		bool unchangedAreSorted = true;
+
+		for( size_t i = 0u; i < numWidgets; ++i )
+		{
+			T *widget = widgets[i];
+			if( widget->m_zOrderChanged )
+			{
+				widget->m_zOrderChanged = false;
+				const ZOrderChange change = { widget, numUnchanged, numUnchanged };
+				changes.push_back( change );
+			}
+			else
+			{
+				const uint16_t zOrder = widget->_getZOrderInternal();
+				if( zOrder < prevZOrder )
+					unchangedAreSorted = false;
+				prevZOrder = zOrder;
+				widgets[numUnchanged++] = widget;
+			}
+		}
+
+		if( !unchangedAreSorted )
+		{
+			// Put the list back the way it was, and sort everything
+			insertZOrderChanges( widgets, numUnchanged, changes );
+			std::stable_sort( widgets.begin(), widgets.end(), _compareWidgetZOrder );
+			return;
+		}
+
+		// Widgets that changed to the same z order keep their relative order
+		std::stable_sort( changes.begin(), changes.end(), compareZOrderChange );
+
+		typename std::vector<T *>::const_iterator unchangedBegin = widgets.begin();
+		typename std::vector<T *>::const_iterator unchangedEnd =
+			widgets.begin() + ptrdiff_t( numUnchanged );
+
+		std::vector<ZOrderChange>::iterator itor = changes.begin();
+		std::vector<ZOrderChange>::iterator endt = changes.end();
+
+		while( itor != endt )
+		{
+			// Among the unchanged widgets with the same z order, go after the ones that were
+			// before us and before the ones that were after us. Like std::stable_sort would
+			const uint16_t zOrder = itor->widget->_getZOrderInternal();
+			const size_t lowerIdx = size_t(
+				std::lower_bound( unchangedBegin, unchangedEnd, zOrder, widgetLessThanZOrder ) -
+				unchangedBegin );
+			const size_t upperIdx = size_t(
+				std::upper_bound( unchangedBegin, unchangedEnd, zOrder, zOrderLessThanWidget ) -
+				unchangedBegin );
+			itor->insertIdx = std::min( std::max( itor->numUnchangedBefore, lowerIdx ), upperIdx );
+			++itor;
+		}
+
+		insertZOrderChanges( widgets, numUnchanged, changes );
+	}
+	//-------------------------------------------------------------------------
+	template void Widget::_reorderByZOrder<Widget>( WidgetVec &widgets );
+	template void Widget::_reorderByZOrder<Window>( WindowVec &widgets );
+	//-------------------------------------------------------------------------
 	void Widget::updateZOrderDirty()
 	{
 		reorderWidgetVec( getZOrderDirty(), m_children );
@@ -0,0 +1,87 @@
+
+#include "ColibriGui/ColibriWidgetPool.h"
+
+#include "OgreMemoryAllocatorConfig.h"
+
+
+namespace Colibri
+{
+	const size_t WidgetPool::c_alignment;
+	const size_t WidgetPool::c_minObjectsPerSlab;
+	//-------------------------------------------------------------------------
+	WidgetPool::WidgetPool( size_t objectSize ) :
+		m_objectSize( calculateObjectSize( objectSize ) ),
+		m_freeList( 0 ),
+		m_numFree( 0u ),
+		m_numAllocated( 0u )
+	{
+	}
+	//-------------------------------------------------------------------------
+	WidgetPool::~WidgetPool()
+	{
+		COLIBRI_ASSERT_LOW( !m_numAllocated && "Destroying a WidgetPool with live widgets!" );
+
+		std::vector<void *>::const_iterator itor = m_slabs.begin();
+		std::vector<void *>::const_iterator endt = m_slabs.end();
+
+		while( itor != endt )
+		{
+			OGRE_FREE_SIMD( *itor, Ogre::MEMCATEGORY_GENERAL );
+			++itor;
+		}
+
+		m_slabs.clear();
+	}
+	//-------------------------------------------------------------------------
+	size_t WidgetPool::calculateObjectSize( size_t sizeBytes )
+	{
+		return ( ( sizeBytes + c_alignment - 1u ) / c_alignment ) * c_alignment;
+	}
+	//-------------------------------------------------------------------------
+	void WidgetPool::addSlab( size_t numObjects )
+	{
+		uint8_t *slab = reinterpret_cast<uint8_t *>(
+			OGRE_MALLOC_SIMD( numObjects * m_objectSize, Ogre::MEMCATEGORY_GENERAL ) );
+		m_slabs.push_back( slab );
+
+		// Push backwards so that consecutive allocations are also consecutive in memory
+		for( size_t i = numObjects; i--; )
+		{
+			void *slot = slab + i * m_objectSize;
+			*reinterpret_cast<void **>( slot ) = m_freeList;
+			m_freeList = slot;
+		}
+
+		m_numFree += numObjects;
+	}
+	//-------------------------------------------------------------------------
+	void WidgetPool::reserve( size_t numObjects )
+	{
+		if( numObjects > m_numFree )
+			addSlab( numObjects - m_numFree );
+	}
+	//-------------------------------------------------------------------------
+	void *WidgetPool::allocate()
+	{
+		if( !m_freeList )
+		{
+			// Grow geometrically so that the number of slabs stays low
+			addSlab( m_numAllocated > c_minObjectsPerSlab ? m_numAllocated : c_minObjectsPerSlab );
+		}
+
+		void *retVal = m_freeList;
+		m_freeList = *reinterpret_cast<void **>( retVal );
+		--m_numFree;
+		++m_numAllocated;
+		return retVal;
+	}
+	//-------------------------------------------------------------------------
+	void WidgetPool::deallocate( void *ptr )
+	{
+		COLIBRI_ASSERT_LOW( m_numAllocated > 0u );
+		*reinterpret_cast<void **>( ptr ) = m_freeList;
+		m_freeList = ptr;
+		++m_numFree;
+		--m_numAllocated;
+	}
+}  // namespace Colibri
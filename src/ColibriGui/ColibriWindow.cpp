@@ -66,19 +66,22 @@ namespace Colibri
 
 		if( m_parent )
 		{
-			// Remove ourselves from being our Window parent's child
+			// Remove ourselves from being our Window parent's child.
+			// We may not be found if our parent is also being destroyed
 			Window *parentWindow = getParentAsWindow();
 			{
 				WindowVec::iterator itor = std::find( parentWindow->m_childWindows.begin(),
 													  parentWindow->m_childWindows.end(), this );
-				parentWindow->m_childWindows.erase( itor );
+				if( itor != parentWindow->m_childWindows.end() )
+					parentWindow->m_childWindows.erase( itor );
 			}
 			{
 				WidgetVec::iterator itor =
 					std::find( parentWindow->m_children.begin() +
 								   ptrdiff_t( parentWindow->getOffsetStartWindowChildren() ),
 							   parentWindow->m_children.end(), this );
-				parentWindow->m_children.erase( itor );
+				if( itor != parentWindow->m_children.end() )
+					parentWindow->m_children.erase( itor );
 			}
 		}
 
@@ -86,14 +89,17 @@ namespace Colibri
 			COLIBRI_ASSERT( m_childWindows.size() ==
 							( m_children.size() - getOffsetStartWindowChildren() ) );
 
-			WindowVec childWindowsCopy = m_childWindows;
-			WindowVec::const_iterator itor = childWindowsCopy.begin();
-			WindowVec::const_iterator end = childWindowsCopy.end();
+			// Detach the child windows first (like Widget::_destroy does with its children)
+			// so they don't search & erase themselves one by one from our lists
+			WindowVec childWindows;
+			childWindows.swap( m_childWindows );
+			m_children.resize( getOffsetStartWindowChildren() );
+
+			WindowVec::const_iterator itor = childWindows.begin();
+			WindowVec::const_iterator end = childWindows.end();
 
 			while( itor != end )
 				m_manager->destroyWindow( *itor++ );
-
-			m_childWindows.clear();
 		}
 
 		Renderable::_destroy();
@@ -425,9 +431,21 @@ namespace Colibri
 	{
 		Widget::reorderWidgetVec( widgetInListDirty, widgets );
 		// Sort the windows as well as the widgets to keep them in the same order.
+		// They're already sorted at the end of m_children, so just copy them.
 		if( widgetInListDirty )
 		{
-			std::stable_sort( m_childWindows.begin(), m_childWindows.end(), _compareWidgetZOrder );
+			COLIBRI_ASSERT_LOW( m_childWindows.size() == m_children.size() - m_numWidgets );
+
+			WidgetVec::const_iterator itor = m_children.begin() + ptrdiff_t( m_numWidgets );
+			WidgetVec::const_iterator endt = m_children.end();
+			WindowVec::iterator itWindow = m_childWindows.begin();
+
+			while( itor != endt )
+			{
+				COLIBRI_ASSERT_HIGH( ( *itor )->isWindow() );
+				*itWindow++ = static_cast<Window *>( *itor );
+				++itor;
+			}
 		}
 	}
 	//-------------------------------------------------------------------------
@@ -477,6 +495,7 @@ namespace Colibri
 		{
 			m_childWindows.erase( itor );
 			window->m_parent = 0;
+			m_manager->_setTransformLayoutDirty();
 
 			WidgetVec::iterator itWidget =
 				std::find( m_children.begin() + ptrdiff_t( m_numWidgets ), m_children.end(), window );
@@ -557,34 +576,38 @@ namespace Colibri
 		return retVal;
 	}
 	//-------------------------------------------------------------------------
-	void Window::_updateDerivedTransformOnly( const Ogre::Vector2 &parentPos,
-											  const Matrix2x3 &parentRot )
-	{
-		updateDerivedTransform( parentPos, parentRot );
-
-		const Ogre::Vector2 invCanvasSize2x = m_manager->getInvCanvasSize2x();
-		const Ogre::Vector2 outerTopLeft = this->m_derivedTopLeft;
-		const Ogre::Vector2 outerTopLeftWithClipping =
-			outerTopLeft + ( m_clipBorderTL - m_currentScroll ) * invCanvasSize2x;
-
-		const Matrix2x3 &finalRot = this->m_derivedOrientation;
-		WidgetVec::const_iterator itor = m_children.begin();
-		WidgetVec::const_iterator end = m_children.end();
-
-		while( itor != end )
-		{
-			( *itor )->_updateDerivedTransformOnly( outerTopLeftWithClipping, finalRot );
-			++itor;
-		}
-	}
-	//-------------------------------------------------------------------------
 	void Window::_fillBuffersAndCommands( UiVertex **RESTRICT_ALIAS vertexBuffer,
 										  GlyphVertex **RESTRICT_ALIAS textVertBuffer,
+										  NineSliceRecord **RESTRICT_ALIAS nineSliceBuffer,
 										  const Ogre::Vector2 &parentPos,
 										  const Ogre::Vector2 &parentCurrentScrollPos,
 										  const Matrix2x3 &parentRot )
 	{
-		Renderable::_fillBuffersAndCommands( vertexBuffer, textVertBuffer, parentPos,
+		if( colibri_unlikely( m_outsideClipRegion ) )
+		{
+			// We can't be seen, but our child windows aren't clipped to us and may still be
+			m_culled = true;
+			if( m_hidden || ( m_parent && !m_parent->intersectsChild( this, parentCurrentScrollPos ) ) )
+				return;
+
+			const Ogre::Vector2 outerTopLeftWithClipping =
+				m_derivedTopLeft +
+				( m_clipBorderTL - m_currentScroll ) * m_manager->getInvCanvasSize2x();
+
+			WidgetVec::const_iterator itor = m_children.begin() + ptrdiff_t( m_numWidgets );
+			WidgetVec::const_iterator endt = m_children.end();
+
+			while( itor != endt )
+			{
+				( *itor )->_fillBuffersAndCommands( vertexBuffer, textVertBuffer, nineSliceBuffer,
+													outerTopLeftWithClipping, m_currentScroll,
+													m_derivedOrientation );
+				++itor;
+			}
+			return;
+		}
+
+		Renderable::_fillBuffersAndCommands( vertexBuffer, textVertBuffer, nineSliceBuffer, parentPos,
 											 parentCurrentScrollPos, parentRot, m_currentScroll, true );
 	}
 }  // namespace Colibri
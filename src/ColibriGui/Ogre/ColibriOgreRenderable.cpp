@@ -1,10 +1,16 @@
 
 #include "ColibriGui/Ogre/ColibriOgreRenderable.h"
 #include "ColibriGui/ColibriManager.h"
+#include "ColibriGui/Ogre/OgreHlmsColibri.h"
 
 #include "OgreSceneManager.h"
 #include "Vao/OgreVaoManager.h"
+#include "Vao/OgreIndexBufferPacked.h"
 #include "Vao/OgreVertexArrayObject.h"
+#include "Vao/OgreTexBufferPacked.h"
+#if OGRE_VERSION >= OGRE_MAKE_VERSION( 2, 3, 0 )
+#	include "Vao/OgreReadOnlyBufferPacked.h"
+#endif
 
 namespace Ogre
 {
@@ -12,7 +18,11 @@ namespace Ogre
 												  SceneManager *manager, uint8 renderQueueId,
 												  Colibri::ColibriManager *colibriManager ) :
 		MovableObject( id, objectMemoryManager, manager, renderQueueId ),
-		Renderable()
+		Renderable(),
+		mCachedHlmsCache( 0 ),
+		mCachedPassHash( 0u ),
+		mCachedHlmsHash( 0u ),
+		mCachedShaderCacheGeneration( 0u )
 	{
 		//Set the bounds!!! Very important! If you don't set it, the object will not
 		//appear on screen as it will always fail the frustum culling.
@@ -35,7 +45,7 @@ namespace Ogre
 		//that belong to this MovableObject.
 		mRenderables.push_back( this );
 
-		setVao( colibriManager->getVao() );
+		setVao( colibriManager->getNineSliceVao() );
 
 		//If we don't set a datablock, we'll crash Ogre.
 //		this->setDatablock( Root::getSingleton().getHlmsManager()->
@@ -53,97 +63,69 @@ namespace Ogre
 	{
 	}
 	//-----------------------------------------------------------------------------------
-	/*Ogre::IndexBufferPacked* ColibriOgreRenderable::createIndexBuffer( VaoManager *vaoManager )
+	IndexBufferPacked* ColibriOgreRenderable::createQuadIndexBuffer( uint32 numQuads,
+																	 VaoManager *vaoManager )
 	{
-		//6 indices per quad (3 indices per triangle)
-		//3x3 grid = 9 quads => 6 x 9 indices per widget.
+		//6 indices per quad (3 indices per triangle), 4 unique vertices per quad.
+		//Both 9-slice widgets (9 quads each, one after the other) and glyphs use it.
 		//Vertices are expected to be layed out like this:
-		//	 0, 1,		 2, 3,
-		//	 4, 5,		 6, 7,
+		//	0	3
+		//	x---x
+		//	| \ |
+		//	x---x
+		//	1	2
 		//
+		//Quads can't share vertices with their neighbours because each cell of a
+		//9-slice may have arbitrary UVs. See StateInformation::uvTopLeftBottomRight
 		//
-		//	 8, 9,		10,11,
-		//	12,13		14,15
-		//
-		//	x-x------x-x
-		//	| |		 | |
-		//	x-x------x-x
-		//	| |      | |
-		//	| |      | |
-		//	| |      | |
-		//	x-x------x-x
-		//	| |		 | |
-		//	x-x------x-x
-		// maxVerticesPerBuffer = 4096; which means we support up to 4096 widgets per Window.
-		// And this precomputed buffer requires 432kb
-		const size_t verticesPerQuad		= 16u;
-		const size_t maxVerticesPerBuffer	= 65536u / verticesPerQuad;
-		const size_t numIndices = maxVerticesPerBuffer * 6u * 9u;
-		uint16 *indices = reinterpret_cast<uint16*>( OGRE_MALLOC_SIMD( sizeof(uint16) * numIndices,
+		//The whole buffer is needed for a single draw, thus it must use 32-bit indices
+		//if there are more than 16384 quads; we always use them to keep it simple.
+		const size_t numIndices = numQuads * 6u;
+		uint32 *indices = reinterpret_cast<uint32*>( OGRE_MALLOC_SIMD( sizeof(uint32) * numIndices,
 																	   MEMCATEGORY_GEOMETRY ) );
-		for( size_t i=0; i<numIndices; i += (6u * 9u) )
+		for( uint32 i=0; i<numQuads; ++i )
 		{
-			//Perform top, then center, then bottom rows
-			for( size_t j=0; j<3u; ++j )
-			{
-				const size_t dstIdx = i + j * 18u;
-				const size_t srcIdx = i + j * 4u;
-				//Left column's quad
-				indices[dstIdx +  0u] = srcIdx + 0u;
-				indices[dstIdx +  1u] = srcIdx + 4u;
-				indices[dstIdx +  2u] = srcIdx + 5u;
-
-				indices[dstIdx +  3u] = srcIdx + 5u;
-				indices[dstIdx +  4u] = srcIdx + 1u;
-				indices[dstIdx +  5u] = srcIdx + 0u;
-
-				//Center column's quad
-				indices[dstIdx +  6u] = srcIdx + 1u;
-				indices[dstIdx +  7u] = srcIdx + 5u;
-				indices[dstIdx +  8u] = srcIdx + 6u;
-
-				indices[dstIdx +  9u] = srcIdx + 6u;
-				indices[dstIdx + 10u] = srcIdx + 2u;
-				indices[dstIdx + 11u] = srcIdx + 1u;
-
-				//Right column's quad
-				indices[dstIdx + 12u] = srcIdx + 2u;
-				indices[dstIdx + 13u] = srcIdx + 6u;
-				indices[dstIdx + 14u] = srcIdx + 7u;
-
-				indices[dstIdx + 15u] = srcIdx + 7u;
-				indices[dstIdx + 16u] = srcIdx + 3u;
-				indices[dstIdx + 17u] = srcIdx + 2u;
-			}
+			const uint32 srcIdx = i * 4u;
+			uint32 *dstIdx = indices + i * 6u;
+			dstIdx[0] = srcIdx + 0u;
+			dstIdx[1] = srcIdx + 1u;
+			dstIdx[2] = srcIdx + 2u;
+
+			dstIdx[3] = srcIdx + 2u;
+			dstIdx[4] = srcIdx + 3u;
+			dstIdx[5] = srcIdx + 0u;
 		}
 
 		IndexBufferPacked *indexBuffer = 0;
 
 		try
 		{
-			indexBuffer = vaoManager->createIndexBuffer( IndexBufferPacked::IT_16BIT,
+			indexBuffer = vaoManager->createIndexBuffer( IndexBufferPacked::IT_32BIT,
 														 numIndices, BT_IMMUTABLE,
-														 indices, true );
+														 indices, false );
 		}
 		catch( Exception &e )
 		{
-			OGRE_FREE_SIMD( indexBuffer, MEMCATEGORY_GEOMETRY );
-			indexBuffer = 0;
+			OGRE_FREE_SIMD( indices, MEMCATEGORY_GEOMETRY );
 			throw e;
 		}
 
+		OGRE_FREE_SIMD( indices, MEMCATEGORY_GEOMETRY );
+
 		return indexBuffer;
-	}*/
+	}
 	//-----------------------------------------------------------------------------------
-	VertexArrayObject* ColibriOgreRenderable::createVao( uint32 vertexCount, VaoManager *vaoManager )
+	VertexArrayObject* ColibriOgreRenderable::createVao( uint32 vertexCount, bool compact,
+														VaoManager *vaoManager )
 	{
-		//Vertex declaration
+		//Vertex declaration. HlmsColibri detects the compact format from VET_SHORT2_SNORM
 		VertexElement2Vec vertexElements;
 		vertexElements.reserve( 4 );
-		vertexElements.push_back( VertexElement2( VET_FLOAT2, VES_POSITION ) );
+		vertexElements.push_back( VertexElement2( compact ? VET_SHORT2_SNORM : VET_FLOAT2,
+												  VES_POSITION ) );
 		vertexElements.push_back( VertexElement2( VET_USHORT2_NORM, VES_TEXTURE_COORDINATES ) );
 		vertexElements.push_back( VertexElement2( VET_UBYTE4_NORM, VES_DIFFUSE ) );
-		vertexElements.push_back( VertexElement2( VET_FLOAT4, VES_NORMAL ) );
+		vertexElements.push_back( VertexElement2( compact ? VET_HALF4 : VET_FLOAT4, VES_NORMAL ) );
 
 		//Create the actual vertex buffer.
 		Ogre::VertexBufferPacked *vertexBuffer = 0;
@@ -159,31 +141,91 @@ namespace Ogre
 		return vao;
 	}
 	//-----------------------------------------------------------------------------------
-	VertexArrayObject* ColibriOgreRenderable::createTextVao( uint32 vertexCount, VaoManager *vaoManager )
+	VertexArrayObject* ColibriOgreRenderable::createPulledVao( uint32 vertexCount, bool hasUvs,
+															   IndexBufferPacked *quadIndexBuffer,
+															   VaoManager *vaoManager )
 	{
-		//Vertex declaration
+		//The actual data lives in a record buffer and is fetched by the vertex shader.
+		//This buffer is never written to; it's only here so that the draws have
+		//vertices and the Hlms sees the vertex format it expects.
 		VertexElement2Vec vertexElements;
-		vertexElements.reserve( 5 );
+		vertexElements.reserve( 3 );
 		vertexElements.push_back( VertexElement2( VET_FLOAT2, VES_POSITION ) );
-		vertexElements.push_back( VertexElement2( VET_USHORT2, VES_BLEND_INDICES ) );
-		vertexElements.push_back( VertexElement2( VET_UINT1, VES_TANGENT ) );
+		if( hasUvs )
+			vertexElements.push_back( VertexElement2( VET_USHORT2_NORM, VES_TEXTURE_COORDINATES ) );
 		vertexElements.push_back( VertexElement2( VET_UBYTE4_NORM, VES_DIFFUSE ) );
-		vertexElements.push_back( VertexElement2( VET_FLOAT4, VES_NORMAL ) );
 
-		//Create the actual vertex buffer.
+		const size_t sizeBytes = vertexCount * VaoManager::calculateVertexSize( vertexElements );
+		void *zeroData = OGRE_MALLOC_SIMD( sizeBytes, MEMCATEGORY_GEOMETRY );
+		memset( zeroData, 0, sizeBytes );
+
 		Ogre::VertexBufferPacked *vertexBuffer = 0;
-		vertexBuffer = vaoManager->createVertexBuffer( vertexElements, vertexCount,
-													   BT_DYNAMIC_PERSISTENT,
-													   0, false );
+		try
+		{
+			vertexBuffer = vaoManager->createVertexBuffer( vertexElements, vertexCount, BT_IMMUTABLE,
+														   zeroData, false );
+		}
+		catch( Exception &e )
+		{
+			OGRE_FREE_SIMD( zeroData, MEMCATEGORY_GEOMETRY );
+			throw e;
+		}
+
+		OGRE_FREE_SIMD( zeroData, MEMCATEGORY_GEOMETRY );
 
 		VertexBufferPackedVec vertexBuffers;
 		vertexBuffers.push_back( vertexBuffer );
 		Ogre::VertexArrayObject *vao = vaoManager->createVertexArrayObject(
-					vertexBuffers, 0, OT_TRIANGLE_LIST );
+					vertexBuffers, quadIndexBuffer, OT_TRIANGLE_LIST );
 
 		return vao;
 	}
 	//-----------------------------------------------------------------------------------
+	VertexArrayObject* ColibriOgreRenderable::createTextVao( uint32 vertexCount,
+															 IndexBufferPacked *quadIndexBuffer,
+															 VaoManager *vaoManager )
+	{
+		//See Colibri::GlyphVertex
+		return createPulledVao( vertexCount, false, quadIndexBuffer, vaoManager );
+	}
+	//-----------------------------------------------------------------------------------
+	VertexArrayObject* ColibriOgreRenderable::createNineSliceVao( uint32 vertexCount,
+																  IndexBufferPacked *quadIndexBuffer,
+																  VaoManager *vaoManager )
+	{
+		//See Colibri::NineSliceRecord
+		return createPulledVao( vertexCount, true, quadIndexBuffer, vaoManager );
+	}
+	//-----------------------------------------------------------------------------------
+	BufferPacked* ColibriOgreRenderable::createRecordBuffer( size_t sizeBytes, bool useReadOnlyBuffer,
+															 VaoManager *vaoManager )
+	{
+#if OGRE_VERSION >= OGRE_MAKE_VERSION( 2, 3, 0 )
+		if( useReadOnlyBuffer )
+		{
+			return vaoManager->createReadOnlyBuffer( PFG_RGBA32_UINT, sizeBytes,
+													 BT_DYNAMIC_PERSISTENT, 0, false );
+		}
+#endif
+		return vaoManager->createTexBuffer( PFG_RGBA32_UINT, sizeBytes, BT_DYNAMIC_PERSISTENT,
+											0, false );
+	}
+	//-----------------------------------------------------------------------------------
+	void ColibriOgreRenderable::destroyRecordBuffer( BufferPacked *buffer, VaoManager *vaoManager )
+	{
+		if( buffer->getMappingState() != MS_UNMAPPED )
+			buffer->unmap( UO_UNMAP_ALL );
+
+#if OGRE_VERSION >= OGRE_MAKE_VERSION( 2, 3, 0 )
+		if( buffer->getBufferPackedType() != BP_TYPE_TEX )
+		{
+			vaoManager->destroyReadOnlyBuffer( static_cast<ReadOnlyBufferPacked *>( buffer ) );
+			return;
+		}
+#endif
+		vaoManager->destroyTexBuffer( static_cast<TexBufferPacked *>( buffer ) );
+	}
+	//-----------------------------------------------------------------------------------
 	void ColibriOgreRenderable::destroyVao( VertexArrayObject *vao, VaoManager *vaoManager )
 	{
 		const VertexBufferPackedVec &vertexBuffers = vao->getVertexBuffers();
@@ -198,9 +240,7 @@ namespace Ogre
 			++itBuffers;
 		}
 
-		/* Do not destroy the index buffer. We do not own it.
-		if( vao->getIndexBuffer() )
-			vaoManager->destroyIndexBuffer( vao->getIndexBuffer() );*/
+		//Do not destroy the index buffer. We do not own it. See createQuadIndexBuffer
 		vaoManager->destroyVertexArrayObject( vao );
 	}
 	//-----------------------------------------------------------------------------------
@@ -210,6 +250,29 @@ namespace Ogre
 		mVaoPerLod[1].clear();
 		mVaoPerLod[0].push_back( vao );
 		mVaoPerLod[1].push_back( vao );
+
+		//The new Vao may have a different vertex format
+		mCachedHlmsCache = 0;
+	}
+	//-----------------------------------------------------------------------------------
+	const HlmsCache* ColibriOgreRenderable::getCachedMaterial( HlmsColibri *hlms,
+															   const HlmsCache *lastReturnedValue,
+															   const HlmsCache &passCache,
+															   const QueuedRenderable &queuedRenderable )
+	{
+		//setDatablock changes our hash, so it's covered too
+		if( !mCachedHlmsCache || mCachedPassHash != passCache.hash ||
+			mCachedHlmsHash != getHlmsHash() ||
+			mCachedShaderCacheGeneration != hlms->getShaderCacheGeneration() )
+		{
+			mCachedHlmsCache = hlms->getMaterial( lastReturnedValue, passCache, queuedRenderable,
+												  false );
+			mCachedPassHash = passCache.hash;
+			mCachedHlmsHash = getHlmsHash();
+			mCachedShaderCacheGeneration = hlms->getShaderCacheGeneration();
+		}
+
+		return mCachedHlmsCache;
 	}
 	//-----------------------------------------------------------------------------------
 	const String& ColibriOgreRenderable::getMovableType(void) const
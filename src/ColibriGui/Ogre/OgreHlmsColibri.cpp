@@ -29,6 +29,7 @@ THE SOFTWARE.
 #include "OgreStableHeaders.h"
 
 #include "ColibriGui/ColibriAssert.h"
+#include "ColibriGui/ColibriRenderable.h"
 #include "ColibriGui/Ogre/OgreHlmsColibri.h"
 #include "ColibriGui/Ogre/OgreHlmsColibriDatablock.h"
 #include "OgreUnlitProperty.h"
@@ -52,6 +53,7 @@ THE SOFTWARE.
 #include "OgreRenderQueue.h"
 #include "Compositor/OgreCompositorShadowNode.h"
 #include "Vao/OgreVaoManager.h"
+#include "Vao/OgreVertexArrayObject.h"
 #include "Vao/OgreConstBufferPacked.h"
 #include "Vao/OgreTexBufferPacked.h"
 #include "Vao/OgreStagingBuffer.h"
@@ -72,18 +74,28 @@ namespace Ogre
 
 	HlmsColibri::HlmsColibri( Archive *dataFolder, ArchiveVec *libraryFolders ) :
 		HlmsUnlit( dataFolder, libraryFolders ),
-		mGlyphAtlasBuffer( 0 )
+		mGlyphAtlasBuffer( 0 ),
+		mGlyphRecordBuffer( 0 ),
+		mNineSliceRecordBuffer( 0 ),
+		mBoundGlyphRecordBuffer( 0 ),
+		mBoundNineSliceRecordBuffer( 0 ),
+		mShaderCacheGeneration( 0u )
 	{
-		mTexUnitSlotStart = 3u;
-		mSamplerUnitSlotStart = 3u;
+		mTexUnitSlotStart = 5u;
+		mSamplerUnitSlotStart = 5u;
     }
 	HlmsColibri::HlmsColibri( Archive *dataFolder, ArchiveVec *libraryFolders,
 							  HlmsTypes type, const String &typeName ) :
 		HlmsUnlit( dataFolder, libraryFolders, type, typeName ),
-		mGlyphAtlasBuffer( 0 )
+		mGlyphAtlasBuffer( 0 ),
+		mGlyphRecordBuffer( 0 ),
+		mNineSliceRecordBuffer( 0 ),
+		mBoundGlyphRecordBuffer( 0 ),
+		mBoundNineSliceRecordBuffer( 0 ),
+		mShaderCacheGeneration( 0u )
 	{
-		mTexUnitSlotStart = 3u;
-		mSamplerUnitSlotStart = 3u;
+		mTexUnitSlotStart = 5u;
+		mSamplerUnitSlotStart = 5u;
     }
     //-----------------------------------------------------------------------------------
 	HlmsColibri::~HlmsColibri()
@@ -99,14 +111,30 @@ namespace Ogre
 		{
 			DescBindingRange *descBindingRanges = rootLayout.mDescBindingRanges[0];
 
+			// Slot 2 = glyphAtlas (PS), slot 3 = glyphRecords (VS)
 			if( getProperty( "use_read_only_buffer" ) )
 			{
-				descBindingRanges[DescBindingTypes::ReadOnlyBuffer].end = 3u;
+				descBindingRanges[DescBindingTypes::ReadOnlyBuffer].end = 4u;
 			}
 			else
 			{
 				descBindingRanges[DescBindingTypes::TexBuffer].start = 2u;
-				descBindingRanges[DescBindingTypes::TexBuffer].end = 3u;
+				descBindingRanges[DescBindingTypes::TexBuffer].end = 4u;
+			}
+		}
+		else if( getProperty( "colibri_nine_slice" ) )
+		{
+			DescBindingRange *descBindingRanges = rootLayout.mDescBindingRanges[0];
+
+			// Slot 4 = nineSliceRecords (VS)
+			if( getProperty( "use_read_only_buffer" ) )
+			{
+				descBindingRanges[DescBindingTypes::ReadOnlyBuffer].end = 5u;
+			}
+			else
+			{
+				descBindingRanges[DescBindingTypes::TexBuffer].start = 4u;
+				descBindingRanges[DescBindingTypes::TexBuffer].end = 5u;
 			}
 		}
 	}
@@ -128,6 +156,20 @@ namespace Ogre
 			GpuProgramParametersSharedPtr psParams = retVal->pso.pixelShader->getDefaultParameters();
 			psParams->setNamedConstant( "glyphAtlas", 2 );
 			mRenderSystem->bindGpuProgramParameters( GPT_FRAGMENT_PROGRAM, psParams, GPV_ALL );
+
+			if( !getProperty( "use_read_only_buffer" ) )
+			{
+				GpuProgramParametersSharedPtr vsParams =
+					retVal->pso.vertexShader->getDefaultParameters();
+				vsParams->setNamedConstant( "glyphRecords", 3 );
+				mRenderSystem->bindGpuProgramParameters( GPT_VERTEX_PROGRAM, vsParams, GPV_ALL );
+			}
+		}
+		else if( getProperty( "colibri_nine_slice" ) && !getProperty( "use_read_only_buffer" ) )
+		{
+			GpuProgramParametersSharedPtr vsParams = retVal->pso.vertexShader->getDefaultParameters();
+			vsParams->setNamedConstant( "nineSliceRecords", 4 );
+			mRenderSystem->bindGpuProgramParameters( GPT_VERTEX_PROGRAM, vsParams, GPV_ALL );
 		}
 
 		return retVal;
@@ -159,16 +201,79 @@ namespace Ogre
 			setProperty( "ogre_version", ( OGRE_VERSION_MAJOR * 1000000 + OGRE_VERSION_MINOR * 1000 +
 										   OGRE_VERSION_PATCH ) );
 
+			if( needsReadOnlyBuffer( mRenderSystem->getCapabilities(), mRenderSystem->getVaoManager() ) )
+				setProperty( "use_read_only_buffer", 1 );
+		}
+		else if( customParams.find( 6374 ) != customParams.end() )
+		{
+			// See ColibriOgreRenderable::createVao & ColibriManager::setCompactVertexFormat
+			const VertexArrayObjectArray &vaos = renderable->getVaos( VpNormal );
+			if( !vaos.empty() )
+			{
+				const VertexElement2Vec &vertexElements =
+					vaos[0]->getVertexBuffers()[0]->getVertexElements();
+				if( !vertexElements.empty() && vertexElements[0].mType == VET_SHORT2_SNORM )
+				{
+					setProperty( "colibri_compact_vertices", 1 );
+					// Hlms properties are integers. The scale is a whole number
+					COLIBRI_ASSERT_LOW( Colibri::c_compactPositionScale ==
+										floorf( Colibri::c_compactPositionScale ) );
+					setProperty( "colibri_compact_position_scale",
+								 static_cast<int32>( Colibri::c_compactPositionScale ) );
+				}
+			}
+		}
+		else if( customParams.find( 6372 ) != customParams.end() )
+		{
+			// See Colibri::Renderable::_fillBuffersAndCommands
+			setProperty( "colibri_nine_slice", 1 );
+
 			if( needsReadOnlyBuffer( mRenderSystem->getCapabilities(), mRenderSystem->getVaoManager() ) )
 				setProperty( "use_read_only_buffer", 1 );
 		}
 	}
 	//-----------------------------------------------------------------------------------
+	void HlmsColibri::clearShaderCache()
+	{
+		HlmsUnlit::clearShaderCache();
+		++mShaderCacheGeneration;
+	}
+	//-----------------------------------------------------------------------------------
 	void HlmsColibri::setGlyphAtlasBuffer( BufferPacked *texBuffer )
 	{
 		mGlyphAtlasBuffer = texBuffer;
 	}
 	//-----------------------------------------------------------------------------------
+	void HlmsColibri::setGlyphRecordBuffer( BufferPacked *texBuffer )
+	{
+		mGlyphRecordBuffer = texBuffer;
+	}
+	//-----------------------------------------------------------------------------------
+	void HlmsColibri::setNineSliceRecordBuffer( BufferPacked *texBuffer )
+	{
+		mNineSliceRecordBuffer = texBuffer;
+	}
+	//-----------------------------------------------------------------------------------
+	void HlmsColibri::bindRecordBuffer( CommandBuffer *commandBuffer, uint16 slot,
+										BufferPacked *buffer )
+	{
+		if( !buffer )
+			return;
+
+#if OGRE_VERSION >= OGRE_MAKE_VERSION( 2, 3, 0 )
+		if( buffer->getBufferPackedType() != Ogre::BP_TYPE_TEX )
+		{
+			*commandBuffer->addCommand<CbShaderBuffer>() = CbShaderBuffer(
+				VertexShader, slot, static_cast<Ogre::ReadOnlyBufferPacked *>( buffer ), 0, 0 );
+		}
+		else
+#endif
+		{
+			*commandBuffer->addCommand<CbShaderBuffer>() = CbShaderBuffer(
+				VertexShader, slot, static_cast<Ogre::TexBufferPacked *>( buffer ), 0, 0 );
+		}
+	}
+	//-----------------------------------------------------------------------------------
 	bool HlmsColibri::needsReadOnlyBuffer( const RenderSystemCapabilities *caps,
 										   const VaoManager *vaoManager )
 	{
@@ -193,12 +298,16 @@ namespace Ogre
 	uint32 HlmsColibri::fillBuffersForColibri( const HlmsCache *cache,
 											   const QueuedRenderable &queuedRenderable,
 											   bool casterPass, uint32 baseVertex,
-											   uint32 lastCacheHash,
+											   uint32 recordStart, uint32 lastCacheHash,
 											   CommandBuffer *commandBuffer )
 	{
 		COLIBRI_ASSERT_HIGH( getProperty( cache->setProperties,
 										  HlmsBaseProp::GlobalClipPlanes ) == 0 &&
 							 "Clipping planes not supported! Generated shader may be buggy!" );
+		// worldMaterialIdx.y holds recordStart instead of the shadow constant bias
+		COLIBRI_ASSERT( !casterPass && "UI can't be rendered in caster passes" );
+		// Slots 3 & 4 belong to the record buffers. See the slot layout in HlmsColibri's docs
+		COLIBRI_ASSERT_LOW( mTexUnitSlotStart >= 5u && mSamplerUnitSlotStart >= 5u );
 
 		assert( dynamic_cast<const HlmsColibriDatablock*>( queuedRenderable.renderable->getDatablock() ) );
 		const HlmsColibriDatablock *datablock = static_cast<const HlmsColibriDatablock*>(
@@ -248,6 +357,10 @@ namespace Ogre
 				}
 			}
 
+			//Bound below
+			mBoundGlyphRecordBuffer = 0;
+			mBoundNineSliceRecordBuffer = 0;
+
             rebindTexBuffer( commandBuffer );
 
 #if OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR <= 2
@@ -257,6 +370,20 @@ namespace Ogre
 #endif
         }
 
+		//The record buffers are split in chunks, the draw may read from another one
+		//layout(binding = 3) uniform usamplerBuffer glyphRecords
+		if( mGlyphRecordBuffer != mBoundGlyphRecordBuffer )
+		{
+			bindRecordBuffer( commandBuffer, 3u, mGlyphRecordBuffer );
+			mBoundGlyphRecordBuffer = mGlyphRecordBuffer;
+		}
+		//layout(binding = 4) uniform usamplerBuffer nineSliceRecords
+		if( mNineSliceRecordBuffer != mBoundNineSliceRecordBuffer )
+		{
+			bindRecordBuffer( commandBuffer, 4u, mNineSliceRecordBuffer );
+			mBoundNineSliceRecordBuffer = mNineSliceRecordBuffer;
+		}
+
         //Don't bind the material buffer on caster passes (important to keep
         //MDI & auto-instancing running on shadow map passes)
         if( mLastBoundPool != datablock->getAssignedPool() && !casterPass )
@@ -308,8 +435,9 @@ namespace Ogre
 
         //uint materialIdx[]
         *currentMappedConstBuffer = datablock->getAssignedSlot();
-        *reinterpret_cast<float * RESTRICT_ALIAS>( currentMappedConstBuffer+1 ) = datablock->
-                                                                                    mShadowConstantBias;
+		// We never render in caster passes, so the shadow bias slot is free to hold
+		// where this draw's glyph or 9-slice records start
+		*(currentMappedConstBuffer+1) = recordStart;
         *(currentMappedConstBuffer+2) = useIdentityProjection;
 		*(currentMappedConstBuffer+3) = baseVertex;
         currentMappedConstBuffer += 4;
@@ -12,6 +12,7 @@
 
 #include "hb-ft.h"
 
+#include "unicode/uchar.h"
 #include "utf16.h"
 #include "uscript.h"
 
@@ -45,6 +46,15 @@ namespace Colibri
 		return -1;
 	}
 
+	/// Returns true if the codepoint is a mark or format character (e.g. ZWJ)
+	/// that should be shaped with the same font as the preceding character
+	static bool isClusterContinuation( UChar32 codepoint )
+	{
+		const int8_t charType = u_charType( codepoint );
+		return charType == U_NON_SPACING_MARK || charType == U_ENCLOSING_MARK ||
+			   charType == U_COMBINING_SPACING_MARK || charType == U_FORMAT_CHAR;
+	}
+
 	static const hb_tag_t KernTag = HB_TAG('k', 'e', 'r', 'n'); // kerning operations
 	static const hb_tag_t LigaTag = HB_TAG('l', 'i', 'g', 'a'); // standard ligature substitution
 	static const hb_tag_t CligTag = HB_TAG('c', 'l', 'i', 'g'); // contextual ligature substitution
@@ -56,17 +66,49 @@ namespace Colibri
 	const hb_feature_t Shaper::CligOff     = { CligTag, 0, 0, std::numeric_limits<unsigned int>::max() };
 	const hb_feature_t Shaper::CligOn      = { CligTag, 1, 0, std::numeric_limits<unsigned int>::max() };
 
+	const size_t Shaper::c_maxCachedFontSizes = 8u;
+
 	Shaper::Shaper( hb_script_t script, const char *fontLocation, const std::string &language,
 					ShaperManager *shaperManager ) :
 		m_script( script ),
 		m_ftFont( 0 ),
 		m_hbFont( 0 ),
 		m_buffer( 0 ),
+		m_sizedFontsLruCounter( 0u ),
 		m_library( shaperManager->getFreeTypeLibrary() ),
 		m_shaperManager( shaperManager ),
 		m_ptSize( 0u ),
 		m_fontIdx(
-			std::max<uint16_t>( static_cast<uint16_t>( shaperManager->getShapers().size() ), 1u ) )
+			std::max<uint16_t>( static_cast<uint16_t>( shaperManager->getShapers().size() ), 1u ) ),
+		m_threadIdx( 0u ),
+		m_fontLocation( fontLocation ),
+		m_language( language )
+	{
+		openFace( fontLocation );
+	}
+	//-------------------------------------------------------------------------
+	Shaper::Shaper( const Shaper &source, uint16_t threadIdx ) :
+		m_script( source.m_script ),
+		m_ftFont( 0 ),
+		m_hbFont( 0 ),
+		m_buffer( 0 ),
+		m_sizedFontsLruCounter( 0u ),
+		m_coveragePages( source.m_coveragePages ),
+		m_coverageBits( source.m_coverageBits ),
+		m_features( source.m_features ),
+		m_library( source.m_library ),
+		m_shaperManager( source.m_shaperManager ),
+		m_ptSize( 0u ),
+		m_fontIdx( source.m_fontIdx ),
+		m_threadIdx( threadIdx ),
+		m_fontLocation( source.m_fontLocation ),
+		m_language( source.m_language )
+	{
+		COLIBRI_ASSERT_LOW( threadIdx > 0u );
+		openFace( m_fontLocation.c_str() );
+	}
+	//-------------------------------------------------------------------------
+	void Shaper::openFace( const char *fontLocation )
 	{
 #ifndef __ANDROID__
 		FT_Error errorCode = FT_New_Face( m_library, fontLocation, 0, &m_ftFont );
@@ -106,20 +148,32 @@ namespace Colibri
 			log->log( errorMsg.c_str(), LogSeverity::Fatal );
 		}
 
-		setFontSize( FontSize( 24.0f ) );
 		force_ucs2_charmap( m_ftFont );
+		setFontSize( FontSize( 24.0f ) );
 
-		m_hbFont = hb_ft_font_create( m_ftFont, NULL );
 		m_buffer = hb_buffer_create();
 
-		m_hbLanguage = hb_language_from_string( language.c_str(), static_cast<int>( language.size() ) );
+		m_hbLanguage =
+			hb_language_from_string( m_language.c_str(), static_cast<int>( m_language.size() ) );
 	}
 	//-------------------------------------------------------------------------
 	Shaper::~Shaper()
 	{
 		hb_buffer_destroy( m_buffer );
-		hb_font_destroy( m_hbFont );
 
+		SizedFontVec::const_iterator itor = m_sizedFonts.begin();
+		SizedFontVec::const_iterator endt = m_sizedFonts.end();
+
+		while( itor != endt )
+		{
+			hb_font_destroy( itor->hbFont );
+			++itor;
+		}
+
+		m_sizedFonts.clear();
+		m_hbFont = 0;
+
+		// FT_Done_Face releases all the FT_Size objects created by FT_New_Size
 		FT_Error errorCode = FT_Done_Face( m_ftFont );
 
 		if( errorCode )
@@ -150,33 +204,120 @@ namespace Colibri
 		m_features.push_back( feature );
 	}
 	//-------------------------------------------------------------------------
-	void Shaper::setFontSize( FontSize ptSize )
+	Shaper::SizedFont *colibri_nullable Shaper::createSizedFont( FontSize ptSize )
 	{
-		const FontSize oldSize = m_ptSize;
-		m_ptSize = ptSize;
+		if( m_sizedFonts.size() >= c_maxCachedFontSizes )
+		{
+			// Evict the least recently used size
+			SizedFontVec::iterator lruIt = m_sizedFonts.begin();
+			SizedFontVec::iterator itor = m_sizedFonts.begin() + 1u;
+			SizedFontVec::iterator endt = m_sizedFonts.end();
 
-		if( oldSize != m_ptSize )
+			while( itor != endt )
+			{
+				if( itor->lastUsed < lruIt->lastUsed )
+					lruIt = itor;
+				++itor;
+			}
+
+			if( lruIt->hbFont == m_hbFont )
+				m_hbFont = 0;
+			hb_font_destroy( lruIt->hbFont );
+			FT_Done_Size( lruIt->ftSize );
+			Ogre::efficientVectorRemove( m_sizedFonts, lruIt );
+		}
+
+		FT_Size ftSize = 0;
+		FT_Error errorCode = FT_New_Size( m_ftFont, &ftSize );
+		if( colibri_likely( !errorCode ) )
 		{
-			const FT_UInt deviceHdpi = 96u;
-			const FT_UInt deviceVdpi = 96u;
-			FT_Error errorCode = FT_Set_Char_Size( m_ftFont, 0, (FT_F26Dot6)ptSize.value26d6,
-												   deviceHdpi, deviceVdpi );
+			errorCode = FT_Activate_Size( ftSize );
+			if( colibri_likely( !errorCode ) )
+			{
+				const FT_UInt deviceHdpi = 96u;
+				const FT_UInt deviceVdpi = 96u;
+				errorCode = FT_Set_Char_Size( m_ftFont, 0, (FT_F26Dot6)ptSize.value26d6, deviceHdpi,
+											  deviceVdpi );
+			}
+
 			if( colibri_unlikely( errorCode ) )
 			{
-				LogListener *log = m_shaperManager->getLogListener();
-				char tmpBuffer[512];
-				Ogre::LwString errorMsg( Ogre::LwString::FromEmptyPointer( tmpBuffer,
-																		   sizeof(tmpBuffer) ) );
-
-				errorMsg.clear();
-				errorMsg.a( "[Freetype2 error] Could set font size to ",
-							Ogre::LwString::Float( ptSize.asFloat(), 2 ),
-							". errorCode: ", errorCode, " Desc: ",
-							ShaperManager::getErrorMessage( errorCode ) );
-				log->log( errorMsg.c_str(), LogSeverity::Error );
+				FT_Done_Size( ftSize );
+				ftSize = 0;
 			}
-			else if( colibri_likely( m_hbFont != 0 ) )
-				hb_ft_font_changed( m_hbFont );
+		}
+
+		if( colibri_unlikely( errorCode ) )
+		{
+			LogListener *log = m_shaperManager->getLogListener();
+			char tmpBuffer[512];
+			Ogre::LwString errorMsg( Ogre::LwString::FromEmptyPointer( tmpBuffer,
+																	   sizeof(tmpBuffer) ) );
+
+			errorMsg.clear();
+			errorMsg.a( "[Freetype2 error] Could set font size to ",
+						Ogre::LwString::Float( ptSize.asFloat(), 2 ),
+						". errorCode: ", errorCode, " Desc: ",
+						ShaperManager::getErrorMessage( errorCode ) );
+			log->log( errorMsg.c_str(), LogSeverity::Error );
+			return 0;
+		}
+
+		// hb_ft_font_create grabs the scale from the currently active FT_Size
+		SizedFont sizedFont;
+		sizedFont.ptSize = ptSize;
+		sizedFont.ftSize = ftSize;
+		sizedFont.hbFont = hb_ft_font_create( m_ftFont, NULL );
+		sizedFont.lastUsed = m_sizedFontsLruCounter;
+		m_sizedFonts.push_back( sizedFont );
+
+		return &m_sizedFonts.back();
+	}
+	//-------------------------------------------------------------------------
+	void Shaper::setFontSize( FontSize ptSize )
+	{
+		if( ptSize == m_ptSize && m_hbFont )
+			return;
+
+		++m_sizedFontsLruCounter;
+
+		SizedFont *sizedFont = 0;
+
+		SizedFontVec::iterator itor = m_sizedFonts.begin();
+		SizedFontVec::iterator endt = m_sizedFonts.end();
+
+		while( itor != endt && !sizedFont )
+		{
+			if( itor->ptSize == ptSize )
+				sizedFont = &( *itor );
+			++itor;
+		}
+
+		if( sizedFont )
+		{
+			// Cheap: FreeType just swaps the face's active size pointer
+			FT_Activate_Size( sizedFont->ftSize );
+			sizedFont->lastUsed = m_sizedFontsLruCounter;
+		}
+		else
+		{
+			sizedFont = createSizedFont( ptSize );
+		}
+
+		if( colibri_likely( sizedFont != 0 ) )
+		{
+			m_ptSize = ptSize;
+			m_hbFont = sizedFont->hbFont;
+		}
+		else if( m_hbFont )
+		{
+			// We failed. Restore the active size to the one we had
+			itor = m_sizedFonts.begin();
+			endt = m_sizedFonts.end();
+			while( itor != endt && itor->hbFont != m_hbFont )
+				++itor;
+			if( itor != endt )
+				FT_Activate_Size( itor->ftSize );
 		}
 	}
 	//-------------------------------------------------------------------------
@@ -193,7 +334,7 @@ namespace Colibri
 		size_t currentSize = outShapes.size();
 		size_t numWrittenCodepoints = 0;
 
-		const ShaperManager::ShaperVec &shapers = m_shaperManager->getShapers();
+		const ShaperManager::ShaperVec &shapers = m_shaperManager->getShapers( m_threadIdx );
 
 		ShaperManager::ShaperVec::const_iterator itor = shapers.begin() + 1u;
 		ShaperManager::ShaperVec::const_iterator end  = shapers.end();
@@ -215,9 +356,178 @@ namespace Colibri
 		return numWrittenCodepoints;
 	}
 	//-------------------------------------------------------------------------
+	void Shaper::buildCodepointCoverage()
+	{
+		m_coveragePages.clear();
+		m_coverageBits.clear();
+
+		if( !m_ftFont )
+			return;
+
+		// Unicode goes up to 0x10FFFF
+		m_coveragePages.resize( 0x110000u >> 8u, 0u );
+
+		FT_UInt glyphIdx = 0;
+		FT_ULong codepoint = FT_Get_First_Char( m_ftFont, &glyphIdx );
+		while( glyphIdx != 0 )
+		{
+			const size_t pageIdx = static_cast<size_t>( codepoint >> 8u );
+			if( pageIdx < m_coveragePages.size() )
+			{
+				if( !m_coveragePages[pageIdx] )
+				{
+					m_coverageBits.resize( m_coverageBits.size() + 4u, 0u );
+					m_coveragePages[pageIdx] = static_cast<uint16_t>( m_coverageBits.size() >> 2u );
+				}
+
+				const size_t bitIdx = ( m_coveragePages[pageIdx] - 1u ) * 256u + ( codepoint & 0xFFu );
+				m_coverageBits[bitIdx >> 6u] |= uint64_t( 1u ) << ( bitIdx & 0x3Fu );
+			}
+
+			codepoint = FT_Get_Next_Char( m_ftFont, codepoint, &glyphIdx );
+		}
+	}
+	//-------------------------------------------------------------------------
+	Shaper *colibri_nullable Shaper::findCoveringFallback( uint32_t codepoint ) const
+	{
+		const ShaperManager::ShaperVec &shapers = m_shaperManager->getShapers( m_threadIdx );
+
+		ShaperManager::ShaperVec::const_iterator itor = shapers.begin() + 1u;
+		ShaperManager::ShaperVec::const_iterator endt = shapers.end();
+
+		while( itor != endt )
+		{
+			if( *itor != this && ( *itor )->hasCodepoint( codepoint ) )
+				return *itor;
+			++itor;
+		}
+
+		return 0;
+	}
+	//-------------------------------------------------------------------------
 	size_t Shaper::renderString( const uint16_t *utf16Str, size_t stringLength, hb_direction_t dir,
 								 uint32_t richTextIdx, uint32_t clusterOffset, ShapedGlyphVec &outShapes,
 								 bool &bOutHasPrivateUse, bool substituteIfNotFound )
+	{
+		// m_shapers[0] is repeated, thus we need at least 3 entries to have a fallback
+		if( !substituteIfNotFound || m_shaperManager->getShapers( m_threadIdx ).size() <= 2u )
+		{
+			return shapeRun( utf16Str, stringLength, dir, richTextIdx, clusterOffset, outShapes,
+							 bOutHasPrivateUse, substituteIfNotFound );
+		}
+
+		struct FontSegment
+		{
+			size_t start;
+			size_t length;
+			Shaper *shaper;
+		};
+
+		// Split the string in segments, so that each is shaped exactly once with a font
+		// known to cover it. We prefer our own font whenever possible. Marks and format
+		// characters (e.g. ZWJ) stay with the previous segment to avoid breaking clusters.
+		// Codepoints no font covers (e.g. newlines) go to our font, which knows how to
+		// deal with them.
+		std::vector<FontSegment> segments;
+		{
+			FontSegment segment;
+			segment.start = 0u;
+			segment.length = 0u;
+			segment.shaper = this;
+
+			size_t i = 0u;
+			while( i < stringLength )
+			{
+				const size_t codepointStart = i;
+				UChar32 codepoint;
+				U16_NEXT( utf16Str, i, stringLength, codepoint );
+
+				const uint32_t utf32Char = static_cast<uint32_t>( codepoint );
+
+				Shaper *wantedShaper = segment.shaper;
+				if( !isClusterContinuation( codepoint ) || !segment.shaper->hasCodepoint( utf32Char ) )
+				{
+					if( hasCodepoint( utf32Char ) )
+						wantedShaper = this;
+					else
+					{
+						Shaper *fallback = findCoveringFallback( utf32Char );
+						wantedShaper = fallback ? fallback : this;
+					}
+				}
+
+				if( wantedShaper != segment.shaper )
+				{
+					segment.length = codepointStart - segment.start;
+					if( segment.length > 0u )
+						segments.push_back( segment );
+					segment.start = codepointStart;
+					segment.shaper = wantedShaper;
+				}
+			}
+
+			segment.length = stringLength - segment.start;
+			if( segment.length > 0u )
+				segments.push_back( segment );
+		}
+
+		if( segments.size() == 1u && segments.back().shaper == this )
+		{
+			// Common case: we cover everything
+			return shapeRun( utf16Str, stringLength, dir, richTextIdx, clusterOffset, outShapes,
+							 bOutHasPrivateUse, true );
+		}
+
+		// HarfBuzz outputs RTL glyphs in visual order, thus the
+		// segments must be appended last to first in that case
+		const bool bReverse = dir == HB_DIRECTION_RTL;
+		const size_t numSegments = segments.size();
+		for( size_t segIdx = 0u; segIdx < numSegments; ++segIdx )
+		{
+			const FontSegment &segment = segments[bReverse ? ( numSegments - segIdx - 1u ) : segIdx];
+
+			const uint16_t *segmentStr = utf16Str + segment.start;
+			const uint32_t segmentOffset = uint32_t( clusterOffset + segment.start );
+
+			if( segment.shaper == this )
+			{
+				shapeRun( segmentStr, segment.length, dir, richTextIdx, segmentOffset, outShapes,
+						  bOutHasPrivateUse, true );
+			}
+			else
+			{
+				Shaper *otherShaper = segment.shaper;
+				otherShaper->setFontSize( m_ptSize );
+				const size_t numWritten =
+					otherShaper->shapeRun( segmentStr, segment.length, dir, richTextIdx, segmentOffset,
+										   outShapes, bOutHasPrivateUse, false );
+				if( colibri_unlikely( numWritten != segment.length ) )
+				{
+					// The charmap said the font has these glyphs, but shaping disagreed
+					// (shouldn't happen). Throw away what the fallback produced and
+					// let the slow path deal with it.
+					ShapedGlyphVec::iterator itor = outShapes.end();
+					while( itor != outShapes.begin() &&
+						   ( itor - 1 )->clusterStart >= segmentOffset &&
+						   ( itor - 1 )->clusterStart < segmentOffset + segment.length )
+					{
+						--itor;
+						m_shaperManager->releaseGlyph( itor->glyph );
+					}
+					outShapes.erase( itor, outShapes.end() );
+
+					shapeRun( segmentStr, segment.length, dir, richTextIdx, segmentOffset, outShapes,
+							  bOutHasPrivateUse, true );
+				}
+			}
+		}
+
+		return stringLength;
+	}
+	//-------------------------------------------------------------------------
+	size_t Shaper::shapeRun( const uint16_t *utf16Str, size_t stringLength, hb_direction_t dir,
+							 uint32_t richTextIdx, uint32_t clusterOffset, ShapedGlyphVec &outShapes,
+							 bool &bOutHasPrivateUse, bool substituteIfNotFound )
 	{
 		size_t numWrittenCodepoints = stringLength;
 
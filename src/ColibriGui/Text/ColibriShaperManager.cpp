@@ -21,6 +21,8 @@
 #include "unicode/ubidi.h"
 #include "unicode/unistr.h"
 
+#include <algorithm>
+
 namespace Colibri
 {
 	ShaperManager::ShaperManager( ColibriManager *colibriManager ) :
@@ -33,6 +35,12 @@ namespace Colibri
 		m_bidi( 0 ),
 		m_defaultDirection( UBIDI_DEFAULT_LTR /*Note: non-defaults like UBIDI_RTL work differently!*/ ),
 		m_useVerticalLayoutWhenAvailable( false ),
+		m_workerJob( 0 ),
+		m_workerJobUserData( 0 ),
+		m_workerJobId( 0u ),
+		m_numBusyWorkers( 0u ),
+		m_stopWorkers( false ),
+		m_threadedShaping( false ),
 		m_defaultBmpFontForRaster( std::numeric_limits<uint16_t>::max() ),
 		m_glyphAtlasBuffer( 0 ),
 		m_hlms( 0 ),
@@ -57,6 +65,8 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	ShaperManager::~ShaperManager()
 	{
+		destroyWorkerShapers();
+
 		if( !m_shapers.empty() )
 		{
 			ShaperVec::const_iterator itor = m_shapers.begin() + 1u;
@@ -135,14 +145,166 @@ namespace Colibri
 									  const std::string &language )
 	{
 		Shaper *shaper = new Shaper( static_cast<hb_script_t>( script ), fontPath, language, this );
+		shaper->buildCodepointCoverage();
 		if( m_shapers.empty() )
 			m_shapers.push_back( shaper );
 
 		m_shapers.push_back( shaper );
 
+		const size_t numWorkers = m_workerShapers.size();
+		for( size_t i = 0u; i < numWorkers; ++i )
+		{
+			Shaper *clone = new Shaper( *shaper, static_cast<uint16_t>( i + 1u ) );
+			ShaperVec &workerShapers = m_workerShapers[i].shapers;
+			if( workerShapers.empty() )
+				workerShapers.push_back( clone );
+			workerShapers.push_back( clone );
+		}
+
 		return shaper;
 	}
 	//-------------------------------------------------------------------------
+	void ShaperManager::workerThreadMain( size_t threadIdx )
+	{
+		uint32_t lastJobId = 0u;
+
+		std::unique_lock<std::mutex> lock( m_workerMutex );
+		while( true )
+		{
+			while( !m_stopWorkers && m_workerJobId == lastJobId )
+				m_workerJobReady.wait( lock );
+
+			if( m_stopWorkers )
+				break;
+
+			lastJobId = m_workerJobId;
+			ShapingJobFunc job = m_workerJob;
+			void *userData = m_workerJobUserData;
+
+			lock.unlock();
+			job( threadIdx, userData );
+			lock.lock();
+
+			--m_numBusyWorkers;
+			if( m_numBusyWorkers == 0u )
+				m_workerJobDone.notify_one();
+		}
+	}
+	//-------------------------------------------------------------------------
+	void ShaperManager::runOnShapingThreads( ShapingJobFunc job, void *userData )
+	{
+		COLIBRI_ASSERT_LOW( m_numBusyWorkers == 0u && "runOnShapingThreads is not reentrant" );
+
+		{
+			std::lock_guard<std::mutex> lock( m_workerMutex );
+			m_workerJob = job;
+			m_workerJobUserData = userData;
+			m_numBusyWorkers = m_workerThreads.size();
+			++m_workerJobId;
+		}
+		m_workerJobReady.notify_all();
+
+		// The calling thread works too
+		job( 0u, userData );
+
+		std::unique_lock<std::mutex> lock( m_workerMutex );
+		while( m_numBusyWorkers != 0u )
+			m_workerJobDone.wait( lock );
+
+		m_workerJob = 0;
+		m_workerJobUserData = 0;
+	}
+	//-------------------------------------------------------------------------
+	void ShaperManager::destroyWorkerShapers()
+	{
+		if( !m_workerThreads.empty() )
+		{
+			{
+				std::lock_guard<std::mutex> lock( m_workerMutex );
+				m_stopWorkers = true;
+			}
+			m_workerJobReady.notify_all();
+
+			std::vector<std::thread>::iterator itor = m_workerThreads.begin();
+			std::vector<std::thread>::iterator endt = m_workerThreads.end();
+
+			while( itor != endt )
+			{
+				itor->join();
+				++itor;
+			}
+
+			m_workerThreads.clear();
+			m_stopWorkers = false;
+			// New workers start waiting for job 1. Otherwise they'd run the last job again
+			// (which is null by now) as soon as setNumShapingThreads creates them
+			m_workerJobId = 0u;
+		}
+
+		std::vector<WorkerShapers>::iterator itor = m_workerShapers.begin();
+		std::vector<WorkerShapers>::iterator endt = m_workerShapers.end();
+
+		while( itor != endt )
+		{
+			if( !itor->shapers.empty() )
+			{
+				ShaperVec::const_iterator itShaper = itor->shapers.begin() + 1u;
+				ShaperVec::const_iterator enShaper = itor->shapers.end();
+
+				while( itShaper != enShaper )
+					delete *itShaper++;
+			}
+
+			ubidi_close( itor->bidi );
+			++itor;
+		}
+
+		m_workerShapers.clear();
+	}
+	//-------------------------------------------------------------------------
+	void ShaperManager::setNumShapingThreads( size_t numThreads )
+	{
+		COLIBRI_ASSERT_LOW( numThreads > 0u && numThreads <= 65535u );
+		COLIBRI_ASSERT_LOW( !m_threadedShaping );
+
+		destroyWorkerShapers();
+
+		if( numThreads <= 1u )
+			return;
+
+		m_workerShapers.resize( numThreads - 1u );
+
+		for( size_t i = 0u; i < numThreads - 1u; ++i )
+		{
+			WorkerShapers &worker = m_workerShapers[i];
+			worker.bidi = ubidi_open();
+			ubidi_orderParagraphsLTR( worker.bidi, 1 );
+
+			if( !m_shapers.empty() )
+			{
+				worker.shapers.reserve( m_shapers.size() );
+				worker.shapers.push_back( 0 );
+
+				ShaperVec::const_iterator itor = m_shapers.begin() + 1u;
+				ShaperVec::const_iterator endt = m_shapers.end();
+
+				while( itor != endt )
+				{
+					Shaper *clone = new Shaper( **itor, static_cast<uint16_t>( i + 1u ) );
+					if( *itor == m_shapers[0] )
+						worker.shapers[0] = clone;
+					worker.shapers.push_back( clone );
+					++itor;
+				}
+			}
+		}
+
+		// Start the threads once all of their state is ready
+		m_workerThreads.reserve( numThreads - 1u );
+		for( size_t i = 0u; i < numThreads - 1u; ++i )
+			m_workerThreads.push_back( std::thread( &ShaperManager::workerThreadMain, this, i + 1u ) );
+	}
+	//-------------------------------------------------------------------------
 	void ShaperManager::setDefaultShaper( uint16_t font,
 										  HorizReadingDir::HorizReadingDir horizReadingDir,
 										  bool useVerticalLayoutWhenAvailable )
@@ -150,6 +312,16 @@ namespace Colibri
 		COLIBRI_ASSERT_LOW( font < m_shapers.size() );
 
 		m_shapers[0] = m_shapers[font];
+
+		std::vector<WorkerShapers>::iterator itor = m_workerShapers.begin();
+		std::vector<WorkerShapers>::iterator endt = m_workerShapers.end();
+
+		while( itor != endt )
+		{
+			itor->shapers[0] = itor->shapers[font];
+			++itor;
+		}
+
 		switch( horizReadingDir )
 		{
 		case HorizReadingDir::Default:	m_defaultDirection = UBIDI_DEFAULT_LTR;	break;
@@ -437,6 +609,8 @@ namespace Colibri
 	const CachedGlyph *ShaperManager::acquireGlyph( FT_Face font, uint32_t codepoint, uint32_t ptSize,
 													uint16_t fontIdx, bool bDummy )
 	{
+		ScopedGlyphCacheLock lock( this );
+
 		CachedGlyph *retVal = 0;
 
 		const GlyphKey glyphKey( codepoint, ptSize, fontIdx );
@@ -461,6 +635,8 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ShaperManager::addRefCount( const CachedGlyph *cachedGlyph )
 	{
+		ScopedGlyphCacheLock lock( this );
+
 		const GlyphKey glyphKey( cachedGlyph->codepoint, cachedGlyph->ptSize, cachedGlyph->font );
 
 		COLIBRI_ASSERT_MEDIUM( m_glyphCache.find( glyphKey ) != m_glyphCache.end() &&
@@ -472,6 +648,8 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ShaperManager::releaseGlyph( uint32_t codepoint, uint32_t ptSize, uint16_t fontIdx )
 	{
+		ScopedGlyphCacheLock lock( this );
+
 		const GlyphKey glyphKey( codepoint, ptSize, fontIdx );
 
 		CachedGlyphMap::iterator itor = m_glyphCache.find( glyphKey );
@@ -486,6 +664,8 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ShaperManager::releaseGlyph( const CachedGlyph *cachedGlyph )
 	{
+		ScopedGlyphCacheLock lock( this );
+
 		const GlyphKey glyphKey( cachedGlyph->codepoint, cachedGlyph->ptSize, cachedGlyph->font );
 
 		COLIBRI_ASSERT_MEDIUM( m_glyphCache.find( glyphKey ) != m_glyphCache.end() &&
@@ -499,6 +679,8 @@ namespace Colibri
 	//-------------------------------------------------------------------------
 	void ShaperManager::flushReleasedGlyphs()
 	{
+		ScopedGlyphCacheLock lock( this );
+
 		CachedGlyphMap::iterator itor = m_glyphCache.begin();
 		CachedGlyphMap::iterator end  = m_glyphCache.end();
 
@@ -519,17 +701,87 @@ namespace Colibri
 	TextHorizAlignment::TextHorizAlignment ShaperManager::renderString(
 			const char *utf8Str, const RichText &richText, uint32_t richTextIdx,
 			VertReadingDir::VertReadingDir vertReadingDir,
-			ShapedGlyphVec &outShapes, bool &bOutHasPrivateUse )
+			ShapedGlyphVec &outShapes, bool &bOutHasPrivateUse, size_t threadIdx )
 	{
 		bOutHasPrivateUse = false;
+		RichText tmpRichText = richText;
+		return renderParagraphs( utf8Str, &tmpRichText, 1u, richTextIdx, vertReadingDir, outShapes,
+								 bOutHasPrivateUse, threadIdx );
+	}
+	//-------------------------------------------------------------------------
+	TextHorizAlignment::TextHorizAlignment ShaperManager::renderString(
+			const char *utf8Str, std::vector<RichText> &richTexts,
+			VertReadingDir::VertReadingDir vertReadingDir,
+			ShapedGlyphVec &outShapes, bool &bOutHasPrivateUse, size_t threadIdx )
+	{
+		bOutHasPrivateUse = false;
+
+		bool alignmentUnknown = true;
+		TextHorizAlignment::TextHorizAlignment retVal = TextHorizAlignment::Mixed;
+
+		const size_t numRichTexts = richTexts.size();
+		size_t groupStart = 0u;
+		while( groupStart < numRichTexts )
+		{
+			// Group consecutive RichTexts that are contiguous and share the same reading
+			// direction. They get analyzed by BiDi all at once.
+			size_t groupEnd = groupStart + 1u;
+			while( groupEnd < numRichTexts &&
+				   richTexts[groupEnd].readingDir == richTexts[groupStart].readingDir &&
+				   richTexts[groupEnd].offset ==
+					   richTexts[groupEnd - 1u].offset + richTexts[groupEnd - 1u].length )
+			{
+				++groupEnd;
+			}
+
+			const TextHorizAlignment::TextHorizAlignment actualDir = renderParagraphs(
+				utf8Str + richTexts[groupStart].offset, &richTexts[groupStart],
+				groupEnd - groupStart, static_cast<uint32_t>( groupStart ), vertReadingDir,
+				outShapes, bOutHasPrivateUse, threadIdx );
+
+			if( alignmentUnknown )
+			{
+				retVal = actualDir;
+				alignmentUnknown = false;
+			}
+			else if( retVal != actualDir )
+				retVal = TextHorizAlignment::Mixed;
+
+			groupStart = groupEnd;
+		}
+
+		return retVal;
+	}
+	//-------------------------------------------------------------------------
+	TextHorizAlignment::TextHorizAlignment ShaperManager::renderParagraphs(
+			const char *utf8Str, RichText *richTexts, size_t numRichTexts, uint32_t firstRichTextIdx,
+			VertReadingDir::VertReadingDir vertReadingDir,
+			ShapedGlyphVec &outShapes, bool &bOutHasPrivateUse, size_t threadIdx )
+	{
+		COLIBRI_ASSERT_MEDIUM( threadIdx == 0u || m_threadedShaping );
+		COLIBRI_ASSERT_LOW( numRichTexts > 0u );
+
+		UBiDi *bidi = threadIdx == 0u ? m_bidi : m_workerShapers[threadIdx - 1u].bidi;
+		const ShaperVec &shapers = getShapers( threadIdx );
 
 		UBiDiDirection retVal = UBIDI_NEUTRAL;
 
-		UnicodeString uStr( utf8Str, (int32_t)richText.length );
+		// Convert each RichText to UTF-16 and concatenate them, remembering where
+		// each RichText starts in UTF-16 units. richTextUtf16Start[numRichTexts] is the end.
+		UnicodeString uStr;
+		std::vector<int32_t> richTextUtf16Start;
+		richTextUtf16Start.reserve( numRichTexts + 1u );
+		for( size_t i = 0u; i < numRichTexts; ++i )
+		{
+			richTextUtf16Start.push_back( uStr.length() );
+			uStr.append( UnicodeString( utf8Str + ( richTexts[i].offset - richTexts[0].offset ),
+										(int32_t)richTexts[i].length ) );
+		}
+		richTextUtf16Start.push_back( uStr.length() );
 
 		UBiDiLevel textHorizDir = m_defaultDirection;
 
-		switch( richText.readingDir )
+		switch( richTexts[0].readingDir )
 		{
 		case HorizReadingDir::Default:	textHorizDir = m_defaultDirection;	break;
 		case HorizReadingDir::AutoLTR:	textHorizDir = UBIDI_DEFAULT_LTR;	break;
@@ -538,8 +790,9 @@ namespace Colibri
 		case HorizReadingDir::RTL:		textHorizDir = UBIDI_RTL;			break;
 		}
 
+		// Analyze the whole text once. ICU splits it into paragraphs for us
 		UErrorCode errorCode = U_ZERO_ERROR;
-		ubidi_setPara( m_bidi, uStr.getBuffer(), uStr.length(), textHorizDir, 0, &errorCode );
+		ubidi_setPara( bidi, uStr.getBuffer(), uStr.length(), textHorizDir, 0, &errorCode );
 
 		if( colibri_unlikely( !U_SUCCESS(errorCode) ) )
 		{
@@ -551,59 +804,151 @@ namespace Colibri
 			errorMsg.a( "[UBiDi error] Error analyzing text. Error code: ", errorCode,
 						" Desc: ", u_errorName( errorCode ), "\n[UBiDi error] String:" );
 			log->log( errorMsg.c_str(), LogSeverity::Warning );
-			log->log( utf8Str, LogSeverity::Warning );
+			std::string utf8Tmp;
+			uStr.toUTF8String( utf8Tmp );
+			log->log( utf8Tmp.c_str(), LogSeverity::Warning );
+
+			for( size_t i = 0u; i < numRichTexts; ++i )
+				richTexts[i].glyphStart = richTexts[i].glyphEnd = (uint32_t)outShapes.size();
 			return getDefaultTextDirection();
 		}
 
-		Shaper *shaper = 0;
-		if( colibri_unlikely( richText.font >= m_shapers.size() ) )
+		const bool bVertical =
+			( vertReadingDir == VertReadingDir::IfNeededTTB && m_useVerticalLayoutWhenAvailable ) ||
+			vertReadingDir == VertReadingDir::ForceTTB ||
+			vertReadingDir == VertReadingDir::ForceTTBLTR;
+
+		const int32_t numBlocks = ubidi_countRuns( bidi, &errorCode );
+
+#if U_SIZEOF_WCHAR_T == 2
+		const uint16_t *utf16Str = reinterpret_cast<const uint16_t*>( uStr.getBuffer() );
+#else
+		const uint16_t *utf16Str = uStr.getBuffer();
+#endif
+
+		// Colour changes don't affect shaping. Merge consecutive RichTexts sharing the same
+		// font & size into spans so they're shaped together (which also keeps kerning and
+		// ligatures intact across colour boundaries). spanRichTextStart[numSpans] is the end.
+		std::vector<size_t> spanRichTextStart;
+		std::vector<Shaper *> spanShapers;
+		size_t spanStart = 0u;
+		while( spanStart < numRichTexts )
 		{
-			LogListener *log = this->getLogListener();
-			char tmpBuffer[512];
-			Ogre::LwString errorMsg( Ogre::LwString::FromEmptyPointer( tmpBuffer, sizeof(tmpBuffer) ) );
+			size_t spanEnd = spanStart + 1u;
+			while( spanEnd < numRichTexts && richTexts[spanEnd].font == richTexts[spanStart].font &&
+				   richTexts[spanEnd].ptSize == richTexts[spanStart].ptSize )
+			{
+				++spanEnd;
+			}
 
-			errorMsg.clear();
-			errorMsg.a( "[ShaperManager::renderString] RichText wants font ", richText.font,
-						" but there's only ", (uint32_t)m_shapers.size(), " fonts installed" );
-			log->log( errorMsg.c_str(), LogSeverity::Error );
+			Shaper *shaper = 0;
+			if( colibri_unlikely( richTexts[spanStart].font >= shapers.size() ) )
+			{
+				LogListener *log = this->getLogListener();
+				char tmpBuffer[512];
+				Ogre::LwString errorMsg(
+					Ogre::LwString::FromEmptyPointer( tmpBuffer, sizeof( tmpBuffer ) ) );
+
+				errorMsg.clear();
+				errorMsg.a( "[ShaperManager::renderString] RichText wants font ",
+							richTexts[spanStart].font, " but there's only ",
+							(uint32_t)shapers.size(), " fonts installed" );
+				log->log( errorMsg.c_str(), LogSeverity::Error );
+
+				shaper = shapers[0];
+			}
+			else
+				shaper = shapers[richTexts[spanStart].font];
 
-			shaper = m_shapers[0];
+			spanRichTextStart.push_back( spanStart );
+			spanShapers.push_back( shaper );
+
+			spanStart = spanEnd;
 		}
-		else
-			shaper = m_shapers[richText.font];
+		spanRichTextStart.push_back( numRichTexts );
 
-		UnicodeString uniStr( false, ubidi_getText( m_bidi ), ubidi_getLength( m_bidi ) );
+		const size_t numSpans = spanShapers.size();
+		const size_t firstGlyph = outShapes.size();
 
-		const int32_t numBlocks = ubidi_countRuns( m_bidi, &errorCode );
-		for( int32_t i=0; i<numBlocks; ++i )
+		// Walk the level runs in visual order and intersect each with the spans. Within an
+		// RTL run the spans are visited backwards, so that the text stays in visual order
+		// even when a run crosses RichTexts with different fonts
+		for( int32_t i = 0; i < numBlocks; ++i )
 		{
 			int32_t logicalStart, length;
-			UBiDiDirection dir = ubidi_getVisualRun( m_bidi, i, &logicalStart, &length );
-
-			UnicodeString temp = uniStr.tempSubString( logicalStart, length );
+			UBiDiDirection dir = ubidi_getVisualRun( bidi, i, &logicalStart, &length );
 
 			hb_direction_t hbDir = dir == UBIDI_LTR ? HB_DIRECTION_LTR : HB_DIRECTION_RTL;
-
-			if( (vertReadingDir == VertReadingDir::IfNeededTTB && m_useVerticalLayoutWhenAvailable) ||
-				vertReadingDir == VertReadingDir::ForceTTB ||
-				vertReadingDir == VertReadingDir::ForceTTBLTR )
-			{
+			if( bVertical )
 				hbDir = HB_DIRECTION_TTB;
-			}
 
 			if( retVal == UBIDI_NEUTRAL )
 				retVal = dir;
-			/*else if( retVal != dir )
-				retVal = UBIDI_MIXED;*/
 
-#if U_SIZEOF_WCHAR_T == 2
-			const uint16_t *utf16Str = reinterpret_cast<const uint16_t*>( temp.getBuffer() );
-#else
-			const uint16_t *utf16Str = temp.getBuffer();
-#endif
-			shaper->setFontSize( richText.ptSize );
-			shaper->renderString( utf16Str, (size_t)temp.length(), hbDir, richTextIdx,
-								  (uint32_t)logicalStart, outShapes, bOutHasPrivateUse, true );
+			for( size_t j = 0u; j < numSpans; ++j )
+			{
+				const size_t spanIdx = dir == UBIDI_RTL ? ( numSpans - j - 1u ) : j;
+
+				const int32_t spanUtf16Start = richTextUtf16Start[spanRichTextStart[spanIdx]];
+				const int32_t spanUtf16End = richTextUtf16Start[spanRichTextStart[spanIdx + 1u]];
+
+				const int32_t start = std::max( logicalStart, spanUtf16Start );
+				const int32_t end = std::min( logicalStart + length, spanUtf16End );
+
+				if( start >= end )
+					continue;
+
+				const RichText &firstRichText = richTexts[spanRichTextStart[spanIdx]];
+
+				// Clusters are made relative to the start of uStr here; we fix them below
+				Shaper *shaper = spanShapers[spanIdx];
+				shaper->setFontSize( firstRichText.ptSize );
+				shaper->renderString(
+					utf16Str + start, (size_t)( end - start ), hbDir,
+					static_cast<uint32_t>( firstRichTextIdx + spanRichTextStart[spanIdx] ),
+					(uint32_t)start, outShapes, bOutHasPrivateUse, true );
+			}
+		}
+
+		const size_t numGlyphs = outShapes.size();
+
+		for( size_t rtIdx = 0u; rtIdx < numRichTexts; ++rtIdx )
+		{
+			richTexts[rtIdx].glyphStart = static_cast<uint32_t>( numGlyphs );
+			richTexts[rtIdx].glyphEnd = static_cast<uint32_t>( firstGlyph );
+		}
+
+		// Assign each glyph to the RichText its cluster belongs to, and make its cluster
+		// relative to the start of that RichText. Glyphs are in visual order, thus the glyphs
+		// of a RichText may not be contiguous; so glyphStart & glyphEnd enclose the range
+		// and users must check ShapedGlyph::richTextIdx.
+		for( size_t glyphIdx = firstGlyph; glyphIdx < numGlyphs; ++glyphIdx )
+		{
+			ShapedGlyph &shapedGlyph = outShapes[glyphIdx];
+
+			const size_t rtIdx =
+				size_t( std::upper_bound( richTextUtf16Start.begin() + 1u,
+										  richTextUtf16Start.begin() + ptrdiff_t( numRichTexts ),
+										  (int32_t)shapedGlyph.clusterStart ) -
+						richTextUtf16Start.begin() ) -
+				1u;
+
+			shapedGlyph.richTextIdx = static_cast<uint32_t>( firstRichTextIdx + rtIdx );
+			shapedGlyph.clusterStart -= (uint32_t)richTextUtf16Start[rtIdx];
+
+			RichText &richText = richTexts[rtIdx];
+			richText.glyphStart = std::min<uint32_t>( richText.glyphStart, (uint32_t)glyphIdx );
+			richText.glyphEnd = std::max<uint32_t>( richText.glyphEnd, (uint32_t)glyphIdx + 1u );
+		}
+
+		for( size_t rtIdx = 0u; rtIdx < numRichTexts; ++rtIdx )
+		{
+			// RichTexts without glyphs get an empty range
+			if( richTexts[rtIdx].glyphStart >= richTexts[rtIdx].glyphEnd )
+			{
+				richTexts[rtIdx].glyphStart = static_cast<uint32_t>( firstGlyph );
+				richTexts[rtIdx].glyphEnd = static_cast<uint32_t>( firstGlyph );
+			}
 		}
 
 		TextHorizAlignment::TextHorizAlignment finalRetVal;